@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <utility>
+
+namespace dvc {
+
+// A bump-pointer memory resource for workloads that build many small objects
+// and free them all at once, such as parse trees.  Memory comes from a list of
+// chunks, each twice the size of the last up to max_chunk_size, and is only
+// reclaimed by rewind(), reset() or release(), each of which is O(chunks).
+// Deallocating the most recent allocation gives it back; any other
+// deallocation is a no-op, so a growing pmr::vector, which allocates its new
+// buffer before freeing the old one, leaves the old ones behind.  Not thread
+// safe; see thread_arena().
+class arena : public std::pmr::memory_resource {
+  struct chunk;
+
+ public:
+  static constexpr size_t max_chunk_size = 1 << 20;
+
+  explicit arena(size_t initial_chunk_size = 4096,
+                 std::pmr::memory_resource* upstream =
+                     std::pmr::new_delete_resource())
+      : next_chunk_size_(initial_chunk_size), upstream_(upstream) {}
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+
+  ~arena() override { release(); }
+
+  // The non-virtual fast path of allocate().
+  void* alloc(size_t size, size_t align = alignof(std::max_align_t)) {
+    char* p = align_up(cur_, align);
+    if (!cur_ || size_t(end_ - cur_) < size_t(p - cur_) + size)
+      return alloc_slow(size, align);
+    cur_ = p + size;
+    return p;
+  }
+
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    return new (alloc(sizeof(T), alignof(T))) T{std::forward<Args>(args)...};
+  }
+
+  // A position to rewind() back to, freeing everything allocated since.
+  struct marker {
+    chunk* at;
+    char* cur;
+  };
+
+  marker mark() const { return {current_, cur_}; }
+
+  void rewind(marker m) {
+    current_ = m.at;
+    cur_ = m.cur;
+    end_ = current_ ? current_->end() : nullptr;
+  }
+
+  // Frees all allocations but keeps the chunks for reuse.
+  void reset() {
+    current_ = first_;
+    cur_ = first_ ? first_->begin() : nullptr;
+    end_ = first_ ? first_->end() : nullptr;
+  }
+
+  // Frees all allocations and chunks.
+  void release() {
+    while (first_) {
+      chunk* next = first_->next;
+      upstream_->deallocate(first_, first_->size, alignof(chunk));
+      first_ = next;
+    }
+    current_ = nullptr;
+    cur_ = end_ = nullptr;
+  }
+
+  // Rewinds the arena when destroyed.
+  class scope {
+   public:
+    explicit scope(arena& a) : arena_(a), marker_(a.mark()) {}
+    ~scope() { arena_.rewind(marker_); }
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+   private:
+    arena& arena_;
+    marker marker_;
+  };
+
+ protected:
+  void* do_allocate(size_t size, size_t align) override {
+    return alloc(size, align);
+  }
+
+  void do_deallocate(void* p, size_t size, size_t) override {
+    if (static_cast<char*>(p) + size == cur_) cur_ = static_cast<char*>(p);
+  }
+
+  bool do_is_equal(
+      const std::pmr::memory_resource& other) const noexcept override {
+    return this == &other;
+  }
+
+ private:
+  struct alignas(std::max_align_t) chunk {
+    chunk* next;
+    size_t size;  // including this header
+
+    char* begin() { return reinterpret_cast<char*>(this + 1); }
+    char* end() { return reinterpret_cast<char*>(this) + size; }
+  };
+
+  static char* align_up(char* p, size_t align) {
+    return reinterpret_cast<char*>((uintptr_t(p) + align - 1) & ~(align - 1));
+  }
+
+  // Moves to the next chunk, reusing one left by rewind() or reset() if it is
+  // big enough.
+  void* alloc_slow(size_t size, size_t align) {
+    size_t needed = sizeof(chunk) + size + align;
+    chunk* next = current_ ? current_->next : first_;
+    if (!next || next->size < needed) {
+      size_t chunk_size = std::max(next_chunk_size_, needed);
+      next_chunk_size_ = std::min(2 * next_chunk_size_, max_chunk_size);
+      chunk* c =
+          static_cast<chunk*>(upstream_->allocate(chunk_size, alignof(chunk)));
+      c->size = chunk_size;
+      c->next = next;
+      (current_ ? current_->next : first_) = c;
+      next = c;
+    }
+    current_ = next;
+    cur_ = current_->begin();
+    end_ = current_->end();
+    return alloc(size, align);
+  }
+
+  size_t next_chunk_size_;
+  std::pmr::memory_resource* upstream_;
+  chunk* first_ = nullptr;
+  chunk* current_ = nullptr;
+  char* cur_ = nullptr;
+  char* end_ = nullptr;
+};
+
+// An arena for the calling thread, for scratch allocations that are
+// rewound with arena::scope before the thread reuses it.
+inline arena& thread_arena() {
+  thread_local arena a;
+  return a;
+}
+
+}  // namespace dvc
@@ -0,0 +1,150 @@
+#include "dvc/arena.h"
+
+#include <memory>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/string.h"
+#include "dvc/time.h"
+
+// Counts the chunks an arena takes from upstream.
+class counting_resource : public std::pmr::memory_resource {
+ public:
+  size_t allocations = 0;
+  size_t live = 0;
+
+ private:
+  void* do_allocate(size_t size, size_t align) override {
+    allocations++;
+    live++;
+    return std::pmr::new_delete_resource()->allocate(size, align);
+  }
+
+  void do_deallocate(void* p, size_t size, size_t align) override {
+    live--;
+    std::pmr::new_delete_resource()->deallocate(p, size, align);
+  }
+
+  bool do_is_equal(const memory_resource& o) const noexcept override {
+    return this == &o;
+  }
+};
+
+void test_alignment() {
+  dvc::arena a(64);
+  for (size_t align = 1; align <= 64; align *= 2) {
+    for (size_t size : {1, 3, 17, 100}) {
+      void* p = a.alloc(size, align);
+      DVC_ASSERT_EQ(uintptr_t(p) % align, 0u);
+    }
+  }
+  // Larger than any chunk so far.
+  char* big = static_cast<char*>(a.alloc(100000, 1));
+  big[99999] = 'x';
+}
+
+void test_rewind() {
+  counting_resource upstream;
+  {
+    dvc::arena a(1024, &upstream);
+    int* first = a.make<int>(1);
+    dvc::arena::marker m = a.mark();
+    for (int i = 0; i < 10000; i++) a.make<int>(i);
+    size_t chunks = upstream.allocations;
+    DVC_ASSERT_GT(chunks, 1u);
+
+    a.rewind(m);
+    int* again = a.make<int>(2);
+    DVC_ASSERT_EQ(again, first + 1);
+    DVC_ASSERT_EQ(*first, 1);
+    for (int i = 0; i < 10000; i++) a.make<int>(i);
+    DVC_ASSERT_EQ(upstream.allocations, chunks, "chunks are reused");
+
+    int* before = a.make<int>(3);
+    {
+      dvc::arena::scope scope(a);
+      a.alloc(100);
+    }
+    DVC_ASSERT_EQ(a.make<int>(3), before + 1);
+
+    a.reset();
+    DVC_ASSERT_EQ(a.make<int>(4), first);
+  }
+  DVC_ASSERT_EQ(upstream.live, 0u);
+}
+
+void test_pmr() {
+  counting_resource upstream;
+  dvc::arena a(4096, &upstream);
+  dvc::pmr_vector<dvc::pmr_string> v(&a);
+  for (int i = 0; i < 100; i++)
+    v.emplace_back("a string too long for the small string buffer");
+  DVC_ASSERT_EQ(v.back().get_allocator().resource(), &a);
+  auto parts = dvc::split(",", "a,bb,,ccc", &a);
+  DVC_ASSERT_EQ(parts.size(), 4u);
+  DVC_ASSERT_EQ(parts[3], "ccc");
+  DVC_ASSERT_EQ(parts.get_allocator().resource(), &a);
+
+  // Only the most recent allocation is given back.
+  dvc::arena b(1 << 16);
+  void* p = b.allocate(64);
+  b.deallocate(p, 64);
+  DVC_ASSERT_EQ(b.allocate(64), p);
+  void* q = b.allocate(64);
+  b.deallocate(p, 64);
+  DVC_ASSERT_NE(b.allocate(64), p);
+  DVC_ASSERT_NE(b.allocate(64), q);
+}
+
+struct tree {
+  tree* left;
+  tree* right;
+  int value;
+};
+
+template <typename Make>
+tree* build(int depth, Make& make) {
+  if (depth == 0) return nullptr;
+  return make(build(depth - 1, make), build(depth - 1, make), depth);
+}
+
+void destroy(tree* t) {
+  if (!t) return;
+  destroy(t->left);
+  destroy(t->right);
+  delete t;
+}
+
+void test_benchmark() {
+  constexpr int depth = 20;
+  constexpr size_t n = (1 << depth) - 1;
+  constexpr int rounds = 5;
+
+  auto make_new = [](tree* l, tree* r, int v) { return new tree{l, r, v}; };
+  size_t start = dvc::now();
+  for (int i = 0; i < rounds; i++) destroy(build(depth, make_new));
+  size_t middle = dvc::now();
+
+  dvc::arena& a = dvc::thread_arena();
+  auto make_arena = [&](tree* l, tree* r, int v) {
+    return a.make<tree>(tree{l, r, v});
+  };
+  for (int i = 0; i < rounds; i++) {
+    dvc::arena::scope scope(a);
+    DVC_ASSERT_EQ(build(depth, make_arena)->value, depth);
+  }
+  size_t end = dvc::now();
+
+  DVC_LOG("new/delete tree: ", double(middle - start) / (rounds * n),
+          "ns/node");
+  DVC_LOG("arena tree: ", double(end - middle) / (rounds * n), "ns/node");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_alignment();
+  test_rewind();
+  test_pmr();
+  test_benchmark();
+}
@@ -0,0 +1,93 @@
+#include "dvc/async_io.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include "dvc/opts.h"
+
+namespace dvc {
+
+size_t DVC_OPTION(io_threads, -, 64,
+                  "threads in the default pool for blocking file I/O");
+
+io_pool::io_pool(size_t threads) {
+  for (size_t i = 0; i < std::max<size_t>(threads, 1); i++)
+    threads_.emplace_back([this] { worker(); });
+}
+
+io_pool::~io_pool() {
+  {
+    std::lock_guard lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) thread.join();
+}
+
+void io_pool::submit(job f) {
+  {
+    std::lock_guard lock(mu_);
+    queue_.push_back(std::move(f));
+  }
+  cv_.notify_one();
+}
+
+size_t io_pool::queued() {
+  std::lock_guard lock(mu_);
+  return queue_.size();
+}
+
+void io_pool::worker() {
+  while (true) {
+    job f;
+    {
+      std::unique_lock lock(mu_);
+      cv_.wait(lock, [&] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return;
+      f = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    f();
+  }
+}
+
+io_pool& default_io_pool() {
+  static io_pool pool(io_threads);
+  return pool;
+}
+
+namespace async_io_detail {
+namespace {
+
+[[noreturn]] void fail(const char* what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+size_t pread_some(int fd, void* buf, size_t n, off_t offset) {
+  while (true) {
+    ssize_t r = ::pread(fd, buf, n, offset);
+    if (r >= 0) return r;
+    if (errno != EINTR) fail("pread");
+  }
+}
+
+void pwrite_all(int fd, const void* buf, size_t n, off_t offset) {
+  const char* p = static_cast<const char*>(buf);
+  while (n > 0) {
+    ssize_t r = ::pwrite(fd, p, n, offset);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      fail("pwrite");
+    }
+    p += r;
+    n -= r;
+    offset += r;
+  }
+}
+
+}  // namespace async_io_detail
+}  // namespace dvc
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dvc/file.h"
+#include "dvc/task.h"
+
+// Awaitable file I/O for coroutines.  Blocking calls are handed to a pool of
+// I/O threads, and the awaiting coroutine is resumed on an executor when the
+// call returns, so any number of operations may be outstanding while the
+// executor's threads do other work.
+namespace dvc {
+
+// A FIFO of blocking calls run by a fixed set of threads.  Unlike
+// thread_pool, its threads are expected to spend their time blocked in
+// system calls, so there are many more of them than CPUs.
+class io_pool {
+ public:
+  explicit io_pool(size_t threads);
+  ~io_pool();
+
+  io_pool(const io_pool&) = delete;
+  io_pool& operator=(const io_pool&) = delete;
+
+  size_t size() const { return threads_.size(); }
+
+  void submit(job f);
+
+  // Calls submitted but not yet started.
+  size_t queued();
+
+ private:
+  void worker();
+
+  std::mutex mu_;
+  std::condition_variable cv_;
+  std::deque<job> queue_;
+  bool stop_ = false;
+  std::vector<std::thread> threads_;
+};
+
+// The pool sized by --io_threads, created on first use.
+io_pool& default_io_pool();
+
+namespace async_io_detail {
+
+template <typename F>
+class blocking_awaiter {
+ public:
+  using result_type = std::invoke_result_t<F>;
+
+  blocking_awaiter(F f, const executor& ex, io_pool& io)
+      : f_(std::move(f)), ex_(ex), io_(io) {}
+
+  bool await_ready() { return false; }
+
+  void await_suspend(std::coroutine_handle<> h) {
+    io_.submit([this, h] {
+      try {
+        if constexpr (std::is_void_v<result_type>) {
+          f_();
+        } else {
+          result_.emplace(f_());
+        }
+      } catch (...) {
+        exception_ = std::current_exception();
+      }
+      // *this may be gone as soon as h is resumed.
+      executor ex = ex_;
+      ex.resume(h);
+    });
+  }
+
+  result_type await_resume() {
+    if (exception_) std::rethrow_exception(exception_);
+    if constexpr (!std::is_void_v<result_type>) return std::move(*result_);
+  }
+
+ private:
+  using slot = std::conditional_t<std::is_void_v<result_type>, std::tuple<>,
+                                  std::optional<result_type>>;
+
+  F f_;
+  executor ex_;
+  io_pool& io_;
+  slot result_;
+  std::exception_ptr exception_;
+};
+
+}  // namespace async_io_detail
+
+// co_await run_blocking(f) calls f() on io, then continues on ex with its
+// result, or rethrows what it threw.
+template <typename F>
+auto run_blocking(F f, const executor& ex = default_executor(),
+                  io_pool& io = default_io_pool()) {
+  return async_io_detail::blocking_awaiter<F>(std::move(f), ex, io);
+}
+
+namespace async_io_detail {
+
+size_t pread_some(int fd, void* buf, size_t n, off_t offset);
+void pwrite_all(int fd, const void* buf, size_t n, off_t offset);
+
+}  // namespace async_io_detail
+
+// Reads up to n bytes at offset, returning the number read.
+inline auto async_pread(int fd, void* buf, size_t n, off_t offset,
+                        const executor& ex = default_executor()) {
+  return run_blocking(
+      [=] { return async_io_detail::pread_some(fd, buf, n, offset); }, ex);
+}
+
+// Writes all n bytes at offset.
+inline auto async_pwrite(int fd, const void* buf, size_t n, off_t offset,
+                         const executor& ex = default_executor()) {
+  return run_blocking(
+      [=] { async_io_detail::pwrite_all(fd, buf, n, offset); }, ex);
+}
+
+// As load_file and save_file in file.h.
+inline auto async_load_file(std::filesystem::path filename,
+                            const executor& ex = default_executor()) {
+  return run_blocking(
+      [filename = std::move(filename)] {
+        return load_file(filename);
+      },
+      ex);
+}
+
+inline auto async_save_file(std::filesystem::path filename,
+                            std::string_view data,
+                            const executor& ex = default_executor()) {
+  return run_blocking(
+      [filename = std::move(filename), data] {
+        save_file(filename, data);
+      },
+      ex);
+}
+
+}  // namespace dvc
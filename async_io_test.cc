@@ -0,0 +1,99 @@
+#include "dvc/async_io.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/sha3.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(num_files, -, 2000, "files to hash in the benchmark");
+
+// Hashes every regular file under dir: each file is read on the I/O pool
+// and hashed on the executor, with every read in flight at once.
+dvc::task<std::vector<std::string>> hash_directory(
+    const std::filesystem::path& dir) {
+  std::vector<std::filesystem::path> files;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(dir))
+    if (entry.is_regular_file()) files.push_back(entry.path());
+  std::sort(files.begin(), files.end());
+
+  std::vector<dvc::task<std::string>> hashes;
+  for (const auto& file : files)
+    hashes.push_back([](std::filesystem::path file) -> dvc::task<std::string> {
+      std::string data = co_await dvc::async_load_file(std::move(file));
+      co_return dvc::SHA3(data);
+    }(file));
+  co_return co_await dvc::when_all(std::move(hashes));
+}
+
+std::vector<std::string> hash_directory_sync(const std::filesystem::path& dir) {
+  std::vector<std::filesystem::path> files;
+  for (const auto& entry : std::filesystem::recursive_directory_iterator(dir))
+    if (entry.is_regular_file()) files.push_back(entry.path());
+  std::sort(files.begin(), files.end());
+  std::vector<std::string> hashes;
+  for (const auto& file : files) hashes.push_back(dvc::SHA3(dvc::load_file(file)));
+  return hashes;
+}
+
+dvc::task<void> test_pread_pwrite(std::filesystem::path path) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  DVC_ASSERT_GE(fd, 0);
+  co_await dvc::async_pwrite(fd, "hello world", 11, 0);
+  co_await dvc::async_pwrite(fd, "W", 1, 6);
+  char buf[16];
+  size_t n = co_await dvc::async_pread(fd, buf, sizeof(buf), 0);
+  DVC_ASSERT_EQ(std::string_view(buf, n), "hello World");
+  n = co_await dvc::async_pread(fd, buf, sizeof(buf), 100);
+  DVC_ASSERT_EQ(n, 0u);
+  ::close(fd);
+
+  co_await dvc::async_save_file(path, "saved");
+  std::string saved = co_await dvc::async_load_file(path);
+  DVC_ASSERT_EQ(saved, "saved");
+
+  bool caught = false;
+  try {
+    co_await dvc::async_load_file(path / "missing");
+  } catch (const std::ios_base::failure&) {
+    caught = true;
+  }
+  DVC_ASSERT(caught);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  std::filesystem::path dir =
+      std::filesystem::temp_directory_path() /
+      dvc::concat("async_io_test.", ::getpid());
+  std::filesystem::create_directories(dir / "sub");
+
+  dvc::sync_wait(test_pread_pwrite(dir / "rw"));
+  std::filesystem::remove(dir / "rw");
+
+  for (size_t i = 0; i < num_files; i++)
+    dvc::save_file(dir / (i % 2 ? "sub" : "") / dvc::concat("f", i),
+                   std::string(i * 37 % 20000, char('a' + i % 26)));
+
+  size_t start = dvc::now();
+  std::vector<std::string> hashes = dvc::sync_wait(hash_directory(dir));
+  size_t middle = dvc::now();
+  std::vector<std::string> expected = hash_directory_sync(dir);
+  size_t end = dvc::now();
+  DVC_ASSERT_EQ(hashes.size(), num_files);
+  DVC_ASSERT(hashes == expected);
+
+  DVC_LOG("hash_directory: ", double(middle - start) / num_files,
+          "ns/file with ", dvc::default_pool().size(), " threads and ",
+          dvc::default_io_pool().size(), " I/O threads");
+  DVC_LOG("synchronous: ", double(end - middle) / num_files, "ns/file");
+
+  std::filesystem::remove_all(dir);
+}
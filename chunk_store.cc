@@ -0,0 +1,206 @@
+#include "dvc/chunk_store.h"
+
+#include <algorithm>
+#include <ios>
+
+#include "dvc/hex.h"
+#include "dvc/log.h"
+#include "dvc/sha3.h"
+#include "dvc/string.h"
+
+namespace dvc {
+namespace {
+
+constexpr std::string_view pack_magic = "DVCPACK1";
+
+// The number n of a pack-<n>.pack filename, or -1.
+int64_t pack_number(const std::filesystem::path& path) {
+  std::string name = path.filename().string();
+  std::string_view prefix = "pack-", suffix = ".pack";
+  if (name.size() <= prefix.size() + suffix.size() ||
+      name.compare(0, prefix.size(), prefix) != 0 ||
+      name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+    return -1;
+  std::string_view digits(name);
+  digits = digits.substr(prefix.size(),
+                         name.size() - prefix.size() - suffix.size());
+  int64_t n;
+  if (digits.empty() || !destring(digits, n)) return -1;
+  return n;
+}
+
+}  // namespace
+
+chunk_store::chunk_store(std::filesystem::path dir, const chunk_params& params,
+                         uint64_t max_pack_size)
+    : dir_(std::move(dir)), chunker_(params), max_pack_size_(max_pack_size) {
+  std::filesystem::create_directories(dir_);
+  std::vector<std::pair<int64_t, std::filesystem::path>> packs;
+  for (const auto& entry : std::filesystem::directory_iterator(dir_))
+    if (int64_t n = pack_number(entry.path()); n >= 0)
+      packs.emplace_back(n, entry.path());
+  std::sort(packs.begin(), packs.end());
+  for (const auto& [n, path] : packs) load_pack(path);
+  if (!packs.empty()) next_pack_ = packs.back().first + 1;
+}
+
+chunk_store::~chunk_store() { flush(); }
+
+std::filesystem::path chunk_store::pack_path(size_t pack) const {
+  return dir_ / concat("pack-", pack, ".pack");
+}
+
+void chunk_store::load_pack(const std::filesystem::path& path) {
+  // A crash can leave a pack empty or cut short anywhere, since it is
+  // written through a buffer, so a short header or index is skipped like a
+  // zero index offset.
+  file_reader r(path);
+  size_t header_size = pack_magic.size() + sizeof(uint64_t);
+  size_t file_size = r.size();
+  if (file_size < header_size) {
+    DVC_ERROR("ignoring truncated chunk pack ", path);
+    return;
+  }
+  if (r.read_string(pack_magic.size()) != pack_magic)
+    DVC_FAIL("not a chunk pack: ", path);
+  uint64_t index_offset = r.rread<uint64_t>();
+  if (index_offset == 0) {
+    DVC_ERROR("ignoring unfinished chunk pack ", path);
+    return;
+  }
+  std::vector<std::pair<chunk_id, location>> entries;
+  try {
+    if (index_offset < header_size || index_offset >= file_size)
+      throw std::ios_base::failure("index offset out of range");
+    r.seek(index_offset);
+    size_t count = r.vread();
+    for (size_t i = 0; i < count; i++) {
+      chunk_id id = r.rread<chunk_id>();
+      location loc;
+      loc.offset = r.vread();
+      loc.size = r.vread();
+      if (loc.offset < header_size || loc.offset + loc.size > index_offset)
+        throw std::ios_base::failure("chunk out of range");
+      entries.emplace_back(id, loc);
+    }
+  } catch (const std::ios_base::failure&) {
+    DVC_ERROR("ignoring chunk pack with truncated index ", path);
+    return;
+  }
+  uint32_t pack = pack_paths_.size();
+  pack_paths_.push_back(path);
+  readers_.emplace_back();
+  index_.reserve(index_.size() + entries.size());
+  for (auto& [id, loc] : entries) {
+    loc.pack = pack;
+    if (index_.try_emplace(id, loc).second) {
+      stats_.chunks_stored++;
+      stats_.bytes_stored += loc.size;
+    }
+  }
+}
+
+std::vector<chunk_id> chunk_store::add(std::string_view data,
+                                       thread_pool& pool) {
+  std::vector<size_t> ends = chunker_.parallel_ends(data, pool);
+  std::vector<chunk_id> ids(ends.size());
+  auto chunk = [&](size_t i) {
+    size_t begin = i == 0 ? 0 : ends[i - 1];
+    return data.substr(begin, ends[i] - begin);
+  };
+  pool.parallel_for(0, ids.size(), [&](size_t i) {
+    std::string_view c = chunk(i);
+    SHA3_256(c.data(), c.size(), ids[i].data());
+  });
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (!index_.contains(ids[i])) store(ids[i], chunk(i));
+  }
+  stats_.chunks_added += ids.size();
+  stats_.bytes_added += data.size();
+  return ids;
+}
+
+std::vector<chunk_id> chunk_store::add_file(
+    const std::filesystem::path& filename, thread_pool& pool) {
+  return add(read_file(filename), pool);
+}
+
+void chunk_store::store(const chunk_id& id, std::string_view data) {
+  if (!writer_) {
+    pack_paths_.push_back(pack_path(next_pack_++));
+    readers_.emplace_back();
+    writer_ = std::make_unique<file_writer>(pack_paths_.back(), truncate);
+    writer_->write(pack_magic);
+    index_backpatch_ = writer_->prepare_backpatch<uint64_t>();
+  }
+  location loc;
+  loc.pack = pack_paths_.size() - 1;
+  loc.offset = writer_->tell();
+  loc.size = data.size();
+  writer_->write(data);
+  index_.try_emplace(id, loc);
+  pending_.push_back(id);
+  stats_.chunks_stored++;
+  stats_.bytes_stored += data.size();
+  if (writer_->tell() >= max_pack_size_) finish_pack();
+}
+
+void chunk_store::finish_pack() {
+  uint64_t index_offset = writer_->tell();
+  writer_->vwrite(pending_.size());
+  for (const chunk_id& id : pending_) {
+    const location& loc = index_.find(id)->second;
+    writer_->write(id.data(), id.size());
+    writer_->vwrite(loc.offset);
+    writer_->vwrite(loc.size);
+  }
+  writer_->write_backpatch(index_backpatch_, index_offset);
+  writer_.reset();
+  pending_.clear();
+}
+
+void chunk_store::flush() {
+  if (writer_) finish_pack();
+}
+
+file_reader& chunk_store::reader(uint32_t pack) {
+  if (writer_ && pack == pack_paths_.size() - 1) writer_->ostream().flush();
+  if (!readers_[pack])
+    readers_[pack] = std::make_unique<file_reader>(pack_paths_[pack]);
+  return *readers_[pack];
+}
+
+const chunk_store::location& chunk_store::find_or_fail(const chunk_id& id) {
+  auto it = index_.find(id);
+  if (it == index_.end())
+    DVC_FAIL("chunk not found: ", ByteArrayToHexString(id));
+  return it->second;
+}
+
+void chunk_store::read_chunk(const location& loc, char* out) {
+  file_reader& r = reader(loc.pack);
+  r.seek(loc.offset);
+  r.read(out, loc.size);
+}
+
+std::string chunk_store::get(const chunk_id& id) {
+  const location& loc = find_or_fail(id);
+  std::string result(loc.size, '\0');
+  read_chunk(loc, result.data());
+  return result;
+}
+
+std::string chunk_store::read(const std::vector<chunk_id>& ids) {
+  size_t size = 0;
+  for (const chunk_id& id : ids) size += find_or_fail(id).size;
+  std::string result(size, '\0');
+  char* out = result.data();
+  for (const chunk_id& id : ids) {
+    const location& loc = find_or_fail(id);
+    read_chunk(loc, out);
+    out += loc.size;
+  }
+  return result;
+}
+
+}  // namespace dvc
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dvc/chunker.h"
+#include "dvc/file.h"
+#include "dvc/flat_hash_map.h"
+#include "dvc/thread_pool.h"
+
+namespace dvc {
+
+// The SHA3-256 of a chunk's contents.
+using chunk_id = std::array<std::byte, 32>;
+
+// Chunk ids are already uniformly distributed, so any 8 bytes will do.
+struct chunk_id_hash {
+  size_t operator()(const chunk_id& id) const {
+    uint64_t h;
+    std::memcpy(&h, id.data(), sizeof(h));
+    return h;
+  }
+};
+
+// A content-addressed store of chunks in a directory of pack files.  Data
+// added to the store is split by a chunker, and only chunks whose ids are
+// not already present are written, so successive versions of a large file
+// share storage for their unchanged regions.
+//
+// Each pack-<n>.pack file is:
+//
+//   "DVCPACK1"
+//   uint64 offset of the index, backpatched when the pack is finished
+//   chunk contents
+//   index: varint count, then per chunk its 32-byte id and varint offset
+//          and size
+//
+// Chunks are appended to one open pack, which is finished when it reaches
+// max_pack_size, by flush(), or on destruction.  An unfinished pack left by
+// a crash is ignored when the store is reopened.  Not thread-safe.
+class chunk_store {
+ public:
+  struct statistics {
+    uint64_t chunks_added = 0;   // by add(), including duplicates
+    uint64_t bytes_added = 0;
+    uint64_t chunks_stored = 0;  // unique chunks in the store
+    uint64_t bytes_stored = 0;
+  };
+
+  explicit chunk_store(std::filesystem::path dir,
+                       const chunk_params& params = chunk_params(),
+                       uint64_t max_pack_size = uint64_t(1) << 30);
+  ~chunk_store();
+
+  chunk_store(const chunk_store&) = delete;
+  chunk_store& operator=(const chunk_store&) = delete;
+
+  // Splits data into chunks, stores the new ones, and returns the ids of
+  // all of them in order.  Chunking and hashing run on pool.
+  std::vector<chunk_id> add(std::string_view data,
+                            thread_pool& pool = default_pool());
+  // As add, with the contents of filename, which are read rather than
+  // mapped so that a file truncated meanwhile can't fault.
+  std::vector<chunk_id> add_file(const std::filesystem::path& filename,
+                                 thread_pool& pool = default_pool());
+
+  bool contains(const chunk_id& id) const { return index_.contains(id); }
+
+  // A stored chunk's contents; fails if id is not in the store.
+  std::string get(const chunk_id& id);
+
+  // The concatenated contents of ids, as returned by add().
+  std::string read(const std::vector<chunk_id>& ids);
+
+  // Finishes the open pack, if any.
+  void flush();
+
+  const statistics& stats() const { return stats_; }
+  // Including the open pack, if any.
+  size_t num_packs() const { return pack_paths_.size(); }
+
+ private:
+  struct location {
+    uint32_t pack;
+    uint32_t size;
+    uint64_t offset;
+  };
+
+  std::filesystem::path pack_path(size_t pack) const;
+  void load_pack(const std::filesystem::path& path);
+  void store(const chunk_id& id, std::string_view data);
+  void finish_pack();
+  file_reader& reader(uint32_t pack);
+  const location& find_or_fail(const chunk_id& id);
+  void read_chunk(const location& loc, char* out);
+
+  std::filesystem::path dir_;
+  chunker chunker_;
+  uint64_t max_pack_size_;
+  statistics stats_;
+
+  flat_hash_map<chunk_id, location, chunk_id_hash> index_;
+  std::vector<std::filesystem::path> pack_paths_;  // by location::pack
+  size_t next_pack_ = 0;
+  std::vector<std::unique_ptr<file_reader>> readers_;
+
+  // The open pack, if any, and the index entries it will end with.
+  std::unique_ptr<file_writer> writer_;
+  size_t index_backpatch_ = 0;
+  std::vector<chunk_id> pending_;
+};
+
+}  // namespace dvc
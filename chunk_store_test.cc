@@ -0,0 +1,165 @@
+#include "dvc/chunk_store.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(snapshot_mb, -, 16, "size of each benchmark snapshot");
+size_t DVC_OPTION(snapshots, -, 5, "number of benchmark snapshots");
+size_t DVC_OPTION(edits, -, 20, "random edits between benchmark snapshots");
+
+std::string random_data(size_t size, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::string s(size, '\0');
+  for (size_t i = 0; i + 8 <= size; i += 8) {
+    uint64_t x = rng();
+    std::memcpy(&s[i], &x, 8);
+  }
+  return s;
+}
+
+// Inserts, deletes or overwrites a few bytes at random places.
+void edit(std::string& s, size_t edits, std::mt19937_64& rng) {
+  for (size_t i = 0; i < edits; i++) {
+    size_t pos = rng() % s.size();
+    size_t len = 1 + rng() % 100;
+    switch (rng() % 3) {
+      case 0:
+        s.insert(pos, random_data(len, rng()));
+        break;
+      case 1:
+        s.erase(pos, len);
+        break;
+      default:
+        s.replace(pos, len, random_data(len, rng()));
+    }
+  }
+}
+
+void test_chunker() {
+  dvc::chunk_params params(4096);
+  dvc::chunker chunker(params);
+  std::string data = random_data(8 << 20, 1);
+
+  std::vector<size_t> ends = chunker.ends(data);
+  DVC_ASSERT_EQ(ends.back(), data.size());
+  size_t begin = 0;
+  for (size_t i = 0; i < ends.size(); i++) {
+    size_t size = ends[i] - begin;
+    DVC_ASSERT_LE(size, params.max_size);
+    if (i + 1 < ends.size()) DVC_ASSERT_GE(size, params.min_size);
+    begin = ends[i];
+  }
+  double avg = double(data.size()) / ends.size();
+  DVC_ASSERT(avg > params.avg_size / 2 && avg < params.avg_size * 2, avg);
+
+  for (size_t threads : {1, 3, 8}) {
+    dvc::thread_pool pool(threads);
+    DVC_ASSERT(chunker.parallel_ends(data, pool) == ends, threads);
+    DVC_ASSERT(chunker.parallel_ends(std::string_view(data).substr(12345),
+                                     pool) ==
+                   chunker.ends(std::string_view(data).substr(12345)),
+               threads);
+  }
+  DVC_ASSERT(chunker.ends("").empty());
+  DVC_ASSERT(chunker.ends("abc") == std::vector<size_t>{3});
+
+  // An insertion near the start moves only the chunks around it.
+  std::string shifted = "inserted" + data;
+  std::vector<size_t> shifted_ends = chunker.ends(shifted);
+  size_t shared = 0;
+  for (size_t end : shifted_ends)
+    if (std::binary_search(ends.begin(), ends.end(), end - 8)) shared++;
+  DVC_ASSERT_GE(shared + 3, ends.size());
+}
+
+void test_store(const std::filesystem::path& dir) {
+  dvc::chunk_params params(4096);
+  std::string a = random_data(1 << 20, 2);
+  std::string b = a;
+  std::mt19937_64 rng(3);
+  edit(b, 5, rng);
+
+  std::vector<dvc::chunk_id> ids_a, ids_b;
+  {
+    dvc::chunk_store store(dir, params, 256 << 10);
+    ids_a = store.add(a);
+    uint64_t stored = store.stats().bytes_stored;
+    DVC_ASSERT_EQ(stored, a.size());
+    DVC_ASSERT(store.add(a) == ids_a);
+    DVC_ASSERT_EQ(store.stats().bytes_stored, stored);
+    ids_b = store.add(b);
+    DVC_ASSERT_LT(store.stats().bytes_stored, stored + b.size() / 4);
+    DVC_ASSERT_GT(store.num_packs(), 1u);
+    DVC_ASSERT(store.read(ids_a) == a);
+    DVC_ASSERT(store.read(ids_b) == b);
+    std::string_view first(a.data(), store.get(ids_a[0]).size());
+    DVC_ASSERT(store.get(ids_a[0]) == first);
+  }
+
+  // A pack left unfinished by a crash is ignored, whether its header was
+  // written, or nothing was, or its index was cut short.
+  dvc::save_file(dir / "pack-1000.pack",
+                 std::string("DVCPACK1") + std::string(8, '\0') + "junk");
+  dvc::save_file(dir / "pack-998.pack", "");
+  dvc::save_file(dir / "pack-999.pack",
+                 std::string("DVCPACK1") + std::string("\x14", 1) +
+                     std::string(7, '\0') + "junk\x05");
+
+  dvc::chunk_store store(dir, params);
+  for (const auto& id : ids_b) DVC_ASSERT(store.contains(id));
+  DVC_ASSERT(store.read(ids_a) == a);
+  DVC_ASSERT(store.read(ids_b) == b);
+  uint64_t stored = store.stats().bytes_stored;
+  store.add(b);
+  DVC_ASSERT_EQ(store.stats().bytes_stored, stored);
+  store.add("new");
+  dvc::save_file(dir / "file", b);
+  DVC_ASSERT(store.add_file(dir / "file") == ids_b);
+  store.flush();
+  DVC_ASSERT(std::filesystem::exists(dir / "pack-1001.pack"));
+}
+
+void benchmark(const std::filesystem::path& dir) {
+  std::string snapshot = random_data(snapshot_mb << 20, 4);
+  std::mt19937_64 rng(5);
+  dvc::chunk_store store(dir);
+
+  dvc::chunker chunker;
+  size_t start = dvc::now();
+  size_t chunks = chunker.parallel_ends(snapshot).size();
+  DVC_LOG("chunked ", snapshot_mb, "MB into ", chunks, " chunks at ",
+          double(snapshot.size()) / (dvc::now() - start), "GB/s");
+
+  start = dvc::now();
+  for (size_t i = 0; i < snapshots; i++) {
+    store.add(snapshot);
+    edit(snapshot, edits, rng);
+  }
+  store.flush();
+  size_t end = dvc::now();
+  const auto& stats = store.stats();
+  DVC_LOG("ingested ", snapshots, " snapshots of ", snapshot_mb, "MB at ",
+          double(stats.bytes_added) / (end - start), "GB/s with ",
+          dvc::default_pool().size(), " threads: ", stats.chunks_added,
+          " chunks, ", stats.chunks_stored, " unique, dedup ratio ",
+          double(stats.bytes_added) / stats.bytes_stored);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              dvc::concat("chunk_store_test.", ::getpid());
+  test_chunker();
+  test_store(dir / "store");
+  benchmark(dir / "benchmark");
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "dvc/hash.h"
+#include "dvc/log.h"
+#include "dvc/thread_pool.h"
+
+namespace dvc {
+
+// Sizes for content-defined chunking.  Chunks are at least min_size and at
+// most max_size bytes, and average about avg_size, which must be a power of
+// two.
+struct chunk_params {
+  explicit chunk_params(size_t avg_size = 64 << 10)
+      : min_size(avg_size / 4), avg_size(avg_size), max_size(avg_size * 4) {}
+
+  size_t min_size;
+  size_t avg_size;
+  size_t max_size;
+};
+
+namespace chunker_detail {
+
+constexpr std::array<uint64_t, 256> make_gear_table() {
+  std::array<uint64_t, 256> table = {};
+  for (size_t i = 0; i < 256; i++) table[i] = mix64(i + 0x6a09e667f3bcc908u);
+  return table;
+}
+
+inline constexpr std::array<uint64_t, 256> gear = make_gear_table();
+
+// A mask of bits high bits.  The Gear hash shifts left once per byte, so
+// its high bits depend on the most bytes.
+constexpr uint64_t high_mask(int bits) {
+  return bits <= 0 ? 0 : ~uint64_t(0) << (64 - bits);
+}
+
+inline int log2(size_t n) {
+  int bits = 0;
+  while ((size_t(1) << (bits + 1)) <= n) bits++;
+  return bits;
+}
+
+}  // namespace chunker_detail
+
+// FastCDC: cut points are where a Gear rolling hash of the preceding bytes
+// has its masked bits all zero, so they move with the content when bytes
+// are inserted or removed and most chunks of an edited file are unchanged.
+// Normalized chunking uses a stricter mask before avg_size and a looser one
+// after, which narrows the spread of chunk sizes.
+class chunker {
+ public:
+  explicit chunker(const chunk_params& params = chunk_params())
+      : params_(params) {
+    DVC_ASSERT_EQ(params.avg_size & (params.avg_size - 1), 0u,
+                  "avg_size must be a power of two");
+    DVC_ASSERT(params.min_size <= params.avg_size &&
+               params.avg_size <= params.max_size);
+    int bits = chunker_detail::log2(params.avg_size);
+    mask_small_ = chunker_detail::high_mask(bits + 2);
+    mask_large_ = chunker_detail::high_mask(bits - 2);
+  }
+
+  const chunk_params& params() const { return params_; }
+
+  // The length of the chunk starting at data[0].
+  size_t cut(const char* data, size_t size) const {
+    if (size <= params_.min_size) return size;
+    size_t end = std::min(size, params_.max_size);
+    size_t normal = std::min(end, params_.avg_size);
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
+    uint64_t h = 0;
+    size_t i = params_.min_size;
+    for (; i < normal; i++) {
+      h = (h << 1) + chunker_detail::gear[bytes[i]];
+      if (!(h & mask_small_)) return i + 1;
+    }
+    for (; i < end; i++) {
+      h = (h << 1) + chunker_detail::gear[bytes[i]];
+      if (!(h & mask_large_)) return i + 1;
+    }
+    return end;
+  }
+
+  // Appends to ends the end offsets of the chunks of data from begin on,
+  // stopping after the first chunk that ends at or after stop.
+  void append_ends(std::string_view data, size_t begin, size_t stop,
+                   std::vector<size_t>& ends) const {
+    for (size_t pos = begin; pos < stop && pos < data.size();) {
+      pos += cut(data.data() + pos, data.size() - pos);
+      ends.push_back(pos);
+    }
+  }
+
+  // The end offsets of data's chunks, in order.
+  std::vector<size_t> ends(std::string_view data) const {
+    std::vector<size_t> result;
+    result.reserve(data.size() / params_.avg_size + 1);
+    append_ends(data, 0, data.size(), result);
+    return result;
+  }
+
+  // As ends(), computed on pool.  Each thread chunks a segment from its
+  // start; since the hash restarts at every cut, a segment's cuts agree
+  // with the sequential ones from the first cut they share, so each
+  // segment is stitched on by chunking sequentially from the previous
+  // segment's last cut until reaching one of its cuts.
+  std::vector<size_t> parallel_ends(std::string_view data,
+                                    thread_pool& pool = default_pool()) const {
+    size_t segment = std::max(64 * params_.max_size,
+                              data.size() / (4 * pool.size()) + 1);
+    size_t segments = (data.size() + segment - 1) / segment;
+    if (segments <= 1) return ends(data);
+
+    std::vector<std::vector<size_t>> parts(segments);
+    pool.parallel_for(
+        0, segments,
+        [&](size_t k) {
+          size_t begin = k * segment;
+          parts[k].reserve(segment / params_.avg_size + 1);
+          append_ends(data, begin, std::min(begin + segment, data.size()),
+                      parts[k]);
+        },
+        1);
+
+    std::vector<size_t> result;
+    result.reserve(data.size() / params_.avg_size + 1);
+    size_t pos = 0;
+    for (size_t k = 0; k < segments; k++) {
+      size_t begin = k * segment;
+      size_t end = std::min(begin + segment, data.size());
+      const std::vector<size_t>& part = parts[k];
+      auto next = part.begin();
+      bool synced = pos == begin;
+      while (!synced && pos < end) {
+        next = std::lower_bound(next, part.end(), pos);
+        if (next != part.end() && *next == pos) {
+          ++next;
+          synced = true;
+        } else {
+          pos += cut(data.data() + pos, data.size() - pos);
+          result.push_back(pos);
+        }
+      }
+      if (synced && next != part.end()) {
+        result.insert(result.end(), next, part.end());
+        pos = part.back();
+      }
+    }
+    return result;
+  }
+
+ private:
+  chunk_params params_;
+  uint64_t mask_small_;
+  uint64_t mask_large_;
+};
+
+}  // namespace dvc
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include "dvc/time.h"
+
+namespace dvc {
+
+// A fast monotonic clock based on the CPU timestamp counter.
+//
+// ticks() is a single rdtsc when the CPU has an invariant TSC (constant rate
+// across frequency changes and sleep states, synchronized between cores), and
+// falls back to now() otherwise.  to_ns() converts tick differences to
+// nanoseconds using a rate calibrated against now() over about 10ms on first
+// use.
+class tsc_clock {
+ public:
+  static bool invariant_tsc() { return calibration().invariant; }
+
+  static uint64_t ticks() {
+#if defined(__x86_64__)
+    if (calibration().invariant) return __rdtsc();
+#endif
+    return now();
+  }
+
+  // Like ticks(), but waits for all earlier instructions to complete (rdtscp)
+  // so that they are not measured as happening after the read.
+  static uint64_t ticks_ordered() {
+#if defined(__x86_64__)
+    if (calibration().invariant) {
+      unsigned int aux;
+      return __rdtscp(&aux);
+    }
+#endif
+    return now();
+  }
+
+  static uint64_t to_ns(uint64_t ticks) {
+    return uint64_t((unsigned __int128)ticks * calibration().ns_per_tick_q32 >>
+                    32);
+  }
+
+  static double ticks_per_ns() {
+    return double(uint64_t(1) << 32) / calibration().ns_per_tick_q32;
+  }
+
+  // Nanoseconds since an arbitrary epoch; not comparable with now().
+  static uint64_t now_ns() { return to_ns(ticks()); }
+
+ private:
+  struct calibration_data {
+    bool invariant = false;
+    // Nanoseconds per tick in 32.32 fixed point.
+    uint64_t ns_per_tick_q32 = uint64_t(1) << 32;
+  };
+
+  static const calibration_data& calibration() {
+    static const calibration_data data = calibrate();
+    return data;
+  }
+
+  static calibration_data calibrate() {
+    calibration_data data;
+#if defined(__x86_64__)
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+      return data;
+    __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1u << 8))) return data;
+
+    uint64_t ns0 = now();
+    uint64_t tsc0 = __rdtsc();
+    uint64_t ns1;
+    do {
+      ns1 = now();
+    } while (ns1 - ns0 < 10000000);
+    uint64_t tsc1 = __rdtsc();
+    data.invariant = true;
+    data.ns_per_tick_q32 = uint64_t(
+        (unsigned __int128)(ns1 - ns0) * (uint64_t(1) << 32) / (tsc1 - tsc0));
+#endif
+    return data;
+  }
+};
+
+// Measures elapsed time with tsc_clock.
+class stopwatch {
+ public:
+  stopwatch() : start_(tsc_clock::ticks()) {}
+
+  void restart() { start_ = tsc_clock::ticks(); }
+
+  uint64_t elapsed_ticks() const { return tsc_clock::ticks() - start_; }
+  uint64_t elapsed_ns() const { return tsc_clock::to_ns(elapsed_ticks()); }
+  double elapsed_seconds() const { return elapsed_ns() * 1e-9; }
+
+  // Returns the elapsed nanoseconds and restarts.
+  uint64_t lap_ns() {
+    uint64_t ticks = tsc_clock::ticks();
+    uint64_t elapsed = tsc_clock::to_ns(ticks - start_);
+    start_ = ticks;
+    return elapsed;
+  }
+
+ private:
+  uint64_t start_;
+};
+
+}  // namespace dvc
@@ -0,0 +1,65 @@
+#include "dvc/clock.h"
+
+#include <thread>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+
+template <typename F>
+void bench(const char* name, F read) {
+  constexpr size_t n = size_t(1) << 22;
+  uint64_t sink = 0;
+  dvc::stopwatch watch;
+  for (size_t i = 0; i < n; i++) sink += read();
+  DVC_LOG(name, ": ", double(watch.elapsed_ns()) / n, "ns per read");
+  DVC_ASSERT_NE(sink, 0u);
+}
+
+void test_read_cost() {
+  bench("system_clock", [] {
+    return uint64_t(
+        std::chrono::system_clock::now().time_since_epoch().count());
+  });
+  bench("steady_clock (dvc::now)", [] { return dvc::now(); });
+  bench("CLOCK_MONOTONIC_RAW (dvc::now_raw)", [] { return dvc::now_raw(); });
+  bench("tsc_clock::ticks", [] { return dvc::tsc_clock::ticks(); });
+  bench("tsc_clock::ticks_ordered",
+        [] { return dvc::tsc_clock::ticks_ordered(); });
+  bench("tsc_clock::now_ns", [] { return dvc::tsc_clock::now_ns(); });
+}
+
+void test_monotonic() {
+  uint64_t now = dvc::now(), raw = dvc::now_raw();
+  uint64_t ticks = dvc::tsc_clock::ticks();
+  for (size_t i = 0; i < 1000000; i++) {
+    uint64_t next_now = dvc::now(), next_raw = dvc::now_raw();
+    uint64_t next_ticks = dvc::tsc_clock::ticks();
+    DVC_ASSERT_GE(next_now, now);
+    DVC_ASSERT_GE(next_raw, raw);
+    DVC_ASSERT_GE(next_ticks, ticks);
+    now = next_now;
+    raw = next_raw;
+    ticks = next_ticks;
+  }
+}
+
+void test_stopwatch() {
+  DVC_LOG("invariant tsc: ", dvc::tsc_clock::invariant_tsc(),
+          ", ticks per ns: ", dvc::tsc_clock::ticks_per_ns());
+
+  dvc::stopwatch watch;
+  uint64_t start = dvc::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  uint64_t elapsed = watch.elapsed_ns();
+  uint64_t reference = dvc::now() - start;
+  DVC_ASSERT_GE(elapsed, 50000000u);
+  DVC_ASSERT_LT(std::abs(double(elapsed) / reference - 1), 0.01);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_stopwatch();
+  test_monotonic();
+  test_read_cost();
+}
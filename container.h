@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <type_traits>
 #include <utility>
 
 #include "dvc/log.h"
@@ -25,18 +26,46 @@ void sort(Container& container) {
   std::sort(container.begin(), container.end());
 }
 
+template <typename Container>
+void sort_unique(Container& container) {
+  dvc::sort(container);
+  container.erase(std::unique(container.begin(), container.end()),
+                  container.end());
+}
+
+namespace container_detail {
+
+template <typename Container, typename = void>
+struct is_associative : std::false_type {};
+
+template <typename Container>
+struct is_associative<Container, std::void_t<typename Container::key_type>>
+    : std::true_type {};
+
+// Looks up value by key in associative containers and by linear search in
+// sequences.
+template <typename Container, typename T>
+auto find(Container& container, const T& value) {
+  if constexpr (is_associative<std::remove_const_t<Container>>::value)
+    return container.find(value);
+  else
+    return std::find(container.begin(), container.end(), value);
+}
+
+}  // namespace container_detail
+
+// For maps and sets, value is a key and the element with that key is
+// returned.
 template <typename Container, typename T>
-typename Container::value_type& find_or_die(Container& container,
-                                            const T& value) {
-  auto it = std::find(container.begin(), container.end(), value);
+auto& find_or_die(Container& container, const T& value) {
+  auto it = container_detail::find(container, value);
   DVC_ASSERT(it != container.end(), "find_or_die failed");
   return *it;
 }
 
 template <typename Container, typename T>
-const typename Container::value_type& find_or_die(const Container& container,
-                                                  const T& value) {
-  auto it = std::find(container.begin(), container.end(), value);
+const auto& find_or_die(const Container& container, const T& value) {
+  auto it = container_detail::find(container, value);
   DVC_ASSERT(it != container.end(), "find_or_die failed");
   return *it;
 }
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dvc/hash.h"
+#include "dvc/log.h"
+
+namespace dvc {
+
+// A Count-Min sketch (Cormode and Muthukrishnan, 2005) of depth rows of width
+// counters.  estimate() never underestimates, and overestimates by more than
+// e / width of the total count with probability at most exp(-depth).
+// Updates are conservative: only the counters at the current minimum grow,
+// which reduces the overestimate without losing that guarantee for
+// insert-only streams.
+class count_min_sketch {
+ public:
+  explicit count_min_sketch(size_t width = 1 << 12, size_t depth = 4)
+      : width_(width), depth_(depth), counters_(width * depth) {
+    DVC_ASSERT_GT(width, 0u);
+    DVC_ASSERT_GT(depth, 0u);
+  }
+
+  template <typename T>
+  void add(const T& t, uint64_t count = 1) {
+    add_hash(hash64(t), count);
+  }
+
+  template <typename T>
+  uint64_t estimate(const T& t) const {
+    return estimate_hash(hash64(t));
+  }
+
+  // Returns the new estimate.
+  uint64_t add_hash(uint64_t h, uint64_t count = 1) {
+    total_ += count;
+    uint64_t target = estimate_hash(h) + count;
+    for (size_t row = 0; row < depth_; row++) {
+      uint64_t& counter = counters_[index(h, row)];
+      counter = std::max(counter, target);
+    }
+    return target;
+  }
+
+  uint64_t estimate_hash(uint64_t h) const {
+    uint64_t e = counters_[index(h, 0)];
+    for (size_t row = 1; row < depth_; row++)
+      e = std::min(e, counters_[index(h, row)]);
+    return e;
+  }
+
+  uint64_t total() const { return total_; }
+
+  void merge(const count_min_sketch& other) {
+    DVC_ASSERT_EQ(width_, other.width_);
+    DVC_ASSERT_EQ(depth_, other.depth_);
+    total_ += other.total_;
+    for (size_t i = 0; i < counters_.size(); i++)
+      counters_[i] += other.counters_[i];
+  }
+
+  template <typename Writer>
+  void write(Writer& writer) const {
+    writer.vwrite(width_);
+    writer.vwrite(depth_);
+    writer.vwrite(total_);
+    for (uint64_t counter : counters_) writer.vwrite(counter);
+  }
+
+  template <typename Reader>
+  static count_min_sketch read(Reader& reader) {
+    size_t width = reader.vread();
+    size_t depth = reader.vread();
+    count_min_sketch sketch(width, depth);
+    sketch.total_ = reader.vread();
+    for (uint64_t& counter : sketch.counters_) counter = reader.vread();
+    return sketch;
+  }
+
+ private:
+  // Row hashes by double hashing (Kirsch and Mitzenmacher, 2006).
+  size_t index(uint64_t h, size_t row) const {
+    uint64_t g = uint32_t(h) + row * (h >> 32 | 1);
+    return row * width_ + size_t((unsigned __int128)mix64(g) * width_ >> 64);
+  }
+
+  size_t width_;
+  size_t depth_;
+  uint64_t total_ = 0;
+  std::vector<uint64_t> counters_;
+};
+
+// The (approximately) most frequent items of a stream: a Count-Min sketch of
+// all items, plus the capacity items with the largest estimates so far.
+template <typename T>
+class heavy_hitters {
+ public:
+  explicit heavy_hitters(size_t capacity = 100,
+                         count_min_sketch sketch = count_min_sketch())
+      : capacity_(capacity), sketch_(std::move(sketch)) {}
+
+  void add(const T& t, uint64_t count = 1) {
+    uint64_t e = sketch_.add_hash(hash64(t), count);
+    if (e <= floor_ && candidates_.size() >= capacity_) return;
+    candidates_[t] = e;
+    if (candidates_.size() > 2 * capacity_) prune();
+  }
+
+  void merge(const heavy_hitters& other) {
+    sketch_.merge(other.sketch_);
+    for (const auto& [t, e] : other.candidates_) candidates_[t] = e;
+    for (auto& [t, e] : candidates_) e = sketch_.estimate(t);
+    prune();
+  }
+
+  const count_min_sketch& sketch() const { return sketch_; }
+
+  // The heaviest items and their estimated counts, heaviest first.
+  std::vector<std::pair<T, uint64_t>> top() const {
+    std::vector<std::pair<T, uint64_t>> result(candidates_.begin(),
+                                               candidates_.end());
+    std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+      return a.second > b.second;
+    });
+    if (result.size() > capacity_) result.resize(capacity_);
+    return result;
+  }
+
+  template <typename Writer>
+  void write(Writer& writer) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writer.vwrite(capacity_);
+    sketch_.write(writer);
+    writer.vwrite(candidates_.size());
+    for (const auto& [t, e] : candidates_) {
+      writer.rwrite(t);
+      writer.vwrite(e);
+    }
+  }
+
+  template <typename Reader>
+  static heavy_hitters read(Reader& reader) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    size_t capacity = reader.vread();
+    heavy_hitters result(capacity, count_min_sketch::read(reader));
+    for (size_t n = reader.vread(); n > 0; n--) {
+      T t = reader.template rread<T>();
+      result.candidates_[t] = reader.vread();
+    }
+    result.prune();
+    return result;
+  }
+
+ private:
+  // Keeps the capacity heaviest candidates; floor_ becomes the lightest.
+  void prune() {
+    if (candidates_.size() <= capacity_) return;
+    std::vector<uint64_t> estimates;
+    estimates.reserve(candidates_.size());
+    for (const auto& [t, e] : candidates_) estimates.push_back(e);
+    std::nth_element(estimates.begin(), estimates.begin() + capacity_ - 1,
+                     estimates.end(), std::greater<uint64_t>());
+    floor_ = estimates[capacity_ - 1];
+    for (auto it = candidates_.begin(); it != candidates_.end();)
+      if (it->second < floor_)
+        it = candidates_.erase(it);
+      else
+        ++it;
+  }
+
+  size_t capacity_;
+  count_min_sketch sketch_;
+  std::unordered_map<T, uint64_t, dvc::hash> candidates_;
+  uint64_t floor_ = 0;
+};
+
+}  // namespace dvc
@@ -0,0 +1,102 @@
+#include "dvc/count_min.h"
+
+#include <random>
+#include <thread>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/per_thread.h"
+#include "dvc/program.h"
+
+// Zipf-distributed keys: key k has frequency proportional to 1 / (k + 1).
+std::vector<uint64_t> zipf_keys(size_t n, size_t nkeys, uint64_t seed) {
+  std::vector<double> weights(nkeys);
+  for (size_t k = 0; k < nkeys; k++) weights[k] = 1.0 / (k + 1);
+  std::discrete_distribution<uint64_t> dist(weights.begin(), weights.end());
+  std::mt19937_64 ran(seed);
+  std::vector<uint64_t> keys(n);
+  for (uint64_t& key : keys) key = dist(ran);
+  return keys;
+}
+
+void test_accuracy() {
+  size_t n = size_t(1) << 24;
+  std::vector<uint64_t> keys = zipf_keys(n, 1000000, 1);
+  std::unordered_map<uint64_t, uint64_t> exact;
+  for (uint64_t key : keys) exact[key]++;
+
+  dvc::heavy_hitters<uint64_t> hitters(20);
+  size_t start = dvc::now();
+  for (uint64_t key : keys) hitters.add(key);
+  size_t end = dvc::now();
+  DVC_LOG("count_min: ", double(end - start) / n, "ns");
+
+  const dvc::count_min_sketch& sketch = hitters.sketch();
+  DVC_ASSERT_EQ(sketch.total(), n);
+  uint64_t max_error = 0;
+  for (const auto& [key, count] : exact) {
+    uint64_t e = sketch.estimate(key);
+    DVC_ASSERT_GE(e, count);
+    max_error = std::max(max_error, e - count);
+  }
+  DVC_LOG("count_min: max overestimate ", max_error, " of ", n);
+  DVC_ASSERT_LT(max_error, n * 2.72 / (1 << 12));
+
+  auto top = hitters.top();
+  DVC_ASSERT_EQ(top.size(), 20u);
+  for (size_t i = 0; i < 10; i++) DVC_ASSERT_EQ(top[i].first, i);
+}
+
+void test_threads(size_t nthreads) {
+  size_t n = size_t(1) << 24;
+  std::vector<uint64_t> keys = zipf_keys(n, 1000000, 2);
+
+  dvc::sharded<dvc::heavy_hitters<uint64_t>> hitters(
+      dvc::heavy_hitters<uint64_t>(10));
+  size_t start = dvc::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+    threads.emplace_back([&, t] {
+      auto& local = hitters.local();
+      for (size_t i = t; i < n; i += nthreads) local.add(keys[i]);
+    });
+  for (std::thread& thread : threads) thread.join();
+  auto merged = hitters.merged();
+  size_t end = dvc::now();
+
+  DVC_LOG("count_min ", nthreads, " threads: ", double(end - start) / n,
+          "ns");
+  DVC_ASSERT_EQ(merged.sketch().total(), n);
+  auto top = merged.top();
+  for (size_t i = 0; i < 5; i++) DVC_ASSERT_EQ(top[i].first, i);
+}
+
+void test_serialize() {
+  dvc::heavy_hitters<uint64_t> hitters(5, dvc::count_min_sketch(256, 3));
+  for (uint64_t key : zipf_keys(100000, 1000, 3)) hitters.add(key);
+
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "count_min_test.cms";
+  {
+    dvc::file_writer writer(path, dvc::truncate);
+    hitters.write(writer);
+  }
+  dvc::file_reader reader(path);
+  auto copy = dvc::heavy_hitters<uint64_t>::read(reader);
+  std::filesystem::remove(path);
+
+  DVC_ASSERT_EQ(copy.sketch().total(), hitters.sketch().total());
+  for (uint64_t key = 0; key < 1000; key++)
+    DVC_ASSERT_EQ(copy.sketch().estimate(key), hitters.sketch().estimate(key));
+  DVC_ASSERT(copy.top() == hitters.top());
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_accuracy();
+  for (size_t nthreads = 1; nthreads <= 2 * std::thread::hardware_concurrency();
+       nthreads *= 2)
+    test_threads(nthreads);
+  test_serialize();
+}
@@ -0,0 +1,322 @@
+#include "dvc/digest_cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+
+#include "dvc/hash.h"
+#include "dvc/log.h"
+#include "dvc/sha3.h"
+
+namespace dvc {
+namespace {
+
+constexpr std::string_view digest_cache_magic = "DVCDGST1";
+
+// Compaction waits for at least this many stale records.
+constexpr size_t min_stale_to_compact = 1024;
+
+[[noreturn]] void fail(const char* what, const std::filesystem::path& path) {
+  throw std::filesystem::filesystem_error(
+      what, path, std::error_code(errno, std::generic_category()));
+}
+
+void write_all(int fd, const void* buf, size_t n,
+               const std::filesystem::path& path) {
+  const char* p = static_cast<const char*>(buf);
+  while (n > 0) {
+    ssize_t r = ::write(fd, p, n);
+    if (r < 0) {
+      if (errno == EINTR) continue;
+      fail("write", path);
+    }
+    p += r;
+    n -= r;
+  }
+}
+
+}  // namespace
+
+size_t digest_size(digest_algorithm algorithm) {
+  switch (algorithm) {
+    case digest_algorithm::sha3_224:
+      return 28;
+    case digest_algorithm::sha3_256:
+      return 32;
+    case digest_algorithm::sha3_384:
+      return 48;
+    case digest_algorithm::sha3_512:
+      return 64;
+  }
+  DVC_FATAL("bad digest_algorithm ", int(algorithm));
+}
+
+std::string compute_digest(digest_algorithm algorithm, std::string_view data) {
+  std::string digest(digest_size(algorithm), '\0');
+  switch (algorithm) {
+    case digest_algorithm::sha3_224:
+      SHA3_224(data.data(), data.size(), digest.data());
+      break;
+    case digest_algorithm::sha3_256:
+      SHA3_256(data.data(), data.size(), digest.data());
+      break;
+    case digest_algorithm::sha3_384:
+      SHA3_384(data.data(), data.size(), digest.data());
+      break;
+    case digest_algorithm::sha3_512:
+      SHA3_512(data.data(), data.size(), digest.data());
+      break;
+  }
+  return digest;
+}
+
+// The on-disk record header, followed by the path and digest.
+struct digest_cache::record {
+  uint64_t checksum;
+  file_stat stat;
+  uint32_t path_size;
+  uint8_t algorithm;
+  uint8_t digest_size;
+  uint16_t zero;
+
+  static size_t total_size(size_t path_size, size_t digest_size) {
+    return (sizeof(record) + path_size + digest_size + 7) & ~size_t(7);
+  }
+  size_t total_size() const { return total_size(path_size, digest_size); }
+
+  std::string_view path() const {
+    return {reinterpret_cast<const char*>(this + 1), path_size};
+  }
+  std::string_view digest() const {
+    return {reinterpret_cast<const char*>(this + 1) + path_size, digest_size};
+  }
+
+  uint64_t compute_checksum() const {
+    return hash_bytes(&stat, total_size() - sizeof(checksum));
+  }
+};
+
+// An open-addressed table of the latest record for each path and
+// algorithm.  Slots are only ever filled or replaced, never emptied, so
+// readers can probe without locking.
+struct digest_cache::table {
+  explicit table(size_t capacity)
+      : mask(capacity - 1), slots(new std::atomic<const record*>[capacity]) {
+    for (size_t i = 0; i < capacity; i++)
+      slots[i].store(nullptr, std::memory_order_relaxed);
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+  size_t mask;
+  std::unique_ptr<std::atomic<const record*>[]> slots;
+};
+
+digest_cache::digest_cache(std::filesystem::path filename)
+    : filename_(std::move(filename)) {
+  std::lock_guard lock(mu_);
+  load();
+  fd_ = ::open(filename_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+  if (fd_ < 0) fail("open", filename_);
+}
+
+digest_cache::~digest_cache() {
+  if (compactor_.joinable()) compactor_.join();
+  ::close(fd_);
+}
+
+void digest_cache::reset_file() {
+  file_writer(filename_, truncate).write(digest_cache_magic);
+}
+
+void digest_cache::load() {
+  static_assert(sizeof(record) == 48);
+  std::error_code ec;
+  if (!std::filesystem::exists(filename_, ec)) return reset_file();
+  mapped_ = std::make_unique<mapped_file>(filename_);
+  std::string_view data = mapped_->data();
+  if (data.substr(0, digest_cache_magic.size()) != digest_cache_magic) {
+    DVC_ERROR("discarding digest cache ", filename_, ": bad magic");
+    mapped_.reset();
+    return reset_file();
+  }
+  size_t offset = digest_cache_magic.size();
+  while (data.size() - offset >= sizeof(record)) {
+    auto r = reinterpret_cast<const record*>(data.data() + offset);
+    if (r->total_size() > data.size() - offset ||
+        r->algorithm > uint8_t(digest_algorithm::sha3_512) ||
+        r->digest_size != digest_size(digest_algorithm(r->algorithm)) ||
+        r->checksum != r->compute_checksum())
+      break;
+    publish(r);
+    offset += r->total_size();
+  }
+  if (offset != data.size()) {
+    DVC_ERROR("truncating digest cache ", filename_, " from ", data.size(),
+              " to ", offset, " bytes");
+    if (::truncate(filename_.c_str(), offset) != 0)
+      fail("truncate", filename_);
+  }
+}
+
+const digest_cache::record* digest_cache::lookup(
+    const table& t, std::string_view path, digest_algorithm algorithm) const {
+  for (size_t i = hash64(path, uint64_t(algorithm)) & t.mask;;
+       i = (i + 1) & t.mask) {
+    const record* r = t.slots[i].load(std::memory_order_acquire);
+    if (!r) return nullptr;
+    if (r->algorithm == uint8_t(algorithm) && r->path() == path) return r;
+  }
+}
+
+void digest_cache::publish(const record* r) {
+  const table* t = table_.load(std::memory_order_relaxed);
+  if (!t || (live_ + 1) * 2 > t->capacity()) {
+    auto grown = std::make_unique<table>(t ? t->capacity() * 2 : 1024);
+    if (t) {
+      for (size_t i = 0; i < t->capacity(); i++) {
+        const record* old = t->slots[i].load(std::memory_order_relaxed);
+        if (!old) continue;
+        size_t j = hash64(old->path(), old->algorithm) & grown->mask;
+        while (grown->slots[j].load(std::memory_order_relaxed))
+          j = (j + 1) & grown->mask;
+        grown->slots[j].store(old, std::memory_order_relaxed);
+      }
+    }
+    t = grown.get();
+    tables_.push_back(std::move(grown));
+    table_.store(t, std::memory_order_release);
+  }
+  for (size_t i = hash64(r->path(), r->algorithm) & t->mask;;
+       i = (i + 1) & t->mask) {
+    const record* old = t->slots[i].load(std::memory_order_relaxed);
+    if (!old) {
+      live_++;
+    } else if (old->algorithm == r->algorithm && old->path() == r->path()) {
+      stale_++;
+    } else {
+      continue;
+    }
+    t->slots[i].store(r, std::memory_order_release);
+    return;
+  }
+}
+
+std::optional<std::string_view> digest_cache::find(
+    std::string_view path, digest_algorithm algorithm,
+    const file_stat& stat) const {
+  const table* t = table_.load(std::memory_order_acquire);
+  const record* r = t ? lookup(*t, path, algorithm) : nullptr;
+  if (r && r->stat == stat) {
+    stats_.hits.fetch_add(1, std::memory_order_relaxed);
+    return r->digest();
+  }
+  if (r) stats_.invalidations.fetch_add(1, std::memory_order_relaxed);
+  stats_.misses.fetch_add(1, std::memory_order_relaxed);
+  return std::nullopt;
+}
+
+std::string digest_cache::digest(const std::filesystem::path& path,
+                                 digest_algorithm algorithm) {
+  return digest(path, algorithm, file_stat::of(path));
+}
+
+std::string digest_cache::digest(const std::filesystem::path& path,
+                                 digest_algorithm algorithm,
+                                 const file_stat& stat) {
+  if (auto cached = find(path.native(), algorithm, stat))
+    return std::string(*cached);
+  std::string digest = compute_digest(algorithm, read_file(path));
+  // Only cache what was read if the file didn't change meanwhile.
+  if (!stat.racy() && file_stat::of(path) == stat)
+    insert(path.native(), algorithm, stat, digest);
+  return digest;
+}
+
+void digest_cache::insert(std::string_view path, digest_algorithm algorithm,
+                          const file_stat& stat, std::string_view digest) {
+  DVC_ASSERT_EQ(digest.size(), digest_size(algorithm));
+  std::lock_guard lock(mu_);
+  size_t size = record::total_size(path.size(), digest.size());
+  void* p = arena_.alloc(size, alignof(record));
+  std::memset(p, 0, size);
+  auto r = static_cast<record*>(p);
+  r->stat = stat;
+  r->path_size = path.size();
+  r->algorithm = uint8_t(algorithm);
+  r->digest_size = digest.size();
+  char* tail = reinterpret_cast<char*>(r + 1);
+  std::memcpy(tail, path.data(), path.size());
+  std::memcpy(tail + path.size(), digest.data(), digest.size());
+  r->checksum = r->compute_checksum();
+  write_all(fd_, r, size, filename_);
+  publish(r);
+  if (compacting_) appended_.push_back(r);
+  maybe_compact();
+}
+
+void digest_cache::compact() {
+  std::lock_guard compact_lock(compact_mu_);
+  // The live records are written without holding mu_, since records are
+  // never changed or freed; those inserted meanwhile are collected in
+  // appended_ and written after.
+  std::vector<const record*> records;
+  {
+    std::lock_guard lock(mu_);
+    compacting_ = true;
+    if (const table* t = table_.load(std::memory_order_relaxed)) {
+      records.reserve(live_);
+      for (size_t i = 0; i < t->capacity(); i++)
+        if (const record* r = t->slots[i].load(std::memory_order_relaxed))
+          records.push_back(r);
+    }
+  }
+  std::filesystem::path tmp = filename_;
+  tmp += ".tmp";
+  file_writer writer(tmp, truncate);
+  writer.write(digest_cache_magic);
+  for (const record* r : records) writer.write(r, r->total_size());
+
+  std::lock_guard lock(mu_);
+  compacting_ = false;
+  std::vector<const record*> appended = std::move(appended_);
+  appended_.clear();
+  for (const record* r : appended) writer.write(r, r->total_size());
+  writer.close();
+  std::filesystem::rename(tmp, filename_);
+  ::close(fd_);
+  fd_ = ::open(filename_.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+  if (fd_ < 0) fail("open", filename_);
+  stale_ = records.size() + appended.size() - live_;
+  stats_.compactions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void digest_cache::maybe_compact() {
+  if (compaction_scheduled_ || stale_ < min_stale_to_compact ||
+      stale_ <= live_)
+    return;
+  compaction_scheduled_ = true;
+  // A previous compactor has finished, having cleared the flag.
+  if (compactor_.joinable()) compactor_.join();
+  compactor_ = std::thread([this] {
+    compact();
+    std::lock_guard lock(mu_);
+    compaction_scheduled_ = false;
+  });
+}
+
+size_t digest_cache::size() const {
+  std::lock_guard lock(mu_);
+  return live_;
+}
+
+size_t digest_cache::stale() const {
+  std::lock_guard lock(mu_);
+  return stale_;
+}
+
+}  // namespace dvc
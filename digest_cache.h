@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "dvc/arena.h"
+#include "dvc/file.h"
+
+namespace dvc {
+
+enum class digest_algorithm : uint8_t {
+  sha3_224,
+  sha3_256,
+  sha3_384,
+  sha3_512,
+};
+
+// The size in bytes of an algorithm's digests.
+size_t digest_size(digest_algorithm algorithm);
+
+// The digest of data as raw bytes.
+std::string compute_digest(digest_algorithm algorithm, std::string_view data);
+
+// A persistent cache of file digests, so that re-hashing an unchanged file
+// costs one stat.  Entries are keyed by path and algorithm, and are valid
+// while the file's file_stat is unchanged.
+//
+// The cache file is a log of records:
+//
+//   "DVCDGST1"
+//   records, each 8-byte aligned: uint64 checksum of the rest of the record,
+//   uint64 dev, ino, size, int64 mtime_ns, uint32 path size, uint8
+//   algorithm, uint8 digest size, uint16 zero, path, digest, zero padding
+//
+// It is mmap'd when opened, and new and changed entries are appended.  A
+// torn record at the end, left by a crash, is truncated away.  When the log
+// holds more stale records than live ones it is rewritten on a background
+// thread.  The checksum is hash_bytes(), so a cache written by a different
+// version of this library may be discarded.
+//
+// find() and digest() are lock-free on cache hits, and may be called from
+// any number of threads concurrently with each other and with insert().
+// Writers are serialized.  A cache file may be used by only one process at
+// a time.
+class digest_cache {
+ public:
+  struct statistics {
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};         // including invalidations
+    std::atomic<uint64_t> invalidations{0};  // entries whose stat changed
+    std::atomic<uint64_t> compactions{0};
+  };
+
+  explicit digest_cache(std::filesystem::path filename);
+  ~digest_cache();
+
+  digest_cache(const digest_cache&) = delete;
+  digest_cache& operator=(const digest_cache&) = delete;
+
+  // The digest of the file at path, from the cache if its stat matches,
+  // otherwise by reading and hashing it and caching the result.  The file
+  // is read rather than mapped, so one truncated meanwhile can't fault; it
+  // is only cached if its stat is unchanged after.  A file modified within
+  // the last couple of seconds is not cached, since it may change again
+  // without its mtime changing.
+  std::string digest(const std::filesystem::path& path,
+                     digest_algorithm algorithm = digest_algorithm::sha3_256);
+
+  // Like digest(), given the file's stat, such as from a directory walk.
+  std::string digest(const std::filesystem::path& path,
+                     digest_algorithm algorithm, const file_stat& stat);
+
+  // The cached digest of path, if stat matches the cached entry.  The
+  // result is valid for the life of the cache.
+  std::optional<std::string_view> find(std::string_view path,
+                                       digest_algorithm algorithm,
+                                       const file_stat& stat) const;
+
+  // Caches the digest of path, replacing any entry for the same algorithm.
+  void insert(std::string_view path, digest_algorithm algorithm,
+              const file_stat& stat, std::string_view digest);
+
+  // Rewrites the cache file with only the live entries, in the calling
+  // thread.  Inserts wait only while the entries inserted meanwhile are
+  // written and the file is replaced.
+  void compact();
+
+  // The number of entries, and of stale records in the file.
+  size_t size() const;
+  size_t stale() const;
+
+  const statistics& stats() const { return stats_; }
+
+ private:
+  struct record;
+  struct table;
+
+  void load();
+  void reset_file();
+  const record* lookup(const table& t, std::string_view path,
+                       digest_algorithm algorithm) const;
+  void publish(const record* r);
+  void maybe_compact();
+
+  std::filesystem::path filename_;
+  mutable statistics stats_;
+
+  // Records live in mapped_ or arena_ until destruction, and tables in
+  // tables_, so readers never see them freed.
+  std::unique_ptr<mapped_file> mapped_;
+  std::atomic<const table*> table_{nullptr};
+
+  std::mutex compact_mu_;  // serializes compactions
+
+  mutable std::mutex mu_;  // guards everything below
+  arena arena_;
+  std::vector<std::unique_ptr<table>> tables_;
+  int fd_ = -1;
+  size_t live_ = 0;
+  size_t stale_ = 0;
+  bool compacting_ = false;  // collecting appended_ for a compaction
+  std::vector<const record*> appended_;
+  bool compaction_scheduled_ = false;
+  std::thread compactor_;
+};
+
+}  // namespace dvc
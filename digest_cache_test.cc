@@ -0,0 +1,199 @@
+#include "dvc/digest_cache.h"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/sha3.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(digest_files, -, 2000, "number of benchmark files");
+size_t DVC_OPTION(digest_file_kb, -, 16, "size of each benchmark file");
+
+// Writes a file with an mtime an hour ago, so digest() will cache it.
+void write_old_file(const std::filesystem::path& path, std::string_view data) {
+  dvc::save_file(path, data);
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now() -
+                std::chrono::hours(1));
+}
+
+void test_algorithms() {
+  DVC_ASSERT_EQ(dvc::compute_digest(dvc::digest_algorithm::sha3_256, "abc"),
+                dvc::SHA3("abc"));
+  for (auto algorithm :
+       {dvc::digest_algorithm::sha3_224, dvc::digest_algorithm::sha3_256,
+        dvc::digest_algorithm::sha3_384, dvc::digest_algorithm::sha3_512})
+    DVC_ASSERT_EQ(dvc::compute_digest(algorithm, "").size(),
+                  dvc::digest_size(algorithm));
+}
+
+void test_cache(const std::filesystem::path& dir) {
+  std::filesystem::path cache_file = dir / "cache";
+  std::filesystem::path a = dir / "a", b = dir / "b";
+  write_old_file(a, "apple");
+  write_old_file(b, "banana");
+  auto sha256 = dvc::digest_algorithm::sha3_256;
+  auto sha512 = dvc::digest_algorithm::sha3_512;
+
+  {
+    dvc::digest_cache cache(cache_file);
+    DVC_ASSERT_EQ(cache.digest(a), dvc::SHA3("apple"));
+    DVC_ASSERT_EQ(cache.stats().misses, 1u);
+    DVC_ASSERT_EQ(cache.digest(a), dvc::SHA3("apple"));
+    DVC_ASSERT_EQ(cache.stats().hits, 1u);
+    DVC_ASSERT_EQ(cache.digest(a, sha512),
+                  dvc::compute_digest(sha512, "apple"));
+    cache.digest(b);
+    DVC_ASSERT_EQ(cache.size(), 3u);
+
+    // A recently modified file is hashed but not cached.
+    dvc::save_file(dir / "new", "new");
+    DVC_ASSERT_EQ(cache.digest(dir / "new"), dvc::SHA3("new"));
+    DVC_ASSERT_EQ(cache.size(), 3u);
+  }
+
+  // Reopened, and with a torn record at the end.
+  {
+    std::ofstream(cache_file, std::ios::app | std::ios::binary) << "torn";
+    dvc::digest_cache cache(cache_file);
+    DVC_ASSERT_EQ(cache.size(), 3u);
+    uint64_t hits = cache.stats().hits;
+    DVC_ASSERT_EQ(cache.digest(a), dvc::SHA3("apple"));
+    DVC_ASSERT_EQ(cache.digest(b), dvc::SHA3("banana"));
+    DVC_ASSERT_EQ(cache.digest(a, sha512),
+                  dvc::compute_digest(sha512, "apple"));
+    DVC_ASSERT_EQ(cache.stats().hits, hits + 3);
+
+    // A changed file is re-hashed.
+    write_old_file(a, "apricot");
+    DVC_ASSERT_EQ(cache.digest(a), dvc::SHA3("apricot"));
+    DVC_ASSERT_EQ(cache.stats().invalidations, 1u);
+    DVC_ASSERT_EQ(cache.size(), 3u);
+    DVC_ASSERT_EQ(cache.stale(), 1u);
+
+    // find() checks the whole stat, not just the mtime.
+    dvc::file_stat stat = dvc::file_stat::of(b);
+    DVC_ASSERT(cache.find(b.native(), sha256, stat));
+    stat.ino++;
+    DVC_ASSERT(!cache.find(b.native(), sha256, stat));
+  }
+  DVC_ASSERT_EQ(std::filesystem::file_size(cache_file) % 8, 0u);
+
+  // Compaction drops stale records and keeps the rest.
+  {
+    dvc::digest_cache cache(cache_file);
+    DVC_ASSERT_EQ(cache.stale(), 1u);
+    size_t before = std::filesystem::file_size(cache_file);
+    cache.compact();
+    DVC_ASSERT_EQ(cache.stale(), 0u);
+    DVC_ASSERT_LT(std::filesystem::file_size(cache_file), before);
+    DVC_ASSERT_EQ(cache.digest(a), dvc::SHA3("apricot"));
+    DVC_ASSERT_EQ(cache.stats().hits, 1u);
+  }
+
+  // Background compaction once stale records outnumber live ones.  Records
+  // inserted while it runs are kept.
+  dvc::file_stat stat = dvc::file_stat::of(b);
+  {
+    dvc::digest_cache cache(cache_file);
+    std::string digest = dvc::SHA3("banana");
+    for (int i = 0; i < 3000; i++) {
+      stat.mtime_ns++;
+      cache.insert(b.native(), sha256, stat, digest);
+    }
+    while (cache.stats().compactions == 0) std::this_thread::yield();
+    DVC_ASSERT_EQ(cache.size(), 3u);
+  }
+  {
+    dvc::digest_cache cache(cache_file);
+    DVC_ASSERT_EQ(cache.size(), 3u);
+    DVC_ASSERT_LT(cache.stale(), 3000u);
+    DVC_ASSERT(cache.find(b.native(), sha256, stat));
+  }
+}
+
+// Readers look up while a writer inserts and the table grows.
+void test_concurrency(const std::filesystem::path& dir) {
+  dvc::digest_cache cache(dir / "concurrent");
+  auto sha256 = dvc::digest_algorithm::sha3_256;
+  constexpr int n = 5000;
+  std::string digest(32, 'x');
+  auto stat_of = [](int i) {
+    dvc::file_stat stat;
+    stat.ino = i;
+    return stat;
+  };
+  std::atomic<int> inserted{0};
+  std::vector<std::thread> readers;
+  for (int t = 0; t < 3; t++) {
+    readers.emplace_back([&] {
+      while (inserted.load() < n) {
+        int i = inserted.load();
+        if (i == 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        auto found =
+            cache.find(std::to_string(i - 1), sha256, stat_of(i - 1));
+        DVC_ASSERT(found && *found == digest, i);
+      }
+    });
+  }
+  for (int i = 0; i < n; i++) {
+    cache.insert(std::to_string(i), sha256, stat_of(i), digest);
+    inserted.store(i + 1);
+    if (i % 64 == 0) std::this_thread::yield();
+  }
+  for (auto& reader : readers) reader.join();
+  DVC_ASSERT_EQ(cache.size(), size_t(n));
+}
+
+void benchmark(const std::filesystem::path& dir) {
+  std::vector<std::filesystem::path> files;
+  std::string data(digest_file_kb << 10, 'x');
+  for (size_t i = 0; i < digest_files; i++) {
+    files.push_back(dir / std::to_string(i));
+    std::memcpy(data.data(), &i, sizeof(i));
+    write_old_file(files.back(), data);
+  }
+  auto scan = [&](dvc::digest_cache& cache) {
+    size_t start = dvc::now();
+    for (const auto& file : files) cache.digest(file);
+    return (dvc::now() - start) / double(files.size());
+  };
+  double cold, warm, reopened;
+  {
+    dvc::digest_cache cache(dir / "cache");
+    cold = scan(cache);
+    warm = scan(cache);
+  }
+  size_t start = dvc::now();
+  dvc::digest_cache cache(dir / "cache");
+  double open_ms = (dvc::now() - start) / 1e6;
+  reopened = scan(cache);
+  DVC_ASSERT_EQ(cache.stats().hits, files.size());
+  DVC_LOG(digest_files, " files of ", digest_file_kb, "KB: cold scan ", cold,
+          "ns/file, warm ", warm, "ns/file, reopened ", reopened,
+          "ns/file after a ", open_ms, "ms load");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              dvc::concat("digest_cache_test.", ::getpid());
+  std::filesystem::create_directories(dir / "benchmark");
+  test_algorithms();
+  test_cache(dir);
+  test_concurrency(dir);
+  benchmark(dir / "benchmark");
+  std::filesystem::remove_all(dir);
+}
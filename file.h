@@ -1,7 +1,19 @@
 #pragma once
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <filesystem>
 #include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
 
 namespace dvc {
 
@@ -128,6 +140,10 @@ class file_writer {
 
   std::ostream& ostream() { return ofs; }
 
+  // Flushes and closes the file, throwing if that fails, which the
+  // destructor can't report.
+  void close() { ofs.close(); }
+
  private:
   void open(const std::filesystem::path& fspath,
             std::ios::openmode mode_extra) {
@@ -140,7 +156,9 @@ class file_writer {
 
 inline void save_file(const std::filesystem::path& filename,
                       std::string_view data) {
-  file_writer(filename, truncate).write(data);
+  file_writer writer(filename, truncate);
+  writer.write(data);
+  writer.close();
 }
 
 inline std::string load_file(const std::filesystem::path& filename) {
@@ -151,6 +169,141 @@ inline std::string load_file(const std::filesystem::path& filename) {
   return s;
 }
 
+// A read-only memory mapping of a whole file.
+class mapped_file {
+ public:
+  explicit mapped_file(const std::filesystem::path& fspath) {
+    int fd = ::open(fspath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) fail("open", fspath, errno);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) fail_close("fstat", fspath, fd);
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) fail_close("mmap", fspath, fd);
+      data_ = static_cast<const char*>(p);
+    }
+    ::close(fd);
+  }
+
+  mapped_file(mapped_file&& other)
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)) {}
+
+  mapped_file& operator=(mapped_file&& other) {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    return *this;
+  }
+
+  ~mapped_file() {
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+  }
+
+  // Hints that the mapping will be read sequentially.
+  void advise_sequential() const {
+    if (data_) ::madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+  }
+
+  std::string_view data() const { return {data_, size_}; }
+  size_t size() const { return size_; }
+
+ private:
+  [[noreturn]] static void fail(const char* what,
+                                const std::filesystem::path& fspath,
+                                int error) {
+    throw std::filesystem::filesystem_error(
+        what, fspath, std::error_code(error, std::generic_category()));
+  }
+
+  [[noreturn]] static void fail_close(const char* what,
+                                      const std::filesystem::path& fspath,
+                                      int fd) {
+    int error = errno;
+    ::close(fd);
+    fail(what, fspath, error);
+  }
+
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// Reads a whole file with pread, for files that may change while they are
+// read, such as those in a tree being scanned.  A file that shrinks gives
+// what was read, where a mapped_file would fault with SIGBUS, and one that
+// grows gives its size at open; callers that need a consistent read should
+// check the file's stat afterwards.
+inline std::string read_file(const std::filesystem::path& filename) {
+  auto fail = [&](const char* what) {
+    int error = errno;
+    throw std::filesystem::filesystem_error(
+        what, filename, std::error_code(error, std::generic_category()));
+  };
+  int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) fail("open");
+  struct closer {
+    int fd;
+    ~closer() { ::close(fd); }
+  } close_fd{fd};
+  struct stat st;
+  if (::fstat(fd, &st) != 0) fail("fstat");
+  std::string s(st.st_size, '\0');
+  size_t n = 0;
+  while (n < s.size()) {
+    ssize_t r = ::pread(fd, s.data() + n, s.size() - n, n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r < 0) fail("pread");
+    if (r == 0) break;
+    n += r;
+  }
+  s.resize(n);
+  return s;
+}
+
+// What a file's contents are taken to depend on: if any of these change,
+// the file is assumed to have changed.
+struct file_stat {
+  // A write in the same timestamp tick as a stat leaves the mtime
+  // unchanged, so a file modified more recently than this may change again
+  // unseen.
+  static constexpr int64_t racy_ns = 2'000'000'000;
+
+  uint64_t dev = 0;
+  uint64_t ino = 0;
+  uint64_t size = 0;
+  int64_t mtime_ns = 0;
+
+  // Throws std::filesystem::filesystem_error if path can't be stat'd.
+  static file_stat of(const std::filesystem::path& path) {
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+      throw std::filesystem::filesystem_error(
+          "stat", path, std::error_code(errno, std::generic_category()));
+    file_stat s;
+    s.dev = st.st_dev;
+    s.ino = st.st_ino;
+    s.size = st.st_size;
+    s.mtime_ns =
+        int64_t(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
+    return s;
+  }
+
+  // Whether the file was modified within racy_ns, so that nothing read from
+  // it should be cached yet.
+  bool racy() const {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                      .count();
+    return now - mtime_ns < racy_ns;
+  }
+
+  bool operator==(const file_stat& other) const {
+    return dev == other.dev && ino == other.ino && size == other.size &&
+           mtime_ns == other.mtime_ns;
+  }
+  bool operator!=(const file_stat& other) const { return !(*this == other); }
+};
+
 inline void touch_file(const std::filesystem::path& filename) {
   file_writer(filename, append);
 }
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+
+#include "dvc/string.h"
+
+namespace dvc {
+
+// A string of at most N chars stored inline, for short strings such as
+// digests and names that should not touch the heap.  Usable in constant
+// expressions.  Exceeding the capacity throws std::length_error.
+template <size_t N>
+class fixed_string {
+ public:
+  constexpr fixed_string() = default;
+
+  template <size_t M>
+  constexpr fixed_string(const char (&s)[M]) {
+    static_assert(M - 1 <= N, "string literal too long for fixed_string");
+    append(std::string_view(s, M - 1));
+  }
+
+  constexpr explicit fixed_string(std::string_view s) { append(s); }
+
+  constexpr size_t size() const { return size_; }
+  static constexpr size_t capacity() { return N; }
+  constexpr bool empty() const { return size_ == 0; }
+  constexpr const char* data() const { return data_; }
+  constexpr char* data() { return data_; }
+  constexpr const char* c_str() const { return data_; }
+  constexpr char operator[](size_t i) const { return data_[i]; }
+  constexpr char& operator[](size_t i) { return data_[i]; }
+
+  constexpr operator std::string_view() const { return {data_, size_}; }
+  std::string str() const { return {data_, size_}; }
+
+  constexpr void push_back(char c) {
+    if (size_ == N) throw std::length_error("fixed_string overflow");
+    data_[size_++] = c;
+    data_[size_] = '\0';
+  }
+
+  constexpr fixed_string& append(std::string_view s) {
+    if (s.size() > N - size_) throw std::length_error("fixed_string overflow");
+    for (char c : s) data_[size_++] = c;
+    data_[size_] = '\0';
+    return *this;
+  }
+
+  constexpr fixed_string& operator+=(std::string_view s) { return append(s); }
+
+  // Sets the size after writing directly into data().
+  constexpr void resize(size_t size) {
+    if (size > N) throw std::length_error("fixed_string overflow");
+    size_ = size;
+    data_[size_] = '\0';
+  }
+
+  constexpr void clear() { resize(0); }
+
+  friend constexpr bool operator==(const fixed_string& a, std::string_view b) {
+    return std::string_view(a) == b;
+  }
+  friend constexpr bool operator!=(const fixed_string& a, std::string_view b) {
+    return !(a == b);
+  }
+  friend constexpr bool operator<(const fixed_string& a, const fixed_string& b) {
+    return std::string_view(a) < std::string_view(b);
+  }
+
+  friend std::ostream& operator<<(std::ostream& o, const fixed_string& s) {
+    return o << std::string_view(s);
+  }
+
+ private:
+  char data_[N + 1] = {};
+  size_t size_ = 0;
+};
+
+// The arguments of a concat, held by reference and formatted only when
+// appended to a string_builder.  Lets logging build its message without an
+// intermediate std::string.
+template <typename... Args>
+struct deferred_concat {
+  std::tuple<const Args&...> args;
+};
+
+template <typename... Args>
+deferred_concat<Args...> defer_concat(const Args&... args) {
+  return {{args...}};
+}
+
+// A string under construction, held in a buffer of inline_capacity chars
+// until it outgrows it and moves to the heap.
+class string_builder {
+ public:
+  static constexpr size_t inline_capacity = 256;
+
+  string_builder() = default;
+  string_builder(const string_builder&) = delete;
+  string_builder& operator=(const string_builder&) = delete;
+
+  size_t size() const { return size_; }
+  const char* data() const { return data_; }
+  std::string_view view() const { return {data_, size_}; }
+  std::string str() const { return {data_, size_}; }
+  bool on_heap() const { return heap_ != nullptr; }
+
+  void clear() { size_ = 0; }
+
+  void push_back(char c) {
+    if (size_ == capacity_) grow(size_ + 1);
+    data_[size_++] = c;
+  }
+
+  string_builder& write(std::string_view s) {
+    if (s.size() > capacity_ - size_) grow(size_ + s.size());
+    std::memcpy(data_ + size_, s.data(), s.size());
+    size_ += s.size();
+    return *this;
+  }
+
+  // Appends args formatted as concat would.
+  template <typename... Args>
+  string_builder& append(const Args&... args) {
+    (append_one(args), ...);
+    return *this;
+  }
+
+ private:
+  template <typename T>
+  void append_one(const T& t) {
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      write(t);
+    } else {
+      write(string_detail::formatted(t).view());
+    }
+  }
+
+  template <typename... Args>
+  void append_one(const deferred_concat<Args...>& d) {
+    std::apply([this](const auto&... args) { append(args...); }, d.args);
+  }
+
+  void grow(size_t needed) {
+    size_t capacity = std::max(needed, 2 * capacity_);
+    auto heap = std::make_unique<char[]>(capacity);
+    std::memcpy(heap.get(), data_, size_);
+    heap_ = std::move(heap);
+    data_ = heap_.get();
+    capacity_ = capacity;
+  }
+
+  char inline_[inline_capacity];
+  std::unique_ptr<char[]> heap_;
+  char* data_ = inline_;
+  size_t size_ = 0;
+  size_t capacity_ = inline_capacity;
+};
+
+}  // namespace dvc
@@ -0,0 +1,125 @@
+#include "dvc/fixed_string.h"
+
+#include <cstdlib>
+#include <new>
+
+#include "dvc/hex.h"
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/sha3.h"
+#include "dvc/time.h"
+
+size_t allocations = 0;
+
+void* operator new(size_t size) {
+  allocations++;
+  if (void* p = std::malloc(size)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// The allocations made by f.
+template <typename F>
+size_t count_allocations(F&& f) {
+  size_t before = allocations;
+  f();
+  return allocations - before;
+}
+
+void test_fixed_string() {
+  constexpr dvc::fixed_string<8> name = "abc";
+  static_assert(name.size() == 3 && name[1] == 'b');
+  static_assert(name == "abc");
+  dvc::fixed_string<8> s = name;
+  s += "defgh";
+  DVC_ASSERT_EQ(s.str(), "abcdefgh");
+  bool threw = false;
+  try {
+    s.push_back('i');
+  } catch (const std::length_error&) {
+    threw = true;
+  }
+  DVC_ASSERT(threw);
+  DVC_ASSERT_EQ(std::string(s.c_str()), "abcdefgh");
+}
+
+void test_string_builder() {
+  dvc::string_builder b;
+  b.append("x = ", 42, ", y = ", 1.5, ' ', std::string("z"));
+  DVC_ASSERT_EQ(b.view(), "x = 42, y = 1.5 z");
+  DVC_ASSERT(!b.on_heap());
+  std::string big(1000, 'a');
+  b.append(big, dvc::defer_concat(1, "b"));
+  DVC_ASSERT(b.on_heap());
+  DVC_ASSERT_EQ(b.str(), "x = 42, y = 1.5 z" + big + "1b");
+}
+
+void test_allocations() {
+  auto digest = dvc::SHA3_256(std::string_view("hello"));
+  DVC_ASSERT_EQ(count_allocations([&] {
+                  auto hex = dvc::ByteArrayToHexFixedString(digest);
+                  DVC_ASSERT_EQ(hex.size(), 64u);
+                }),
+                0u);
+  DVC_ASSERT_EQ(dvc::ByteArrayToHexFixedString(digest),
+                dvc::ByteArrayToHexString(digest));
+
+  std::string name = "a name too long for the small string buffer";
+  DVC_LOG("warm up");
+  DVC_ASSERT_EQ(count_allocations([&] {
+                  DVC_LOG("logged ", name, " with ", 42, " and ", 2.5);
+                }),
+                0u);
+  DVC_ASSERT_EQ(count_allocations([] { dvc::now_fixed_string(); }), 0u);
+}
+
+void benchmark() {
+  constexpr int n = 1000000;
+  auto digest = dvc::SHA3_256(std::string_view("hello"));
+  size_t t0 = dvc::now();
+  size_t a0 = allocations;
+  size_t total = 0;
+  for (int i = 0; i < n; i++) {
+    digest[0] = std::byte(i);
+    total += dvc::ByteArrayToHexString(digest)[63];
+  }
+  size_t t1 = dvc::now();
+  size_t a1 = allocations;
+  for (int i = 0; i < n; i++) {
+    digest[0] = std::byte(i);
+    total += dvc::ByteArrayToHexFixedString(digest)[63];
+  }
+  size_t t2 = dvc::now();
+  size_t a2 = allocations;
+  for (int i = 0; i < n; i++)
+    total += dvc::concat("item ", i, " of ", n, ": ", "name").size();
+  size_t t3 = dvc::now();
+  size_t a3 = allocations;
+  for (int i = 0; i < n; i++) {
+    dvc::string_builder b;
+    total += b.append("item ", i, " of ", n, ": ", "name").size();
+  }
+  size_t t4 = dvc::now();
+  size_t a4 = allocations;
+  DVC_ASSERT_GT(total, 0u);
+
+  DVC_LOG("hex string: ", double(t1 - t0) / n, "ns/digest ",
+          double(a1 - a0) / n, " allocs/digest");
+  DVC_LOG("hex fixed_string: ", double(t2 - t1) / n, "ns/digest ",
+          double(a2 - a1) / n, " allocs/digest");
+  DVC_LOG("concat: ", double(t3 - t2) / n, "ns/message ", double(a3 - a2) / n,
+          " allocs/message");
+  DVC_LOG("string_builder: ", double(t4 - t3) / n, "ns/message ",
+          double(a4 - a3) / n, " allocs/message");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_fixed_string();
+  test_string_builder();
+  test_allocations();
+  benchmark();
+}
@@ -0,0 +1,501 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "dvc/hash.h"
+
+namespace dvc {
+
+namespace flat_hash_detail {
+
+// Each slot has a control byte: its hash's low 7 bits when full, or one of
+// these negative values.
+constexpr int8_t kEmpty = -128;
+constexpr int8_t kDeleted = -2;
+constexpr int8_t kSentinel = -1;  // after the last slot, to stop iteration
+
+constexpr size_t kGroupSize = 16;
+
+// A set of slot indices within a group, one bit per slot.
+struct bitmask {
+  uint32_t bits;
+
+  explicit operator bool() const { return bits != 0; }
+  size_t lowest() const { return __builtin_ctz(bits); }
+  void clear_lowest() { bits &= bits - 1; }
+};
+
+// The control bytes of kGroupSize consecutive slots, matched all at once.
+struct group {
+#if defined(__SSE2__)
+  __m128i ctrl;
+
+  explicit group(const int8_t* p)
+      : ctrl(_mm_load_si128(reinterpret_cast<const __m128i*>(p))) {}
+
+  bitmask match(int8_t h2) const {
+    return {uint32_t(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl)))};
+  }
+
+  bitmask match_empty() const { return match(kEmpty); }
+
+  // Empty and deleted are the only values with the sign bit set in a group.
+  bitmask match_empty_or_deleted() const {
+    return {uint32_t(_mm_movemask_epi8(ctrl))};
+  }
+#else
+  const int8_t* ctrl;
+
+  explicit group(const int8_t* p) : ctrl(p) {}
+
+  bitmask match(int8_t h2) const {
+    uint32_t bits = 0;
+    for (size_t i = 0; i < kGroupSize; i++) bits |= uint32_t(ctrl[i] == h2) << i;
+    return {bits};
+  }
+
+  bitmask match_empty() const { return match(kEmpty); }
+
+  bitmask match_empty_or_deleted() const {
+    uint32_t bits = 0;
+    for (size_t i = 0; i < kGroupSize; i++) bits |= uint32_t(ctrl[i] < 0) << i;
+    return {bits};
+  }
+#endif
+};
+
+template <typename T, typename = void>
+struct is_transparent : std::false_type {};
+
+template <typename T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>>
+    : std::true_type {};
+
+template <typename Hash, typename Eq, typename K>
+using enable_heterogeneous =
+    std::enable_if_t<is_transparent<Hash>::value && is_transparent<Eq>::value,
+                     K>;
+
+// Stores keys for flat_hash_set.
+template <typename K>
+struct set_policy {
+  using key_type = K;
+  using value_type = K;
+  using slot_type = K;
+
+  static value_type& value(slot_type& s) { return s; }
+};
+
+// Stores key-value pairs for flat_hash_map.  Slots hold a std::pair<K, V> so
+// that rehashing can move keys, but are exposed as std::pair<const K, V>,
+// which has the same layout.
+template <typename K, typename V>
+struct map_policy {
+  using key_type = K;
+  using value_type = std::pair<const K, V>;
+  using slot_type = std::pair<K, V>;
+
+  static value_type& value(slot_type& s) {
+    return *std::launder(reinterpret_cast<value_type*>(&s));
+  }
+};
+
+}  // namespace flat_hash_detail
+
+// An open-addressing hash table in the style of Abseil's Swiss tables: slots
+// are probed a group of 16 at a time by comparing 7 bits of the hash with
+// SSE2, so most lookups touch one group of control bytes and one slot.
+// Iterators and references are invalidated by any insertion that rehashes.
+// With the default dvc::hash and std::equal_to<>, std::string keys can be
+// looked up by std::string_view without constructing a string.
+template <typename Policy, typename Hash, typename Eq>
+class flat_hash_table {
+  using slot_type = typename Policy::slot_type;
+
+ public:
+  using key_type = typename Policy::key_type;
+  using value_type = typename Policy::value_type;
+  using size_type = size_t;
+  using hasher = Hash;
+  using key_equal = Eq;
+
+  template <bool is_const>
+  class basic_iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename Policy::value_type;
+    using difference_type = std::ptrdiff_t;
+    using reference =
+        std::conditional_t<is_const, const value_type&, value_type&>;
+    using pointer = std::conditional_t<is_const, const value_type*, value_type*>;
+
+    basic_iterator() = default;
+    template <bool c = is_const, typename = std::enable_if_t<c>>
+    basic_iterator(const basic_iterator<false>& o)
+        : ctrl_(o.ctrl_), slot_(o.slot_) {}
+
+    reference operator*() const { return Policy::value(*slot_); }
+    pointer operator->() const { return &Policy::value(*slot_); }
+
+    basic_iterator& operator++() {
+      ++ctrl_;
+      ++slot_;
+      skip_free();
+      return *this;
+    }
+
+    basic_iterator operator++(int) {
+      basic_iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const basic_iterator& o) const { return slot_ == o.slot_; }
+    bool operator!=(const basic_iterator& o) const { return slot_ != o.slot_; }
+
+   private:
+    friend class flat_hash_table;
+    template <bool>
+    friend class basic_iterator;
+
+    basic_iterator(const int8_t* ctrl, slot_type* slot)
+        : ctrl_(ctrl), slot_(slot) {}
+
+    void skip_free() {
+      while (*ctrl_ < flat_hash_detail::kSentinel) {
+        ++ctrl_;
+        ++slot_;
+      }
+    }
+
+    const int8_t* ctrl_ = nullptr;
+    slot_type* slot_ = nullptr;
+  };
+
+  using iterator = basic_iterator<false>;
+  using const_iterator = basic_iterator<true>;
+
+  flat_hash_table() = default;
+
+  flat_hash_table(const flat_hash_table& o) : hash_(o.hash_), eq_(o.eq_) {
+    reserve(o.size());
+    for (const auto& v : o) insert_unique(hash_of(key_of(v)), v);
+  }
+
+  flat_hash_table(flat_hash_table&& o) noexcept { swap(o); }
+
+  flat_hash_table& operator=(flat_hash_table o) noexcept {
+    swap(o);
+    return *this;
+  }
+
+  ~flat_hash_table() { destroy(); }
+
+  void swap(flat_hash_table& o) noexcept {
+    std::swap(ctrl_, o.ctrl_);
+    std::swap(slots_, o.slots_);
+    std::swap(capacity_, o.capacity_);
+    std::swap(size_, o.size_);
+    std::swap(growth_left_, o.growth_left_);
+    std::swap(hash_, o.hash_);
+    std::swap(eq_, o.eq_);
+  }
+
+  iterator begin() {
+    if (!capacity_) return end();
+    iterator it(ctrl_, slots_);
+    it.skip_free();
+    return it;
+  }
+  iterator end() { return iterator(ctrl_ + capacity_, slots_ + capacity_); }
+  const_iterator begin() const {
+    return const_cast<flat_hash_table*>(this)->begin();
+  }
+  const_iterator end() const {
+    return const_cast<flat_hash_table*>(this)->end();
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  size_t capacity() const { return capacity_; }
+
+  void clear() {
+    destroy();
+    ctrl_ = nullptr;
+    slots_ = nullptr;
+    capacity_ = size_ = growth_left_ = 0;
+  }
+
+  // Makes room for n elements without rehashing.
+  void reserve(size_t n) {
+    size_t capacity = flat_hash_detail::kGroupSize;
+    while (capacity * 7 / 8 < n) capacity *= 2;
+    if (capacity > capacity_) rehash(capacity);
+  }
+
+  iterator find(const key_type& key) { return find_impl(key); }
+  const_iterator find(const key_type& key) const {
+    return const_cast<flat_hash_table*>(this)->find_impl(key);
+  }
+  template <typename K, typename = flat_hash_detail::enable_heterogeneous<
+                            Hash, Eq, K>>
+  iterator find(const K& key) {
+    return find_impl(key);
+  }
+  template <typename K, typename = flat_hash_detail::enable_heterogeneous<
+                            Hash, Eq, K>>
+  const_iterator find(const K& key) const {
+    return const_cast<flat_hash_table*>(this)->find_impl(key);
+  }
+
+  template <typename K>
+  bool contains(const K& key) const {
+    return find(key) != end();
+  }
+
+  template <typename K>
+  size_t count(const K& key) const {
+    return contains(key);
+  }
+
+  std::pair<iterator, bool> insert(const value_type& v) {
+    return emplace_key(key_of(v), [&](slot_type* s) { new (s) slot_type(v); });
+  }
+
+  std::pair<iterator, bool> insert(value_type&& v) {
+    return emplace_key(key_of(v),
+                       [&](slot_type* s) { new (s) slot_type(std::move(v)); });
+  }
+
+  // Erases the element with key, returning the number erased.
+  template <typename K>
+  size_t erase(const K& key) {
+    iterator it = find(key);
+    if (it == end()) return 0;
+    erase(it);
+    return 1;
+  }
+
+  void erase(iterator it) {
+    size_t i = it.slot_ - slots_;
+    it.slot_->~slot_type();
+    size_--;
+    // A lookup only probes past a group with no empty slot, so if this group
+    // has one the slot can become empty rather than a tombstone.
+    size_t start = i & ~(flat_hash_detail::kGroupSize - 1);
+    if (flat_hash_detail::group(ctrl_ + start).match_empty()) {
+      ctrl_[i] = flat_hash_detail::kEmpty;
+      growth_left_++;
+    } else {
+      ctrl_[i] = flat_hash_detail::kDeleted;
+    }
+  }
+
+ protected:
+  // Finds key or inserts a slot for it with construct(slot_type*).
+  template <typename K, typename Construct>
+  std::pair<iterator, bool> emplace_key(const K& key, Construct&& construct) {
+    size_t hash = hash_of(key);
+    if (capacity_) {
+      iterator it = find_hashed(key, hash);
+      if (it != end()) return {it, false};
+    }
+    if (growth_left_ == 0) grow();
+    size_t i = find_free(hash);
+    construct(slots_ + i);
+    set_full(i, hash);
+    return {iterator(ctrl_ + i, slots_ + i), true};
+  }
+
+ private:
+  template <typename K>
+  size_t hash_of(const K& key) const {
+    return hash_(key);
+  }
+
+  // The key of a slot_type or value_type.
+  template <typename T>
+  static const key_type& key_of(const T& v) {
+    if constexpr (std::is_same_v<value_type, slot_type>)
+      return v;
+    else
+      return v.first;
+  }
+
+  // The hash bits for the control byte and for the probe start are disjoint.
+  static int8_t h2(size_t hash) { return int8_t(hash & 0x7f); }
+  size_t first_group(size_t hash) const {
+    return (hash >> 7) & (capacity_ / flat_hash_detail::kGroupSize - 1);
+  }
+
+  template <typename K>
+  iterator find_impl(const K& key) {
+    if (!capacity_) return end();
+    return find_hashed(key, hash_of(key));
+  }
+
+  // Probes groups in triangular order, which visits each group once.
+  template <typename K>
+  iterator find_hashed(const K& key, size_t hash) {
+    size_t mask = capacity_ / flat_hash_detail::kGroupSize - 1;
+    size_t g = first_group(hash);
+    for (size_t step = 1;; g = (g + step++) & mask) {
+      size_t start = g * flat_hash_detail::kGroupSize;
+      flat_hash_detail::group group(ctrl_ + start);
+      for (auto m = group.match(h2(hash)); m; m.clear_lowest()) {
+        size_t i = start + m.lowest();
+        if (eq_(key_of(slots_[i]), key))
+          return iterator(ctrl_ + i, slots_ + i);
+      }
+      if (group.match_empty()) return end();
+    }
+  }
+
+  size_t find_free(size_t hash) const {
+    size_t mask = capacity_ / flat_hash_detail::kGroupSize - 1;
+    size_t g = first_group(hash);
+    for (size_t step = 1;; g = (g + step++) & mask) {
+      size_t start = g * flat_hash_detail::kGroupSize;
+      auto m = flat_hash_detail::group(ctrl_ + start).match_empty_or_deleted();
+      if (m) return start + m.lowest();
+    }
+  }
+
+  void set_full(size_t i, size_t hash) {
+    if (ctrl_[i] == flat_hash_detail::kEmpty) growth_left_--;
+    ctrl_[i] = h2(hash);
+    size_++;
+  }
+
+  void insert_unique(size_t hash, const value_type& v) {
+    size_t i = find_free(hash);
+    new (slots_ + i) slot_type(v);
+    set_full(i, hash);
+  }
+
+  // Doubles the capacity, or just clears tombstones if they are most of the
+  // used slots.
+  void grow() {
+    if (capacity_ && size_ <= capacity_ * 7 / 16)
+      rehash(capacity_);
+    else
+      rehash(capacity_ ? capacity_ * 2 : flat_hash_detail::kGroupSize);
+  }
+
+  void rehash(size_t capacity) {
+    int8_t* old_ctrl = ctrl_;
+    slot_type* old_slots = slots_;
+    size_t old_capacity = capacity_;
+
+    // Control bytes for every slot, the sentinel, and padding to keep groups
+    // aligned.
+    ctrl_ = static_cast<int8_t*>(::operator new(
+        capacity + flat_hash_detail::kGroupSize,
+        std::align_val_t(flat_hash_detail::kGroupSize)));
+    std::memset(ctrl_, flat_hash_detail::kEmpty, capacity);
+    ctrl_[capacity] = flat_hash_detail::kSentinel;
+    slots_ = std::allocator<slot_type>().allocate(capacity);
+    capacity_ = capacity;
+    size_ = 0;
+    growth_left_ = capacity * 7 / 8;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_ctrl[i] < 0) continue;
+      size_t hash = hash_of(key_of(old_slots[i]));
+      size_t j = find_free(hash);
+      new (slots_ + j) slot_type(std::move(old_slots[i]));
+      old_slots[i].~slot_type();
+      set_full(j, hash);
+    }
+    if (old_ctrl) {
+      ::operator delete(old_ctrl,
+                        std::align_val_t(flat_hash_detail::kGroupSize));
+      std::allocator<slot_type>().deallocate(old_slots, old_capacity);
+    }
+  }
+
+  void destroy() {
+    if (!ctrl_) return;
+    for (size_t i = 0; i < capacity_; i++)
+      if (ctrl_[i] >= 0) slots_[i].~slot_type();
+    ::operator delete(ctrl_, std::align_val_t(flat_hash_detail::kGroupSize));
+    std::allocator<slot_type>().deallocate(slots_, capacity_);
+  }
+
+  int8_t* ctrl_ = nullptr;
+  slot_type* slots_ = nullptr;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+  size_t growth_left_ = 0;  // empty slots that may still be filled
+  Hash hash_;
+  Eq eq_;
+};
+
+template <typename K, typename Hash = dvc::hash, typename Eq = std::equal_to<>>
+class flat_hash_set
+    : public flat_hash_table<flat_hash_detail::set_policy<K>, Hash, Eq> {
+ public:
+  using flat_hash_table<flat_hash_detail::set_policy<K>, Hash,
+                        Eq>::flat_hash_table;
+};
+
+template <typename K, typename V, typename Hash = dvc::hash,
+          typename Eq = std::equal_to<>>
+class flat_hash_map
+    : public flat_hash_table<flat_hash_detail::map_policy<K, V>, Hash, Eq> {
+  using base = flat_hash_table<flat_hash_detail::map_policy<K, V>, Hash, Eq>;
+
+ public:
+  using mapped_type = V;
+  using typename base::iterator;
+
+  using base::base;
+
+  template <typename Key, typename... Args>
+  std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args) {
+    return this->emplace_key(key, [&](std::pair<K, V>* s) {
+      new (s) std::pair<K, V>(
+          std::piecewise_construct, std::forward_as_tuple(std::forward<Key>(key)),
+          std::forward_as_tuple(std::forward<Args>(args)...));
+    });
+  }
+
+  template <typename Key, typename Value>
+  std::pair<iterator, bool> emplace(Key&& key, Value&& value) {
+    return try_emplace(std::forward<Key>(key), std::forward<Value>(value));
+  }
+
+  template <typename Key>
+  V& operator[](Key&& key) {
+    return try_emplace(std::forward<Key>(key)).first->second;
+  }
+
+  template <typename Key>
+  V& at(const Key& key) {
+    auto it = this->find(key);
+    if (it == this->end()) throw std::out_of_range("flat_hash_map::at");
+    return it->second;
+  }
+
+  template <typename Key>
+  const V& at(const Key& key) const {
+    auto it = this->find(key);
+    if (it == this->end()) throw std::out_of_range("flat_hash_map::at");
+    return it->second;
+  }
+};
+
+}  // namespace dvc
@@ -0,0 +1,129 @@
+#include "dvc/flat_hash_map.h"
+
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "dvc/container.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(max_entries, -, 1000000,
+                  "largest table size to benchmark, from 1000 up by 10x");
+
+void test_random_ops() {
+  std::mt19937_64 ran;
+  dvc::flat_hash_map<uint64_t, uint64_t> map;
+  std::unordered_map<uint64_t, uint64_t> expected;
+  for (int i = 0; i < 200000; i++) {
+    uint64_t key = ran() % 5000;
+    switch (ran() % 4) {
+      case 0:
+        DVC_ASSERT_EQ(map.erase(key), expected.erase(key));
+        break;
+      case 1:
+        DVC_ASSERT_EQ(map.insert({key, i}).second,
+                      expected.insert({key, i}).second);
+        break;
+      default: {
+        auto it = map.find(key);
+        auto e = expected.find(key);
+        DVC_ASSERT_EQ(it == map.end(), e == expected.end());
+        if (e != expected.end()) DVC_ASSERT_EQ(it->second, e->second);
+      }
+    }
+    DVC_ASSERT_EQ(map.size(), expected.size());
+  }
+  size_t n = 0;
+  for (const auto& [key, value] : map) {
+    DVC_ASSERT_EQ(expected.at(key), value);
+    n++;
+  }
+  DVC_ASSERT_EQ(n, expected.size());
+
+  dvc::flat_hash_map<uint64_t, uint64_t> copy = map;
+  dvc::flat_hash_map<uint64_t, uint64_t> moved = std::move(map);
+  DVC_ASSERT_EQ(copy.size(), expected.size());
+  DVC_ASSERT_EQ(moved.size(), expected.size());
+  for (const auto& [key, value] : expected) {
+    DVC_ASSERT_EQ(copy.at(key), value);
+    DVC_ASSERT_EQ(moved.at(key), value);
+  }
+}
+
+void test_strings() {
+  dvc::flat_hash_map<std::string, int> map;
+  map["one"] = 1;
+  map.try_emplace(std::string("two"), 2);
+  DVC_ASSERT(!map.emplace("one", 3).second);
+  std::string_view key = "one";
+  DVC_ASSERT_EQ(map.find(key)->second, 1);
+  DVC_ASSERT(map.contains(std::string_view("two")));
+  DVC_ASSERT(!map.contains("three"));
+
+  dvc::flat_hash_set<std::string> set;
+  for (int i = 0; i < 1000; i++) set.insert(std::to_string(i));
+  DVC_ASSERT_EQ(set.size(), 1000u);
+  DVC_ASSERT(set.contains(std::string_view("999")));
+
+  // Without transparent functors lookups convert to the key type.
+  dvc::flat_hash_map<int, int, std::hash<int>, std::equal_to<int>> plain;
+  plain[3] = 4;
+  DVC_ASSERT_EQ(plain.at(3), 4);
+}
+
+void test_find_or_die() {
+  dvc::flat_hash_map<std::string, int> map;
+  dvc::insert_or_die(map, "a", 1);
+  DVC_ASSERT_EQ(dvc::find_or_die(map, std::string_view("a")).second, 1);
+  std::map<int, int> tree = {{1, 2}};
+  dvc::find_or_die(tree, 1).second = 3;
+  DVC_ASSERT_EQ(tree[1], 3);
+  const std::set<int> set = {5};
+  DVC_ASSERT_EQ(dvc::find_or_die(set, 5), 5);
+  std::vector<int> v = {7, 8};
+  DVC_ASSERT_EQ(dvc::find_or_die(v, 8), 8);
+}
+
+template <typename Map>
+void benchmark(const char* name, const std::vector<uint64_t>& keys) {
+  size_t n = keys.size();
+  Map map;
+  size_t t0 = dvc::now();
+  for (size_t i = 0; i < n; i++) map[keys[i]] = i;
+  size_t t1 = dvc::now();
+  size_t hits = 0;
+  for (size_t i = 0; i < n; i++) hits += map.find(keys[(i * 7919) % n])->second;
+  size_t t2 = dvc::now();
+  size_t misses = 0;
+  for (size_t i = 0; i < n; i++) misses += map.find(keys[i] + 1) == map.end();
+  size_t t3 = dvc::now();
+  DVC_ASSERT_GT(hits + misses, 0u);
+  DVC_LOG(name, " n=", n, ": insert ", double(t1 - t0) / n, "ns, hit ",
+          double(t2 - t1) / n, "ns, miss ", double(t3 - t2) / n, "ns");
+}
+
+void benchmark_sizes() {
+  std::mt19937_64 ran;
+  for (size_t n = 1000; n <= max_entries; n *= 10) {
+    std::vector<uint64_t> keys(n);
+    for (auto& key : keys) key = ran() & ~uint64_t(1);  // +1 always misses
+    benchmark<dvc::flat_hash_map<uint64_t, uint64_t>>("flat_hash_map", keys);
+    benchmark<std::unordered_map<uint64_t, uint64_t>>("unordered_map", keys);
+    benchmark<std::map<uint64_t, uint64_t>>("map", keys);
+  }
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_random_ops();
+  test_strings();
+  test_find_or_die();
+  benchmark_sizes();
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace dvc {
+
+// The splitmix64 finalizer: a bijective mix of all 64 input bits.
+constexpr uint64_t mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9u;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebu;
+  x ^= x >> 31;
+  return x;
+}
+
+inline uint64_t load64(const void* p) {
+  uint64_t x;
+  std::memcpy(&x, p, sizeof(x));
+  return x;
+}
+
+// A fast non-cryptographic 64-bit hash of a byte range, for hash tables and
+// sketches.  Not stable across versions of this library.
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0) {
+  const char* p = static_cast<const char*>(data);
+  uint64_t h = mix64(seed ^ (size * 0x9e3779b97f4a7c15u));
+  while (size >= 16) {
+    uint64_t a = load64(p) ^ 0xa0761d6478bd642fu;
+    uint64_t b = load64(p + 8) ^ h;
+    unsigned __int128 m = (unsigned __int128)a * b;
+    h = uint64_t(m) ^ uint64_t(m >> 64);
+    p += 16;
+    size -= 16;
+  }
+  uint64_t a = 0, b = 0;
+  if (size >= 8) {
+    a = load64(p);
+    b = load64(p + size - 8);
+  } else if (size >= 4) {
+    uint32_t lo, hi;
+    std::memcpy(&lo, p, 4);
+    std::memcpy(&hi, p + size - 4, 4);
+    a = lo;
+    b = hi;
+  } else if (size > 0) {
+    a = uint64_t(uint8_t(p[0])) << 16 | uint64_t(uint8_t(p[size / 2])) << 8 |
+        uint8_t(p[size - 1]);
+  }
+  unsigned __int128 m =
+      (unsigned __int128)(a ^ 0xe7037ed1a0b428dbu) * (b ^ h);
+  return mix64(uint64_t(m) ^ uint64_t(m >> 64));
+}
+
+inline uint64_t hash64(std::string_view s, uint64_t seed = 0) {
+  return hash_bytes(s.data(), s.size(), seed);
+}
+
+template <typename T>
+std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>, uint64_t> hash64(
+    T t, uint64_t seed = 0) {
+  return mix64(uint64_t(t) ^ mix64(seed));
+}
+
+// A functor for hash containers that also accepts std::string_view when
+// looking up std::string keys.  Other types without padding, such as digests,
+// are hashed by their bytes.
+struct hash {
+  using is_transparent = void;
+
+  template <typename T>
+  size_t operator()(const T& t) const {
+    if constexpr (std::is_convertible_v<const T&, std::string_view>)
+      return hash64(std::string_view(t));
+    else if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+      return hash64(t);
+    else {
+      static_assert(std::has_unique_object_representations_v<T>,
+                    "dvc::hash needs a type without padding");
+      return hash_bytes(&t, sizeof(t));
+    }
+  }
+};
+
+}  // namespace dvc
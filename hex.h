@@ -1,9 +1,11 @@
 #pragma once
 
+#include <array>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#include "dvc/fixed_string.h"
 #include "dvc/log.h"
 
 namespace dvc {
@@ -131,13 +133,29 @@ inline std::vector<std::byte> HexStringToByteArray(
   return byte_array;
 }
 
-inline std::string ByteArrayToHexString(const std::byte* data, size_t size) {
-  std::string hex_string(size * 2, '\0');
+// Writes the 2 * size hex digits of data to out.
+inline void ByteArrayToHexChars(const std::byte* data, size_t size, char* out) {
+  static constexpr char digits[] = "0123456789ABCDEF";
   for (size_t i = 0; i < size; ++i) {
-    const auto char_pair = ByteToHexCharPair(data[i]);
-    hex_string[2 * i + 0] = char_pair.first;
-    hex_string[2 * i + 1] = char_pair.second;
+    out[2 * i + 0] = digits[uint8_t(data[i]) >> 4];
+    out[2 * i + 1] = digits[uint8_t(data[i]) & 0xF];
   }
+}
+
+inline std::string ByteArrayToHexString(const std::byte* data, size_t size) {
+  std::string hex_string(size * 2, '\0');
+  ByteArrayToHexChars(data, size, hex_string.data());
+  return hex_string;
+}
+
+// ByteArrayToHexString without allocating, for digests and other fixed size
+// byte arrays.
+template <size_t size>
+inline fixed_string<2 * size> ByteArrayToHexFixedString(
+    const std::array<std::byte, size>& byte_array) {
+  fixed_string<2 * size> hex_string;
+  ByteArrayToHexChars(byte_array.data(), size, hex_string.data());
+  hex_string.resize(2 * size);
   return hex_string;
 }
 
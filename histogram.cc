@@ -0,0 +1,74 @@
+#include "dvc/histogram.h"
+
+#include <map>
+#include <memory>
+
+#include "dvc/log.h"
+
+namespace dvc {
+
+namespace {
+
+struct Histograms {
+  std::mutex mu;
+  std::map<std::string, std::unique_ptr<histogram>, std::less<>> by_name;
+};
+
+Histograms& histograms() {
+  static Histograms h;
+  return h;
+}
+
+}  // namespace
+
+histogram& get_histogram(std::string_view name) {
+  std::lock_guard lock(histograms().mu);
+  auto& by_name = histograms().by_name;
+  auto it = by_name.find(name);
+  if (it == by_name.end())
+    it = by_name.emplace(name, std::make_unique<histogram>()).first;
+  return *it->second;
+}
+
+std::vector<std::pair<std::string, histogram_summary>> histogram_summaries() {
+  std::vector<std::pair<std::string, histogram*>> all;
+  {
+    std::lock_guard lock(histograms().mu);
+    for (const auto& [name, h] : histograms().by_name)
+      all.emplace_back(name, h.get());
+  }
+  std::vector<std::pair<std::string, histogram_summary>> result;
+  for (const auto& [name, h] : all)
+    result.emplace_back(name, h->snapshot().summary());
+  return result;
+}
+
+void write_histograms(json_writer& writer) {
+  auto summaries = histogram_summaries();
+  writer.write(std::map<std::string, histogram_summary>(summaries.begin(),
+                                                        summaries.end()));
+}
+
+void log_histograms() {
+  for (const auto& [name, s] : histogram_summaries())
+    DVC_LOG(name, ": count=", s.count, " mean=", s.mean, " p50=", s.p50,
+            " p90=", s.p90, " p99=", s.p99, " p999=", s.p999, " max=", s.max);
+}
+
+histogram_reporter::histogram_reporter(std::chrono::milliseconds period)
+    : thread_([this, period] {
+        std::unique_lock lock(mu_);
+        while (!cv_.wait_for(lock, period, [this] { return done_; }))
+          log_histograms();
+      }) {}
+
+histogram_reporter::~histogram_reporter() {
+  {
+    std::lock_guard lock(mu_);
+    done_ = true;
+  }
+  cv_.notify_one();
+  thread_.join();
+}
+
+}  // namespace dvc
@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "dvc/clock.h"
+#include "dvc/json.h"
+#include "dvc/per_thread.h"
+
+// Records the time spent in the enclosing scope, in nanoseconds, into the
+// registered histogram called `name`, which must be a string literal or
+// otherwise outlive the program:
+//
+//    void handle_request() {
+//      DVC_TIMED_SCOPE("handle_request");
+//      ...
+//    }
+//
+// See log_histograms() and write_histograms() for reporting.
+#define DVC_TIMED_SCOPE(name) DVC_TIMED_SCOPE_LINE(name, __LINE__)
+#define DVC_TIMED_SCOPE_LINE(name, line) DVC_TIMED_SCOPE_IMPL(name, line)
+#define DVC_TIMED_SCOPE_IMPL(name, line)                  \
+  static ::dvc::histogram& dvc_histogram_##line =         \
+      ::dvc::get_histogram(name);                         \
+  ::dvc::scoped_timer dvc_scoped_timer_##line(dvc_histogram_##line)
+
+namespace dvc {
+
+// The summary reported for each histogram.
+struct histogram_summary {
+  uint64_t count = 0;
+  uint64_t min = 0;
+  uint64_t max = 0;
+  double mean = 0;
+  uint64_t p50 = 0;
+  uint64_t p90 = 0;
+  uint64_t p99 = 0;
+  uint64_t p999 = 0;
+};
+DVC_JSON_FIELDS(histogram_summary, count, min, max, mean, p50, p90, p99, p999);
+
+// A log-linear (HDR-style) histogram of uint64_t values: exact below 32, and
+// above that 32 linear sub-buckets per power of two, so any value is reported
+// within 3.2% of its true value.  Values are clamped to below 2^48.
+class histogram_snapshot {
+ public:
+  static constexpr int sub_bucket_bits = 5;
+  static constexpr int max_bits = 48;
+  static constexpr size_t nbuckets = size_t(max_bits - sub_bucket_bits + 1)
+                                     << sub_bucket_bits;
+
+  static size_t bucket_of(uint64_t value) {
+    constexpr uint64_t limit = uint64_t(1) << max_bits;
+    constexpr uint64_t mask = (uint64_t(1) << sub_bucket_bits) - 1;
+    if (value >= limit) value = limit - 1;
+    if (value <= mask) return value;
+    int e = 63 - __builtin_clzll(value);
+    return size_t(e - sub_bucket_bits + 1) << sub_bucket_bits |
+           ((value >> (e - sub_bucket_bits)) & mask);
+  }
+
+  static uint64_t bucket_lower(size_t bucket) {
+    size_t group = bucket >> sub_bucket_bits;
+    if (group == 0) return bucket;
+    size_t sub = bucket & ((size_t(1) << sub_bucket_bits) - 1);
+    return ((uint64_t(1) << sub_bucket_bits) + sub) << (group - 1);
+  }
+
+  static uint64_t bucket_width(size_t bucket) {
+    size_t group = bucket >> sub_bucket_bits;
+    return group == 0 ? 1 : uint64_t(1) << (group - 1);
+  }
+
+  histogram_snapshot() : counts_(nbuckets) {}
+
+  void add(size_t bucket, uint64_t count) {
+    counts_[bucket] += count;
+    count_ += count;
+  }
+
+  void add_sum(uint64_t sum) { sum_ += sum; }
+  void add_max(uint64_t max) { max_ = std::max(max_, max); }
+
+  void merge(const histogram_snapshot& other) {
+    for (size_t i = 0; i < nbuckets; i++) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t sum() const { return sum_; }
+  uint64_t max() const { return max_; }
+  double mean() const { return count_ ? double(sum_) / count_ : 0; }
+
+  uint64_t min() const {
+    for (size_t i = 0; i < nbuckets; i++)
+      if (counts_[i]) return bucket_lower(i);
+    return 0;
+  }
+
+  // The midpoint of the bucket holding the value of rank q * count(), for q
+  // in [0, 1], capped at max().
+  uint64_t percentile(double q) const {
+    if (count_ == 0) return 0;
+    uint64_t target = std::max<uint64_t>(1, uint64_t(std::ceil(q * count_)));
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < nbuckets; i++) {
+      cumulative += counts_[i];
+      if (cumulative >= target)
+        return std::min(max_, bucket_lower(i) + bucket_width(i) / 2);
+    }
+    return max_;
+  }
+
+  histogram_summary summary() const {
+    return {count(),          min(),            max(),
+            mean(),           percentile(0.5),  percentile(0.9),
+            percentile(0.99), percentile(0.999)};
+  }
+
+ private:
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  uint64_t sum_ = 0;
+  uint64_t max_ = 0;
+};
+
+// A histogram that any number of threads can record into concurrently.  Each
+// thread records into its own buckets with plain (relaxed, non-RMW) atomic
+// increments, so record() costs a few nanoseconds and snapshot() may run at
+// any time.
+class histogram {
+ public:
+  void record(uint64_t value) { shards_.local().record(value); }
+
+  histogram_snapshot snapshot() {
+    histogram_snapshot result;
+    shards_.for_each([&](const shard& s) { s.add_to(result); });
+    return result;
+  }
+
+ private:
+  struct shard {
+    static void increment(std::atomic<uint64_t>& a, uint64_t n) {
+      a.store(a.load(std::memory_order_relaxed) + n,
+              std::memory_order_relaxed);
+    }
+
+    void record(uint64_t value) {
+      increment(counts[histogram_snapshot::bucket_of(value)], 1);
+      increment(sum, value);
+      if (value > max.load(std::memory_order_relaxed))
+        max.store(value, std::memory_order_relaxed);
+    }
+
+    void add_to(histogram_snapshot& snapshot) const {
+      for (size_t i = 0; i < histogram_snapshot::nbuckets; i++) {
+        uint64_t count = counts[i].load(std::memory_order_relaxed);
+        if (count) snapshot.add(i, count);
+      }
+      snapshot.add_sum(sum.load(std::memory_order_relaxed));
+      snapshot.add_max(max.load(std::memory_order_relaxed));
+    }
+
+    std::array<std::atomic<uint64_t>, histogram_snapshot::nbuckets> counts{};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> max{0};
+  };
+
+  per_thread<shard> shards_;
+};
+
+// Records the nanoseconds between its construction and destruction, timed
+// with tsc_clock.
+class scoped_timer {
+ public:
+  explicit scoped_timer(histogram& h)
+      : histogram_(h), start_(tsc_clock::ticks()) {}
+
+  ~scoped_timer() {
+    histogram_.record(tsc_clock::to_ns(tsc_clock::ticks() - start_));
+  }
+
+  scoped_timer(const scoped_timer&) = delete;
+  scoped_timer& operator=(const scoped_timer&) = delete;
+
+ private:
+  histogram& histogram_;
+  uint64_t start_;
+};
+
+// The global registry.  get_histogram() returns the histogram registered
+// under name, creating it on first use; the reference stays valid for the
+// life of the program.
+histogram& get_histogram(std::string_view name);
+
+std::vector<std::pair<std::string, histogram_summary>> histogram_summaries();
+
+// Writes an object mapping each histogram name to its histogram_summary.
+void write_histograms(json_writer& writer);
+
+// Logs one line per histogram with DVC_LOG.
+void log_histograms();
+
+// Calls log_histograms() every period until destroyed.
+class histogram_reporter {
+ public:
+  explicit histogram_reporter(std::chrono::milliseconds period);
+  ~histogram_reporter();
+
+ private:
+  std::mutex mu_;
+  std::condition_variable cv_;
+  bool done_ = false;
+  std::thread thread_;
+};
+
+}  // namespace dvc
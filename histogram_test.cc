@@ -0,0 +1,104 @@
+#include "dvc/histogram.h"
+
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+
+void test_buckets() {
+  using snapshot = dvc::histogram_snapshot;
+  for (uint64_t v = 0; v < (1 << 20); v++) {
+    size_t b = snapshot::bucket_of(v);
+    DVC_ASSERT_LE(snapshot::bucket_lower(b), v);
+    DVC_ASSERT_LT(v, snapshot::bucket_lower(b) + snapshot::bucket_width(b));
+  }
+  DVC_ASSERT_EQ(snapshot::bucket_of(~uint64_t(0)), snapshot::nbuckets - 1);
+}
+
+void test_accuracy() {
+  dvc::histogram h;
+  std::vector<uint64_t> values;
+  std::mt19937_64 ran;
+  std::lognormal_distribution<double> dist(10, 2);
+  for (size_t i = 0; i < 1000000; i++) values.push_back(dist(ran));
+  for (uint64_t v : values) h.record(v);
+  std::sort(values.begin(), values.end());
+
+  dvc::histogram_snapshot s = h.snapshot();
+  DVC_ASSERT_EQ(s.count(), values.size());
+  DVC_ASSERT_EQ(s.max(), values.back());
+  for (double q : {0.5, 0.9, 0.99, 0.999}) {
+    double exact = values[size_t(std::ceil(q * values.size())) - 1];
+    DVC_ASSERT_LT(std::abs(s.percentile(q) / exact - 1), 0.032, "q = ", q);
+  }
+}
+
+void test_record_cost() {
+  dvc::histogram h;
+  size_t n = size_t(1) << 26;
+  size_t start = dvc::now();
+  for (size_t i = 0; i < n; i++) h.record(i & 0xFFFFF);
+  size_t end = dvc::now();
+  DVC_LOG("record: ", double(end - start) / n, "ns");
+  DVC_ASSERT_EQ(h.snapshot().count(), n);
+
+  n = size_t(1) << 24;
+  start = dvc::now();
+  for (size_t i = 0; i < n; i++) {
+    DVC_TIMED_SCOPE("histogram_test.timed_scope");
+  }
+  end = dvc::now();
+  DVC_LOG("timed scope: ", double(end - start) / n, "ns");
+}
+
+void test_threads(size_t nthreads) {
+  dvc::histogram& h = dvc::get_histogram("histogram_test.threads");
+  dvc::histogram_reporter reporter(std::chrono::milliseconds(100));
+  size_t n = size_t(1) << 26;
+  size_t start = dvc::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+    threads.emplace_back([&, t] {
+      for (size_t i = t; i < n; i += nthreads) h.record(i & 0xFFFF);
+    });
+  for (std::thread& thread : threads) thread.join();
+  size_t end = dvc::now();
+  DVC_LOG(nthreads, " threads: ", double(end - start) / n, "ns");
+}
+
+void test_report() {
+  dvc::histogram& h = dvc::get_histogram("histogram_test.report");
+  for (uint64_t v = 1; v <= 1000; v++) h.record(v);
+
+  std::ostringstream oss;
+  {
+    dvc::json_writer writer(oss);
+    dvc::write_histograms(writer);
+  }
+  std::map<std::string, dvc::histogram_summary> summaries;
+  DVC_ASSERT(dvc::from_json(oss.str(), summaries));
+  const dvc::histogram_summary& s = summaries.at("histogram_test.report");
+  DVC_ASSERT_EQ(s.count, 1000u);
+  DVC_ASSERT_EQ(s.min, 1u);
+  DVC_ASSERT_EQ(s.max, 1000u);
+  DVC_ASSERT_EQ(s.mean, 500.5);
+  DVC_ASSERT_LT(std::abs(double(s.p50) - 500), 16.0);
+  DVC_ASSERT_LT(std::abs(double(s.p99) - 990), 32.0);
+  DVC_ASSERT(summaries.count("histogram_test.timed_scope"));
+
+  dvc::log_histograms();
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_buckets();
+  test_accuracy();
+  test_record_cost();
+  for (size_t nthreads = 1; nthreads <= 2 * std::thread::hardware_concurrency();
+       nthreads *= 2)
+    test_threads(nthreads);
+  test_report();
+}
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+#include "dvc/hash.h"
+#include "dvc/log.h"
+
+namespace dvc {
+
+// A HyperLogLog++ cardinality sketch (Heule, Nunkesser and Hall, 2013) with
+// 2^p registers, for a relative standard error of about 1.04 / sqrt(2^p)
+// (0.8% at the default p = 14).
+//
+// Small cardinalities use the sparse representation: a list of (index, rank)
+// pairs at precision 25, estimated by linear counting, which is nearly exact.
+// It converts to 2^p dense registers once it would be larger than them.  The
+// dense estimate uses Ertl's improved estimator (2017), which is unbiased over
+// the whole range without HLL++'s empirical bias tables.
+class hyperloglog {
+ public:
+  static constexpr int sparse_precision = 25;
+
+  explicit hyperloglog(int p = 14) : p_(p) {
+    DVC_ASSERT(p >= 4 && p <= 18, "hyperloglog precision out of range: ", p);
+  }
+
+  template <typename T>
+  void add(const T& t) {
+    add_hash(hash64(t));
+  }
+
+  void add_hash(uint64_t h) {
+    if (sparse()) {
+      uint32_t index = h >> (64 - sparse_precision);
+      uint32_t rank = std::min(__builtin_clzll(h << sparse_precision | 1),
+                               64 - sparse_precision) +
+                      1;
+      buffer_.push_back(index << 6 | rank);
+      if (buffer_.size() >= max_sparse() / 4) flush_buffer();
+    } else {
+      update(h >> (64 - p_),
+             std::min(__builtin_clzll(h << p_ | 1), 64 - p_) + 1);
+    }
+  }
+
+  void merge(const hyperloglog& other) {
+    DVC_ASSERT_EQ(p_, other.p_);
+    if (other.sparse()) {
+      if (sparse()) {
+        buffer_.insert(buffer_.end(), other.sparse_.begin(),
+                       other.sparse_.end());
+        buffer_.insert(buffer_.end(), other.buffer_.begin(),
+                       other.buffer_.end());
+        flush_buffer();
+      } else {
+        for (uint32_t e : other.sparse_) update_from_sparse(e);
+        for (uint32_t e : other.buffer_) update_from_sparse(e);
+      }
+    } else {
+      if (sparse()) to_dense();
+      for (size_t i = 0; i < registers_.size(); i++)
+        registers_[i] = std::max(registers_[i], other.registers_[i]);
+    }
+  }
+
+  double estimate() const {
+    if (sparse()) {
+      std::vector<uint32_t> entries = normalized(sparse_, buffer_);
+      double m = double(uint64_t(1) << sparse_precision);
+      return m * std::log(m / (m - entries.size()));
+    }
+
+    // Ertl, "New cardinality estimation algorithms for HyperLogLog
+    // sketches", algorithm 6.
+    const int q = 64 - p_;
+    std::vector<uint64_t> counts(q + 2);
+    for (uint8_t r : registers_) counts[r]++;
+    double m = double(registers_.size());
+    double z = m * tau(1 - counts[q + 1] / m);
+    for (int k = q; k >= 1; k--) z = 0.5 * (z + counts[k]);
+    z += m * sigma(counts[0] / m);
+    return m * m / (2 * std::log(2.0) * z);
+  }
+
+  bool sparse() const { return registers_.empty(); }
+
+  template <typename Writer>
+  void write(Writer& writer) const {
+    writer.vwrite(p_);
+    writer.vwrite(sparse());
+    if (sparse()) {
+      // Sorted entries are written as varint deltas.
+      std::vector<uint32_t> entries = normalized(sparse_, buffer_);
+      writer.vwrite(entries.size());
+      uint32_t prev = 0;
+      for (uint32_t e : entries) {
+        writer.vwrite(e - prev);
+        prev = e;
+      }
+    } else {
+      writer.write(registers_.data(), registers_.size());
+    }
+  }
+
+  template <typename Reader>
+  static hyperloglog read(Reader& reader) {
+    hyperloglog sketch(reader.vread());
+    if (reader.vread()) {
+      sketch.sparse_.resize(reader.vread());
+      uint32_t prev = 0;
+      for (uint32_t& e : sketch.sparse_) e = prev += reader.vread();
+    } else {
+      sketch.registers_.resize(size_t(1) << sketch.p_);
+      reader.read(sketch.registers_.data(), sketch.registers_.size());
+    }
+    return sketch;
+  }
+
+ private:
+  size_t max_sparse() const { return (size_t(1) << p_) / 4; }
+
+  void update(size_t index, uint8_t rank) {
+    if (registers_[index] < rank) registers_[index] = rank;
+  }
+
+  void update_from_sparse(uint32_t e) {
+    uint32_t index = e >> 6;
+    uint8_t rank = e & 63;
+    const int extra = sparse_precision - p_;
+    uint32_t low = index & ((uint32_t(1) << extra) - 1);
+    if (low != 0)
+      rank = __builtin_clz(low) - (32 - extra) + 1;
+    else
+      rank += extra;
+    update(index >> extra, rank);
+  }
+
+  // Sorts and deduplicates, keeping the largest rank for each index.
+  static std::vector<uint32_t> normalized(const std::vector<uint32_t>& a,
+                                          const std::vector<uint32_t>& b) {
+    std::vector<uint32_t> entries(a);
+    entries.insert(entries.end(), b.begin(), b.end());
+    std::sort(entries.begin(), entries.end(), std::greater<uint32_t>());
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](uint32_t x, uint32_t y) {
+                                return (x >> 6) == (y >> 6);
+                              }),
+                  entries.end());
+    std::reverse(entries.begin(), entries.end());
+    return entries;
+  }
+
+  void flush_buffer() {
+    sparse_ = normalized(sparse_, buffer_);
+    buffer_.clear();
+    if (sparse_.size() > max_sparse()) to_dense();
+  }
+
+  void to_dense() {
+    registers_.assign(size_t(1) << p_, 0);
+    for (uint32_t e : sparse_) update_from_sparse(e);
+    for (uint32_t e : buffer_) update_from_sparse(e);
+    sparse_ = {};
+    buffer_ = {};
+  }
+
+  static double sigma(double x) {
+    if (x == 1) return std::numeric_limits<double>::infinity();
+    double y = 1, z = x, prev;
+    do {
+      x *= x;
+      prev = z;
+      z += x * y;
+      y += y;
+    } while (z != prev);
+    return z;
+  }
+
+  static double tau(double x) {
+    if (x == 0 || x == 1) return 0;
+    double y = 1, z = 1 - x, prev;
+    do {
+      x = std::sqrt(x);
+      prev = z;
+      y *= 0.5;
+      z -= (1 - x) * (1 - x) * y;
+    } while (z != prev);
+    return z / 3;
+  }
+
+  int p_;
+  std::vector<uint8_t> registers_;
+  std::vector<uint32_t> sparse_;
+  std::vector<uint32_t> buffer_;
+};
+
+}  // namespace dvc
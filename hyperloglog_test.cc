@@ -0,0 +1,79 @@
+#include "dvc/hyperloglog.h"
+
+#include <thread>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/per_thread.h"
+#include "dvc/program.h"
+
+void test_accuracy() {
+  dvc::hyperloglog sketch;
+  size_t next = 1;
+  size_t elapsed = 0;
+  for (size_t n = 1; n <= (size_t(1) << 26); n *= 4) {
+    size_t start = dvc::now();
+    for (; next <= n; next++) sketch.add(next);
+    elapsed += dvc::now() - start;
+    double error = sketch.estimate() / n - 1;
+    DVC_LOG("hyperloglog: n = ", n, " estimate = ", sketch.estimate(),
+            " error = ", error, (sketch.sparse() ? " (sparse)" : ""));
+    DVC_ASSERT_LT(std::abs(error), sketch.sparse() ? 0.001 : 0.03);
+    // Duplicates do not count.
+    for (size_t i = 1; i <= std::min(n, size_t(1000)); i++) sketch.add(i);
+    DVC_ASSERT_LT(std::abs(sketch.estimate() / n - 1 - error), 1e-9);
+  }
+  DVC_LOG("hyperloglog: ", double(elapsed) / (next - 1), "ns");
+}
+
+void test_threads(size_t nthreads) {
+  size_t n = size_t(1) << 26;
+
+  dvc::sharded<dvc::hyperloglog> sketch;
+  size_t start = dvc::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+    threads.emplace_back([&, t] {
+      auto& local = sketch.local();
+      for (size_t i = t; i < n; i += nthreads) local.add(i);
+    });
+  for (std::thread& thread : threads) thread.join();
+  dvc::hyperloglog merged = sketch.merged();
+  size_t end = dvc::now();
+
+  DVC_LOG("hyperloglog ", nthreads, " threads: ", double(end - start) / n,
+          "ns");
+  DVC_ASSERT_LT(std::abs(merged.estimate() / n - 1), 0.03);
+}
+
+void test_serialize() {
+  for (size_t n : {100, 1000000}) {
+    dvc::hyperloglog sketch(12);
+    for (size_t i = 0; i < n; i++) sketch.add(std::to_string(i));
+
+    std::filesystem::path path =
+        std::filesystem::temp_directory_path() / "hyperloglog_test.hll";
+    {
+      dvc::file_writer writer(path, dvc::truncate);
+      sketch.write(writer);
+    }
+    dvc::file_reader reader(path);
+    auto copy = dvc::hyperloglog::read(reader);
+    std::filesystem::remove(path);
+
+    DVC_ASSERT_EQ(copy.sparse(), sketch.sparse());
+    DVC_ASSERT_EQ(copy.estimate(), sketch.estimate());
+    copy.merge(sketch);
+    DVC_ASSERT_EQ(copy.estimate(), sketch.estimate());
+  }
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_accuracy();
+  for (size_t nthreads = 1; nthreads <= 2 * std::thread::hardware_concurrency();
+       nthreads *= 2)
+    test_threads(nthreads);
+  test_serialize();
+}
@@ -1,14 +1,239 @@
 #pragma once
 
+#include <rapidjson/document.h>
 #include <rapidjson/ostreamwrapper.h>
 #include <rapidjson/writer.h>
 
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <map>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "dvc/log.h"
 
+// A namespace-scope declaration of the form:
+//
+//    DVC_JSON_FIELDS(T, field1, field2, ..., fieldn);
+//
+// where `T` is a class type and `field1`...`fieldn` are (at most 32) of its
+// public data members, makes `T` serializable by `json_writer::write` and
+// deserializable by `from_json`.  It must appear in the namespace of `T` so
+// that it is found by argument-dependent lookup.
+//
+// Keys are quoted at compile time and written with a raw byte copy, and
+// readers dispatch incoming keys to fields through a perfect hash computed at
+// compile time.  Supported member types are bool, arithmetic types,
+// std::string, std::optional (omitted when empty), std::vector,
+// std::map<std::string, V> and other types with DVC_JSON_FIELDS.
+
+#define DVC_JSON_FIELDS(T, ...)                                 \
+  [[maybe_unused]] constexpr auto dvc_json_fields(const T*) {   \
+    return std::make_tuple(                                     \
+        DVC_JSON_FIELDS_SELECT(__VA_ARGS__)(T, __VA_ARGS__));   \
+  }                                                             \
+  static_assert(true)
+
+#define DVC_JSON_FIELD(T, x) ::dvc::make_json_field(#x, &T::x)
+
+#define DVC_JSON_FIELDS_1(T, x) DVC_JSON_FIELD(T, x)
+#define DVC_JSON_FIELDS_2(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_1(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_3(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_2(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_4(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_3(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_5(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_4(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_6(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_5(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_7(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_6(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_8(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_7(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_9(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_8(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_10(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_9(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_11(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_10(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_12(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_11(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_13(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_12(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_14(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_13(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_15(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_14(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_16(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_15(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_17(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_16(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_18(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_17(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_19(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_18(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_20(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_19(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_21(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_20(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_22(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_21(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_23(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_22(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_24(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_23(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_25(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_24(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_26(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_25(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_27(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_26(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_28(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_27(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_29(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_28(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_30(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_29(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_31(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_30(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_32(T, x, ...) \
+  DVC_JSON_FIELD(T, x), DVC_JSON_FIELDS_31(T, __VA_ARGS__)
+#define DVC_JSON_FIELDS_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, \
+    _13, _14, _15, _16, _17, _18, _19, _20, _21, _22, _23, _24, _25, _26,    \
+    _27, _28, _29, _30, _31, _32, N, ...)                                    \
+  DVC_JSON_FIELDS_##N
+#define DVC_JSON_FIELDS_SELECT(...) \
+  DVC_JSON_FIELDS_N(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, \
+                    21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, \
+                    6, 5, 4, 3, 2, 1)
+
 namespace dvc {
 
+// A JSON object key, quoted at compile time.
+template <size_t N>
+struct json_key {
+  constexpr json_key(const char (&name)[N]) : quoted() {
+    quoted[0] = '"';
+    for (size_t i = 0; i < N - 1; i++) {
+      if (name[i] == '"' || name[i] == '\\' || uint8_t(name[i]) < 0x20)
+        throw "json_key: key requires escaping";
+      quoted[i + 1] = name[i];
+    }
+    quoted[N] = '"';
+  }
+
+  constexpr std::string_view name() const { return {quoted.data() + 1, N - 1}; }
+  constexpr std::string_view raw() const { return {quoted.data(), N + 1}; }
+
+  std::array<char, N + 1> quoted;
+};
+
+template <typename Class, typename Member, size_t N>
+struct json_field {
+  json_key<N> key;
+  Member Class::*member;
+};
+
+template <typename Class, typename Member, size_t N>
+constexpr json_field<Class, Member, N> make_json_field(const char (&name)[N],
+                                                       Member Class::*member) {
+  return {json_key<N>(name), member};
+}
+
+template <typename T, typename = void>
+struct has_json_fields : std::false_type {};
+
+template <typename T>
+struct has_json_fields<
+    T, std::void_t<decltype(dvc_json_fields(std::declval<const T*>()))>>
+    : std::true_type {};
+
+template <typename T>
+constexpr auto json_fields_of() {
+  return dvc_json_fields(static_cast<const T*>(nullptr));
+}
+
+constexpr uint32_t json_key_hash(std::string_view key, uint32_t seed) {
+  uint32_t h = 2166136261u ^ seed;
+  for (char c : key) {
+    h ^= uint8_t(c);
+    h *= 16777619u;
+  }
+  return h ^ (h >> 15);
+}
+
+// A collision-free mapping from the keys of a DVC_JSON_FIELDS type to field
+// indexes.  slots[hash & mask] is the field index plus one, or zero if empty.
+template <size_t nfields>
+struct json_key_table {
+  static constexpr size_t size() {
+    size_t n = 4;
+    while (n < 4 * nfields) n *= 2;
+    return n;
+  }
+
+  uint32_t seed = 0;
+  std::array<uint8_t, size()> slots = {};
+
+  constexpr uint8_t lookup(std::string_view key) const {
+    return slots[json_key_hash(key, seed) & (size() - 1)];
+  }
+};
+
+template <typename T>
+constexpr auto make_json_key_table() {
+  constexpr auto fields = json_fields_of<T>();
+  constexpr size_t nfields = std::tuple_size_v<decltype(fields)>;
+  static_assert(nfields < 255, "too many json fields");
+  std::array<std::string_view, nfields> names = {};
+  std::apply(
+      [&](const auto&... field) {
+        size_t i = 0;
+        ((names[i++] = field.key.name()), ...);
+      },
+      fields);
+  json_key_table<nfields> table;
+  for (uint32_t seed = 0; true; seed++) {
+    table.seed = seed;
+    table.slots = {};
+    bool collision = false;
+    for (size_t i = 0; i < nfields && !collision; i++) {
+      uint8_t& slot = table.slots[json_key_hash(names[i], seed) &
+                                  (table.size() - 1)];
+      if (slot != 0) collision = true;
+      slot = i + 1;
+    }
+    if (!collision) return table;
+  }
+}
+
+template <typename T>
+constexpr auto json_key_table_of = make_json_key_table<T>();
+
+template <typename T>
+struct is_optional : std::false_type {};
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type {};
+
+template <typename T>
+struct is_vector : std::false_type {};
+template <typename T, typename A>
+struct is_vector<std::vector<T, A>> : std::true_type {};
+
+template <typename T>
+struct is_string_map : std::false_type {};
+template <typename V, typename C, typename A>
+struct is_string_map<std::map<std::string, V, C, A>> : std::true_type {};
+
 class json_writer {
  public:
   json_writer(std::ostream& o)
@@ -21,6 +246,10 @@ class json_writer {
 
   void write_number(double d) { DVC_ASSERT(writer.Double(d)); }
 
+  void write_int(int64_t i) { DVC_ASSERT(writer.Int64(i)); }
+
+  void write_uint(uint64_t u) { DVC_ASSERT(writer.Uint64(u)); }
+
   void write_string(std::string_view sv) {
     DVC_ASSERT(writer.String(sv.data(), sv.size()));
   }
@@ -29,6 +258,12 @@ class json_writer {
     DVC_ASSERT(writer.Key(sv.data(), sv.size()));
   }
 
+  // Writes an already quoted and escaped key, such as json_key::raw().
+  void write_raw_key(std::string_view quoted) {
+    DVC_ASSERT(
+        writer.RawValue(quoted.data(), quoted.size(), rapidjson::kStringType));
+  }
+
   void start_object() { DVC_ASSERT(writer.StartObject()); }
 
   void end_object() { DVC_ASSERT(writer.EndObject()); }
@@ -37,9 +272,155 @@ class json_writer {
 
   void end_array() { DVC_ASSERT(writer.EndArray()); }
 
+  template <typename T>
+  void write(const T& t) {
+    if constexpr (std::is_same_v<T, bool>) {
+      write_bool(t);
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+      write_int(t);
+    } else if constexpr (std::is_integral_v<T>) {
+      write_uint(t);
+    } else if constexpr (std::is_floating_point_v<T>) {
+      write_number(t);
+    } else if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      write_string(t);
+    } else if constexpr (is_optional<T>::value) {
+      if (t)
+        write(*t);
+      else
+        write_null();
+    } else if constexpr (is_vector<T>::value) {
+      start_array();
+      for (const auto& element : t) write(element);
+      end_array();
+    } else if constexpr (is_string_map<T>::value) {
+      start_object();
+      for (const auto& [key, value] : t) {
+        write_key(key);
+        write(value);
+      }
+      end_object();
+    } else {
+      static_assert(has_json_fields<T>::value,
+                    "type not serializable, see DVC_JSON_FIELDS");
+      static constexpr auto fields = json_fields_of<T>();
+      start_object();
+      std::apply([&](const auto&... field) { (write_field(t, field), ...); },
+                 fields);
+      end_object();
+    }
+  }
+
  private:
+  template <typename T, typename Field>
+  void write_field(const T& t, const Field& field) {
+    const auto& value = t.*field.member;
+    if constexpr (is_optional<std::decay_t<decltype(value)>>::value) {
+      if (!value) return;
+    }
+    write_raw_key(field.key.raw());
+    write(value);
+  }
+
   std::unique_ptr<rapidjson::OStreamWrapper> ostream_wrapper;
   rapidjson::Writer<rapidjson::OStreamWrapper> writer;
 };
 
+template <typename T>
+std::string to_json(const T& t) {
+  std::ostringstream oss;
+  {
+    json_writer writer(oss);
+    writer.write(t);
+  }
+  return oss.str();
+}
+
+template <typename T>
+[[nodiscard]] bool from_json(const rapidjson::Value& json, T& t);
+
+template <typename T, size_t... I>
+[[nodiscard]] bool from_json_field(const rapidjson::Value& json, T& t,
+                                   size_t index, std::index_sequence<I...>) {
+  static constexpr auto fields = json_fields_of<T>();
+  bool result = false;
+  ((index == I ? (result = from_json(json, t.*std::get<I>(fields).member),
+                  true)
+               : false) ||
+   ...);
+  return result;
+}
+
+template <typename T>
+[[nodiscard]] bool from_json(const rapidjson::Value& json, T& t) {
+  if constexpr (std::is_same_v<T, bool>) {
+    if (!json.IsBool()) return false;
+    t = json.GetBool();
+  } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+    if (!json.IsInt64()) return false;
+    int64_t i = json.GetInt64();
+    if (i < std::numeric_limits<T>::min() || i > std::numeric_limits<T>::max())
+      return false;
+    t = i;
+  } else if constexpr (std::is_integral_v<T>) {
+    if (!json.IsUint64()) return false;
+    uint64_t u = json.GetUint64();
+    if (u > std::numeric_limits<T>::max()) return false;
+    t = u;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    if (!json.IsNumber()) return false;
+    t = json.GetDouble();
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    if (!json.IsString()) return false;
+    t.assign(json.GetString(), json.GetStringLength());
+  } else if constexpr (is_optional<T>::value) {
+    if (json.IsNull()) {
+      t.reset();
+      return true;
+    }
+    return from_json(json, t.emplace());
+  } else if constexpr (is_vector<T>::value) {
+    if (!json.IsArray()) return false;
+    t.clear();
+    for (auto it = json.Begin(); it != json.End(); ++it)
+      if (!from_json(*it, t.emplace_back())) return false;
+  } else if constexpr (is_string_map<T>::value) {
+    if (!json.IsObject()) return false;
+    t.clear();
+    for (auto it = json.MemberBegin(); it != json.MemberEnd(); ++it) {
+      std::string key(it->name.GetString(), it->name.GetStringLength());
+      if (!from_json(it->value, t[std::move(key)])) return false;
+    }
+  } else {
+    static_assert(has_json_fields<T>::value,
+                  "type not deserializable, see DVC_JSON_FIELDS");
+    static constexpr auto fields = json_fields_of<T>();
+    constexpr size_t nfields = std::tuple_size_v<decltype(fields)>;
+    static constexpr std::array<std::string_view, nfields> names =
+        std::apply(
+            [](const auto&... field) {
+              return std::array<std::string_view, nfields>{field.key.name()...};
+            },
+            fields);
+    if (!json.IsObject()) return false;
+    for (auto it = json.MemberBegin(); it != json.MemberEnd(); ++it) {
+      std::string_view key(it->name.GetString(), it->name.GetStringLength());
+      uint8_t slot = json_key_table_of<T>.lookup(key);
+      if (slot == 0 || names[slot - 1] != key) continue;
+      if (!from_json_field(it->value, t, slot - 1,
+                           std::make_index_sequence<nfields>()))
+        return false;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+[[nodiscard]] bool from_json(std::string_view json, T& t) {
+  rapidjson::Document document;
+  document.Parse(json.data(), json.size());
+  if (document.HasParseError()) return false;
+  return from_json(static_cast<const rapidjson::Value&>(document), t);
+}
+
 }  // namespace dvc
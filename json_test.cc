@@ -0,0 +1,93 @@
+#include "dvc/json.h"
+
+#include "dvc/log.h"
+
+namespace test {
+
+struct point {
+  double x = 0;
+  double y = 0;
+};
+DVC_JSON_FIELDS(point, x, y);
+
+struct shape {
+  std::string name;
+  int64_t id = 0;
+  bool closed = false;
+  std::vector<point> points;
+  std::optional<std::string> label;
+  std::map<std::string, uint32_t> tags;
+};
+DVC_JSON_FIELDS(shape, name, id, closed, points, label, tags);
+
+}  // namespace test
+
+void test_write() {
+  test::shape s;
+  s.name = "tri\"angle";
+  s.id = -7;
+  s.closed = true;
+  s.points = {{0, 0}, {1.5, 0}, {0, 2}};
+  s.tags = {{"a", 1}, {"b", 2}};
+
+  DVC_ASSERT_EQ(dvc::to_json(s),
+                "{\"name\":\"tri\\\"angle\",\"id\":-7,\"closed\":true,"
+                "\"points\":[{\"x\":0.0,\"y\":0.0},{\"x\":1.5,\"y\":0.0},"
+                "{\"x\":0.0,\"y\":2.0}],\"tags\":{\"a\":1,\"b\":2}}");
+
+  s.label = "L";
+  DVC_ASSERT(dvc::to_json(s).find("\"label\":\"L\"") != std::string::npos);
+}
+
+void test_round_trip() {
+  test::shape s;
+  s.name = "square";
+  s.id = 42;
+  s.points = {{1, 2}, {3, 4}};
+  s.label = "box";
+  s.tags = {{"sides", 4}};
+
+  test::shape t;
+  DVC_ASSERT(dvc::from_json(dvc::to_json(s), t));
+  DVC_ASSERT_EQ(t.name, s.name);
+  DVC_ASSERT_EQ(t.id, s.id);
+  DVC_ASSERT_EQ(t.closed, s.closed);
+  DVC_ASSERT_EQ(t.points.size(), 2u);
+  DVC_ASSERT_EQ(t.points[1].x, 3.0);
+  DVC_ASSERT_EQ(t.points[1].y, 4.0);
+  DVC_ASSERT(t.label.has_value());
+  DVC_ASSERT_EQ(t.label.value(), "box");
+  DVC_ASSERT_EQ(t.tags.at("sides"), 4u);
+}
+
+void test_read() {
+  test::shape s;
+  DVC_ASSERT(dvc::from_json(
+      "{\"unknown\":[1,2],\"id\":3,\"label\":null,\"points\":[{\"y\":1}]}",
+      s));
+  DVC_ASSERT_EQ(s.id, 3);
+  DVC_ASSERT(!s.label.has_value());
+  DVC_ASSERT_EQ(s.points.size(), 1u);
+  DVC_ASSERT_EQ(s.points[0].y, 1.0);
+
+  DVC_ASSERT(!dvc::from_json("{\"id\":\"three\"}", s));
+  DVC_ASSERT(!dvc::from_json("{\"tags\":{\"a\":-1}}", s));
+  DVC_ASSERT(!dvc::from_json("{\"id\":", s));
+}
+
+void test_key_table() {
+  constexpr auto& table = dvc::json_key_table_of<test::shape>;
+  size_t i = 0;
+  auto check = [&](std::string_view name) {
+    DVC_ASSERT_EQ(size_t(table.lookup(name)), ++i, name);
+  };
+  std::apply([&](const auto&... field) { (check(field.key.name()), ...); },
+             dvc::json_fields_of<test::shape>());
+}
+
+int main() {
+  test_write();
+  test_round_trip();
+  test_read();
+  test_key_table();
+}
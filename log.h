@@ -2,21 +2,22 @@
 
 #include <iostream>
 
+#include "dvc/fixed_string.h"
 #include "dvc/string.h"
 #include "dvc/time.h"
 
-#define DVC_LOG(...)                                     \
-  do {                                                   \
-    ::dvc::info(__FILE__, ':', __LINE__,                 \
-                ": info: ", ::dvc::concat(__VA_ARGS__)); \
+#define DVC_LOG(...)                                           \
+  do {                                                         \
+    ::dvc::info(__FILE__, ':', __LINE__,                       \
+                ": info: ", ::dvc::defer_concat(__VA_ARGS__)); \
   } while (0)
 
 #define DVC_DUMP(expr) DVC_LOG(#expr, " = ", (expr));
 
-#define DVC_ERROR(...)                                     \
-  do {                                                     \
-    ::dvc::error(__FILE__, ':', __LINE__,                  \
-                 ": error: ", ::dvc::concat(__VA_ARGS__)); \
+#define DVC_ERROR(...)                                           \
+  do {                                                           \
+    ::dvc::error(__FILE__, ':', __LINE__,                        \
+                 ": error: ", ::dvc::defer_concat(__VA_ARGS__)); \
   } while (0)
 
 #define DVC_FATAL(...)                                     \
@@ -49,18 +50,24 @@
 
 namespace dvc {
 
+// Writes the timestamped line with a single write, building it on the stack
+// for typical lengths.
+template <typename... Args>
+void log_line(std::ostream& o, const Args&... args) {
+  string_builder line;
+  line.append(now_fixed_string(), ' ', args...).push_back('\n');
+  o.write(line.data(), line.size());
+  o.flush();
+}
+
 template <typename... Args>
 void info(Args&&... args) {
-  std::cout << now_string() << " ";
-  (std::cout << ... << std::forward<Args>(args));
-  std::cout << std::endl;
+  log_line(std::cout, args...);
 }
 
 template <typename... Args>
 void error(Args&&... args) {
-  std::cerr << now_string() << " ";
-  (std::cerr << ... << std::forward<Args>(args));
-  std::cerr << std::endl;
+  log_line(std::cerr, args...);
 }
 
 template <typename... Args>
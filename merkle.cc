@@ -0,0 +1,220 @@
+#include "dvc/merkle.h"
+
+#include <algorithm>
+#include <string>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/sha3.h"
+
+namespace dvc {
+namespace {
+
+constexpr std::string_view merkle_magic = "DVCMRKL1";
+
+// Below this many nodes a level is hashed on the calling thread.
+constexpr size_t parallel_threshold = 64;
+
+template <typename F>
+void for_each_index(size_t n, thread_pool& pool, F&& f) {
+  if (n < parallel_threshold) {
+    for (size_t i = 0; i < n; i++) f(i);
+  } else {
+    pool.parallel_for(0, n, f);
+  }
+}
+
+}  // namespace
+
+merkle_hash merkle_tree::hash_leaf(std::string_view data) {
+  thread_local std::string buffer;
+  buffer.assign(1, '\0');
+  buffer.append(data);
+  merkle_hash h;
+  SHA3_256(buffer.data(), buffer.size(), h.data());
+  return h;
+}
+
+merkle_hash merkle_tree::hash_node(const merkle_hash& left,
+                                   const merkle_hash& right) {
+  std::byte buffer[1 + 2 * sizeof(merkle_hash)];
+  buffer[0] = std::byte{1};
+  std::copy(left.begin(), left.end(), buffer + 1);
+  std::copy(right.begin(), right.end(), buffer + 1 + left.size());
+  merkle_hash h;
+  SHA3_256(buffer, sizeof(buffer), h.data());
+  return h;
+}
+
+merkle_tree merkle_tree::from_blocks(std::string_view data, size_t block_size,
+                                     thread_pool& pool) {
+  DVC_ASSERT_GT(block_size, 0u);
+  merkle_tree tree;
+  tree.block_size_ = block_size;
+  tree.data_size_ = data.size();
+  tree.resize((data.size() + block_size - 1) / block_size);
+  auto& leaves = tree.levels_[0];
+  for_each_index(leaves.size(), pool, [&](size_t i) {
+    leaves[i] = hash_leaf(data.substr(i * block_size, block_size));
+  });
+  tree.build(pool);
+  return tree;
+}
+
+merkle_tree merkle_tree::from_leaves(std::vector<merkle_hash> leaves,
+                                     thread_pool& pool) {
+  merkle_tree tree;
+  size_t n = leaves.size();
+  tree.levels_.push_back(std::move(leaves));
+  tree.resize(n);
+  tree.build(pool);
+  return tree;
+}
+
+merkle_hash merkle_tree::root() const {
+  if (num_leaves() == 0) return {};
+  return levels_.back()[0];
+}
+
+void merkle_tree::resize(size_t num_leaves) {
+  if (levels_.empty()) levels_.emplace_back();
+  levels_[0].resize(num_leaves);
+  size_t k = 0;
+  for (size_t n = num_leaves; n > 1; k++) {
+    n = (n + 1) / 2;
+    if (levels_.size() == k + 1) levels_.emplace_back();
+    levels_[k + 1].resize(n);
+  }
+  levels_.resize(k + 1);
+  // The last node of every level may now have a different sibling.
+  if (num_leaves > 0) dirty_.push_back(num_leaves - 1);
+}
+
+void merkle_tree::build(thread_pool& pool) {
+  for (size_t k = 0; k + 1 < levels_.size(); k++) {
+    const auto& below = levels_[k];
+    auto& above = levels_[k + 1];
+    for_each_index(above.size(), pool, [&](size_t i) {
+      above[i] = 2 * i + 1 < below.size()
+                     ? hash_node(below[2 * i], below[2 * i + 1])
+                     : below[2 * i];
+    });
+  }
+  dirty_.clear();
+}
+
+void merkle_tree::set_leaf(size_t i, const merkle_hash& hash) {
+  DVC_ASSERT_LT(i, num_leaves());
+  levels_[0][i] = hash;
+  dirty_.push_back(i);
+}
+
+void merkle_tree::update(std::string_view data, size_t offset, size_t length,
+                         thread_pool& pool) {
+  DVC_ASSERT_GT(block_size_, 0u, "update needs a tree from from_blocks");
+  size_t old_leaves = num_leaves();
+  size_t new_leaves = (data.size() + block_size_ - 1) / block_size_;
+  if (new_leaves != old_leaves) resize(new_leaves);
+
+  std::vector<size_t> blocks;
+  size_t end = std::min(new_leaves,
+                        (offset + length + block_size_ - 1) / block_size_);
+  for (size_t i = offset / block_size_; i < end; i++) blocks.push_back(i);
+  // If data was resized, the old and new last blocks changed length, and
+  // any blocks past the old end are new.
+  if (data.size() != data_size_) {
+    if (old_leaves > 0 && old_leaves <= new_leaves)
+      blocks.push_back(old_leaves - 1);
+    for (size_t i = old_leaves; i < new_leaves; i++) blocks.push_back(i);
+    if (new_leaves > 0) blocks.push_back(new_leaves - 1);
+    data_size_ = data.size();
+  }
+  std::sort(blocks.begin(), blocks.end());
+  blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+
+  auto& leaves = levels_[0];
+  for_each_index(blocks.size(), pool, [&](size_t j) {
+    size_t i = blocks[j];
+    leaves[i] = hash_leaf(data.substr(i * block_size_, block_size_));
+  });
+  dirty_.insert(dirty_.end(), blocks.begin(), blocks.end());
+  rehash(pool);
+}
+
+void merkle_tree::rehash(thread_pool& pool) {
+  std::vector<size_t> dirty = std::move(dirty_);
+  dirty_.clear();
+  for (size_t k = 0; k + 1 < levels_.size(); k++) {
+    for (size_t& i : dirty) i /= 2;
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    while (!dirty.empty() && dirty.back() >= levels_[k + 1].size())
+      dirty.pop_back();
+    const auto& below = levels_[k];
+    auto& above = levels_[k + 1];
+    for_each_index(dirty.size(), pool, [&](size_t j) {
+      size_t i = dirty[j];
+      above[i] = 2 * i + 1 < below.size()
+                     ? hash_node(below[2 * i], below[2 * i + 1])
+                     : below[2 * i];
+    });
+  }
+}
+
+merkle_proof merkle_tree::prove(size_t index) const {
+  DVC_ASSERT_LT(index, num_leaves());
+  DVC_ASSERT(dirty_.empty(), "rehash before proving");
+  merkle_proof proof;
+  proof.index = index;
+  proof.num_leaves = num_leaves();
+  for (size_t k = 0; k + 1 < levels_.size(); k++, index /= 2) {
+    size_t sibling = index ^ 1;
+    if (sibling < levels_[k].size())
+      proof.siblings.push_back(levels_[k][sibling]);
+  }
+  return proof;
+}
+
+bool merkle_tree::verify(const merkle_hash& root, const merkle_hash& leaf,
+                         const merkle_proof& proof) {
+  if (proof.index >= proof.num_leaves) return false;
+  merkle_hash h = leaf;
+  size_t index = proof.index;
+  size_t s = 0;
+  for (size_t n = proof.num_leaves; n > 1; n = (n + 1) / 2, index /= 2) {
+    size_t sibling = index ^ 1;
+    if (sibling >= n) continue;
+    if (s == proof.siblings.size()) return false;
+    const merkle_hash& other = proof.siblings[s++];
+    h = index % 2 == 0 ? hash_node(h, other) : hash_node(other, h);
+  }
+  return s == proof.siblings.size() && h == root;
+}
+
+void merkle_tree::save(const std::filesystem::path& filename) const {
+  DVC_ASSERT(dirty_.empty(), "rehash before saving");
+  file_writer writer(filename, truncate);
+  writer.write(merkle_magic);
+  writer.vwrite(block_size_);
+  writer.vwrite(data_size_);
+  writer.vwrite(num_leaves());
+  for (const auto& level : levels_)
+    writer.write(level.data(), level.size() * sizeof(merkle_hash));
+}
+
+merkle_tree merkle_tree::load(const std::filesystem::path& filename) {
+  file_reader reader(filename);
+  if (reader.size() < merkle_magic.size() ||
+      reader.read_string(merkle_magic.size()) != merkle_magic)
+    DVC_FAIL("not a merkle tree file: ", filename);
+  merkle_tree tree;
+  tree.block_size_ = reader.vread();
+  tree.data_size_ = reader.vread();
+  tree.resize(reader.vread());
+  tree.dirty_.clear();
+  for (auto& level : tree.levels_)
+    reader.read(level.data(), level.size() * sizeof(merkle_hash));
+  return tree;
+}
+
+}  // namespace dvc
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+#include <vector>
+
+#include "dvc/thread_pool.h"
+
+namespace dvc {
+
+using merkle_hash = std::array<std::byte, 32>;
+
+// An inclusion proof: the sibling hashes on the path from a leaf to the
+// root, bottom up.  Levels where the path node has no sibling are skipped.
+struct merkle_proof {
+  size_t index = 0;
+  size_t num_leaves = 0;
+  std::vector<merkle_hash> siblings;
+};
+
+// A binary hash tree over a sequence of leaf hashes, with every level kept
+// so that changing a leaf re-hashes only its path to the root.  Hashes are
+// SHA3-256; leaves hashed from data are prefixed with a 0 byte and interior
+// nodes with a 1 byte, so a leaf can never be passed off as a node.  A last
+// node without a sibling moves up a level unchanged.
+//
+// The tree is either over fixed-size blocks of some data, hashed by the
+// tree, or over leaf hashes supplied by the caller, such as chunk_ids.
+class merkle_tree {
+ public:
+  merkle_tree() = default;
+
+  // A tree over data in blocks of block_size bytes, the last possibly
+  // shorter.  Leaves and levels are hashed on pool.
+  static merkle_tree from_blocks(std::string_view data, size_t block_size,
+                                 thread_pool& pool = default_pool());
+
+  // A tree over the given leaves.
+  static merkle_tree from_leaves(std::vector<merkle_hash> leaves,
+                                 thread_pool& pool = default_pool());
+
+  static merkle_hash hash_leaf(std::string_view data);
+  static merkle_hash hash_node(const merkle_hash& left,
+                               const merkle_hash& right);
+
+  // The root, or all zeros for an empty tree.
+  merkle_hash root() const;
+  size_t num_leaves() const { return levels_.empty() ? 0 : levels_[0].size(); }
+  size_t block_size() const { return block_size_; }
+  // The size of the data of a from_blocks tree.
+  size_t data_size() const { return data_size_; }
+  const merkle_hash& leaf(size_t i) const { return levels_[0][i]; }
+
+  // Sets a leaf; the tree is out of date until rehash().
+  void set_leaf(size_t i, const merkle_hash& hash);
+
+  // Brings a from_blocks tree up to date after bytes [offset, offset +
+  // length) of data changed, and data was resized to its current size.
+  // Only the blocks touched are re-hashed, and if the size changed, the old
+  // and new last blocks and any added, then rehash() is called.
+  void update(std::string_view data, size_t offset, size_t length,
+              thread_pool& pool = default_pool());
+
+  // Recomputes the nodes above leaves set since the last rehash, level by
+  // level.
+  void rehash(thread_pool& pool = default_pool());
+
+  merkle_proof prove(size_t index) const;
+  static bool verify(const merkle_hash& root, const merkle_hash& leaf,
+                     const merkle_proof& proof);
+
+  // The file format is "DVCMRKL1", varint block size, varint data size,
+  // varint leaf count, then every level's hashes, leaves first.
+  void save(const std::filesystem::path& filename) const;
+  static merkle_tree load(const std::filesystem::path& filename);
+
+ private:
+  void resize(size_t num_leaves);
+  void build(thread_pool& pool);
+
+  size_t block_size_ = 0;
+  size_t data_size_ = 0;
+  std::vector<std::vector<merkle_hash>> levels_;  // leaves first, root last
+  std::vector<size_t> dirty_;                     // leaf indices
+};
+
+}  // namespace dvc
@@ -0,0 +1,171 @@
+#include "dvc/merkle.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <random>
+
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/sha3.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(merkle_mb, -, 16, "size of the benchmark file");
+
+std::string random_data(size_t size, uint64_t seed) {
+  std::mt19937_64 rng(seed);
+  std::string s(size, '\0');
+  for (char& c : s) c = char(rng());
+  return s;
+}
+
+// The root computed directly from the definition.
+dvc::merkle_hash reference_root(std::vector<dvc::merkle_hash> level) {
+  if (level.empty()) return {};
+  while (level.size() > 1) {
+    std::vector<dvc::merkle_hash> above;
+    for (size_t i = 0; i < level.size(); i += 2)
+      above.push_back(i + 1 < level.size()
+                          ? dvc::merkle_tree::hash_node(level[i], level[i + 1])
+                          : level[i]);
+    level = std::move(above);
+  }
+  return level[0];
+}
+
+void test_build() {
+  dvc::thread_pool pool(3);
+  for (size_t size : {0, 1, 99, 100, 101, 1000, 12345}) {
+    std::string data = random_data(size, size);
+    auto tree = dvc::merkle_tree::from_blocks(data, 100, pool);
+    DVC_ASSERT_EQ(tree.num_leaves(), (size + 99) / 100);
+    std::vector<dvc::merkle_hash> leaves;
+    for (size_t i = 0; i < size; i += 100)
+      leaves.push_back(
+          dvc::merkle_tree::hash_leaf(std::string_view(data).substr(i, 100)));
+    DVC_ASSERT(tree.root() == reference_root(leaves), size);
+    DVC_ASSERT(dvc::merkle_tree::from_leaves(leaves, pool).root() ==
+               tree.root());
+  }
+  // A single leaf is its own root.
+  dvc::merkle_hash h = dvc::merkle_tree::hash_leaf("x");
+  DVC_ASSERT(dvc::merkle_tree::from_leaves({h}).root() == h);
+}
+
+void test_update() {
+  dvc::thread_pool pool(2);
+  std::mt19937_64 rng(1);
+  std::string data = random_data(50000, 1);
+  auto tree = dvc::merkle_tree::from_blocks(data, 256, pool);
+  for (int i = 0; i < 200; i++) {
+    size_t offset = rng() % data.size();
+    size_t length = rng() % 1000;
+    switch (rng() % 4) {
+      case 0:  // grow
+        data.append(random_data(length, i));
+        offset = data.size() - length;
+        break;
+      case 1:  // shrink
+        length = std::min(length, data.size() - 1);
+        data.resize(data.size() - length);
+        offset = data.size();
+        length = 0;
+        break;
+      default:  // overwrite
+        length = std::min(length, data.size() - offset);
+        data.replace(offset, length, random_data(length, i));
+    }
+    tree.update(data, offset, length, pool);
+    DVC_ASSERT(tree.root() ==
+                   dvc::merkle_tree::from_blocks(data, 256, pool).root(),
+               i);
+  }
+
+  // An in-place write re-hashes only the blocks it touched, so a change to
+  // the last block that update isn't told about is not seen.
+  dvc::merkle_hash last = tree.leaf(tree.num_leaves() - 1);
+  data.back() ^= 1;
+  data[0] ^= 1;
+  tree.update(data, 0, 1, pool);
+  DVC_ASSERT(tree.leaf(tree.num_leaves() - 1) == last);
+  DVC_ASSERT(tree.leaf(0) == dvc::merkle_tree::hash_leaf(data.substr(0, 256)));
+
+  // set_leaf then rehash, on a tree of chunk ids.
+  std::vector<dvc::merkle_hash> leaves(37);
+  for (size_t i = 0; i < leaves.size(); i++)
+    leaves[i] = dvc::merkle_tree::hash_leaf(std::to_string(i));
+  auto ids = dvc::merkle_tree::from_leaves(leaves, pool);
+  leaves[5] = leaves[36] = dvc::merkle_tree::hash_leaf("changed");
+  ids.set_leaf(5, leaves[5]);
+  ids.set_leaf(36, leaves[36]);
+  ids.rehash(pool);
+  DVC_ASSERT(ids.root() == reference_root(leaves));
+}
+
+void test_proofs() {
+  for (size_t n = 1; n <= 33; n++) {
+    std::vector<dvc::merkle_hash> leaves(n);
+    for (size_t i = 0; i < n; i++)
+      leaves[i] = dvc::merkle_tree::hash_leaf(std::to_string(i));
+    auto tree = dvc::merkle_tree::from_leaves(leaves);
+    for (size_t i = 0; i < n; i++) {
+      dvc::merkle_proof proof = tree.prove(i);
+      DVC_ASSERT(dvc::merkle_tree::verify(tree.root(), leaves[i], proof), n,
+                 " ", i);
+      DVC_ASSERT(!dvc::merkle_tree::verify(tree.root(), leaves[(i + 1) % n],
+                                           proof) ||
+                 n == 1);
+      if (!proof.siblings.empty()) {
+        proof.siblings.back()[0] ^= std::byte{1};
+        DVC_ASSERT(!dvc::merkle_tree::verify(tree.root(), leaves[i], proof));
+      }
+    }
+  }
+}
+
+void test_save_load(const std::filesystem::path& filename) {
+  std::string data = random_data(10000, 2);
+  auto tree = dvc::merkle_tree::from_blocks(data, 64);
+  tree.save(filename);
+  auto loaded = dvc::merkle_tree::load(filename);
+  DVC_ASSERT(loaded.root() == tree.root());
+  DVC_ASSERT_EQ(loaded.num_leaves(), tree.num_leaves());
+  DVC_ASSERT_EQ(loaded.block_size(), 64u);
+  DVC_ASSERT_EQ(loaded.data_size(), data.size());
+  data[5000] ^= 1;
+  loaded.update(data, 5000, 1);
+  DVC_ASSERT(loaded.root() == dvc::merkle_tree::from_blocks(data, 64).root());
+  DVC_ASSERT(dvc::merkle_tree::verify(loaded.root(), loaded.leaf(3),
+                                      loaded.prove(3)));
+}
+
+void benchmark() {
+  std::string data = random_data(merkle_mb << 20, 3);
+  size_t start = dvc::now();
+  dvc::SHA3_256(data);
+  size_t hashed = dvc::now();
+  auto tree = dvc::merkle_tree::from_blocks(data, 64 << 10);
+  size_t built = dvc::now();
+  data[data.size() / 2] ^= 1;
+  tree.update(data, data.size() / 2, 1);
+  size_t updated = dvc::now();
+  DVC_LOG(merkle_mb, "MB: whole-file SHA3 ", (hashed - start) / 1e6,
+          "ms, tree build ", (built - hashed) / 1e6, "ms with ",
+          dvc::default_pool().size(), " threads, one-byte update ",
+          (updated - built) / 1e6, "ms");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_build();
+  test_update();
+  test_proofs();
+  std::filesystem::path filename =
+      std::filesystem::temp_directory_path() /
+      dvc::concat("merkle_test.", ::getpid());
+  test_save_load(filename);
+  std::filesystem::remove(filename);
+  benchmark();
+}
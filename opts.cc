@@ -1,9 +1,24 @@
 #include "dvc/opts.h"
 
-#include <map>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
 #include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
 
-#include "dvc/parser.h"
+#include "dvc/file.h"
+#include "dvc/flat_hash_map.h"
 
 namespace dvc {
 
@@ -12,32 +27,32 @@ namespace {
 struct Options {
   std::vector<option*> raw_options;
   std::mutex mu;
-  option& get_option(const std::string& name) {
-    option* o = options_by_name[name];
-    if (o == nullptr) DVC_FAIL("unknown option '", name, "'");
-    return *o;
+  option& get_option(std::string_view name) {
+    auto it = options_by_name.find(name);
+    if (it == options_by_name.end()) DVC_FAIL("unknown option '", name, "'");
+    return *it->second;
   }
 
   option& get_option_letter(char c) {
-    option* o = options_by_letter[c];
+    option* o = options_by_letter[uint8_t(c)];
     if (o == nullptr) DVC_FAIL("unknown option -", c);
     return *o;
   }
 
-  std::map<std::string, option*> options_by_name;
-  std::map<char, option*> options_by_letter;
+  flat_hash_map<std::string, option*> options_by_name;
+  std::array<option*, 256> options_by_letter{};
 
   void compile() {
     std::lock_guard lock(mu);
+    options_by_name.reserve(raw_options.size());
     for (option* o : raw_options) {
       {
-        auto& obn = options_by_name[o->name];
-        DVC_ASSERT(obn == nullptr, "Two options by same name '", o->name,
-                   "': (1) ", obn->to_string(), "; (2) ", o->to_string());
-        obn = o;
+        auto [it, inserted] = options_by_name.try_emplace(o->name, o);
+        DVC_ASSERT(inserted, "Two options by same name '", o->name, "': (1) ",
+                   it->second->to_string(), "; (2) ", o->to_string());
       }
       if (o->letter) {
-        auto& obl = options_by_letter[o->letter.value()];
+        auto& obl = options_by_letter[uint8_t(o->letter.value())];
         DVC_ASSERT(obl == nullptr, "Two options by same letter '",
                    o->letter.value(), "': (1) ", obl->to_string(), "; (2) ",
                    o->to_string());
@@ -56,135 +71,396 @@ Options& options() {
   return o;
 }
 
-struct Char {
-  int val;
-
-  char to_char() const { return char(uint8_t(val)); }
+bool is_alpha(char c) { return std::isalpha(static_cast<unsigned char>(c)); }
 
-  bool operator==(char c) const { return val < 256 && c == to_char(); }
-  bool operator!=(char c) const { return !(*this == c); }
-  bool operator==(const Char& c) const { return val == c.val; }
-  bool operator!=(const Char& c) const { return val != c.val; }
-
-  bool eoa() const { return to_char() == 0; }
-  bool eof() const { return val == -1; }
-};
-
-struct ArgParser : dvc::parser<Char> {
-  ArgParser(std::vector<Char> tokens)
-      : dvc::parser<Char>("command-line arguments", std::move(tokens)) {}
-
-  bool literal_mode = false;
+std::string_view trim(std::string_view s) {
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front())))
+    s.remove_prefix(1);
+  while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back())))
+    s.remove_suffix(1);
+  return s;
+}
 
-  std::string parse_arg() {
-    std::ostringstream oss;
-    while (true) {
-      Char c = pop();
-      if (c.eoa()) return oss.str();
-      oss.put(c.to_char());
-    }
+// The options set by one of the command line, the environment or an
+// options file.  Values are views into argv, the environment, mapped
+// response files or read options files, so they must be applied while those
+// are alive.
+struct source {
+  struct assignment {
+    option* o;
+    size_t begin, end;  // in values
+  };
+
+  std::vector<std::string_view> values;
+  std::vector<assignment> assignments;
+
+  void add(option& o, std::string_view value) {
+    assignments.push_back({&o, values.size(), values.size() + 1});
+    values.push_back(value);
   }
 
-  void parse_double_dash() {
-    literal_mode = true;
-    incr(3);
+  // Sets a bool option from a word, or another option from its value.  A
+  // false bool is still an assignment, so it overrides an earlier source.
+  void add_parsed(option& o, std::string_view value, std::string_view where) {
+    if (!o.is_bool()) return add(o, value);
+    if (value == "1" || value == "true") return add(o, "1");
+    if (value == "0" || value == "false" || value.empty()) return add(o, "0");
+    DVC_FAIL("Bad value for bool option ", o.name, " in ", where, ": '", value,
+             "'");
   }
 
-  void parse_long_option() {
-    incr(2);
+  // Passes the values to the options.  A later source overrides an earlier
+  // one: a scalar or bool is set again, and a vector is replaced.
+  void apply() const {
+    for (const assignment& a : assignments) {
+      if (a.o->is_vector()) {
+        a.o->reserve_values(a.end - a.begin);
+        for (size_t i = a.begin; i < a.end; i++) a.o->add_value(values[i]);
+      } else {
+        a.o->set_value(values[a.begin]);
+      }
+    }
+  }
+};
 
-    bool eq;
+// Parses argv in place: arguments and option values are string_views into
+// argv or mapped response files, so nothing is copied but the positional
+// arguments kept in dvc::args.
+class ArgParser {
+ public:
+  ArgParser(std::vector<std::string_view> args, source& out)
+      : args_(std::move(args)), out_(out) {}
 
-    std::ostringstream oss;
-    while (true) {
-      Char c = pop();
-      if (c.eoa()) {
-        eq = false;
-        break;
-      }
-      if (c == '=') {
-        eq = true;
-        break;
+  void parse() {
+    while (i_ < args_.size()) {
+      std::string_view arg = args_[i_];
+      if (literal_mode_) {
+        positional();
+      } else if (arg.size() > 1 && arg[0] == '-') {
+        if (arg[1] == '-') {
+          if (arg.size() == 2) {
+            literal_mode_ = true;
+            i_++;
+          } else {
+            parse_long_option();
+          }
+        } else if (is_alpha(arg[1])) {
+          parse_short_options();
+        } else {
+          positional();
+        }
+      } else {
+        positional();
       }
-      oss.put(c.to_char());
     }
+  }
 
-    std::string option_name = oss.str();
-    option& o = options().get_option(option_name);
-    if (eq && o.is_bool()) DVC_FAIL("Argument given to bool option: ", o.name);
+ private:
+  void positional() { dvc::args.emplace_back(args_[i_++]); }
 
-    parse_option_args(o);
+  void parse_long_option() {
+    std::string_view arg = args_[i_++].substr(2);
+    size_t eq = arg.find('=');
+    option& o = options().get_option(arg.substr(0, eq));
+    if (eq == std::string_view::npos) {
+      parse_option_args(o, std::nullopt);
+    } else {
+      if (o.is_bool()) DVC_FAIL("Argument given to bool option: ", o.name);
+      parse_option_args(o, arg.substr(eq + 1));
+    }
   }
 
   void parse_short_options() {
-    incr(1);
-    bool done = false;
-    do {
-      Char c = pop();
-      if (peek().eoa()) {
-        incr();
-        done = true;
-      }
-      if (!parse_option_args(options().get_option_letter(c.to_char()))) return;
-    } while (!done);
+    std::string_view arg = args_[i_++].substr(1);
+    while (true) {
+      option& o = options().get_option_letter(arg[0]);
+      arg.remove_prefix(1);
+      // The rest of the argument, if any, is the option's first value.
+      std::optional<std::string_view> rest;
+      if (!arg.empty()) rest = arg;
+      if (!parse_option_args(o, rest) || !rest) return;
+    }
   }
 
-  bool parse_option_args(option& o) {
+  // Sets o from value, if any, and then from the following arguments as
+  // its type needs.  Returns whether value was left unused.
+  bool parse_option_args(option& o, std::optional<std::string_view> value) {
     if (o.is_bool()) {
-      o.set_value("1");
+      out_.add(o, "1");
       return true;
     } else if (o.is_scalar()) {
-      if (peek().eof()) DVC_FAIL("Expected argument for: ", o.name);
-      o.set_value(parse_arg());
+      if (!value && i_ == args_.size())
+        DVC_FAIL("Expected argument for: ", o.name);
+      out_.add(o, value ? *value : args_[i_++]);
       return false;
     } else if (o.is_vector()) {
-      if (peek().eof()) DVC_FAIL("Expected arguments for: ", o.name);
-      do {
-        o.add_value(parse_arg());
-      } while (continue_vecargs());
+      if (!value && i_ == args_.size())
+        DVC_FAIL("Expected arguments for: ", o.name);
+      size_t begin = out_.values.size();
+      out_.values.push_back(value ? *value : args_[i_++]);
+      while (i_ < args_.size() && continue_vecargs(args_[i_]))
+        out_.values.push_back(args_[i_++]);
+      out_.assignments.push_back({&o, begin, out_.values.size()});
       return false;
     } else {
       DVC_FATAL();
     }
   }
 
-  bool continue_vecargs() {
-    if (peek(0).eof()) return false;
-
-    if (peek(0) != '-') return true;
+  // Whether arg is another value of a vector option rather than an option.
+  static bool continue_vecargs(std::string_view arg) {
+    if (arg.empty() || arg[0] != '-') return true;
+    if (arg.size() == 1) return true;
+    if (arg[1] == '-') return false;
+    return !is_alpha(arg[1]);
+  }
 
-    if (peek(1) == '-') return false;
+  std::vector<std::string_view> args_;
+  source& out_;
+  size_t i_ = 0;
+  bool literal_mode_ = false;
+};
 
-    if (peek(1).eoa()) return true;
+constexpr int max_response_file_depth = 16;
+
+// Appends arg to out, or if it is @file, the lines of file, expanded the
+// same way.
+void expand_arg(std::string_view arg, std::vector<mapped_file>& files,
+                std::vector<std::string_view>& out, int depth = 0) {
+  if (arg.size() < 2 || arg[0] != '@') return out.push_back(arg);
+  if (depth == max_response_file_depth)
+    DVC_FAIL("response files nested too deeply at ", arg);
+  std::filesystem::path path(arg.substr(1));
+  std::string_view data;
+  try {
+    data = files.emplace_back(path).data();
+  } catch (const std::filesystem::filesystem_error& e) {
+    DVC_FAIL("cannot read response file ", path.native(), ": ",
+             e.code().message());
+  }
+  while (!data.empty()) {
+    size_t eol = data.find('\n');
+    std::string_view line = data.substr(0, eol);
+    data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    if (!line.empty()) expand_arg(line, files, out, depth + 1);
+  }
+}
 
-    if (std::isalpha(peek(1).to_char())) return false;
+// DVC_<NAME> for each option.
+void parse_environment(source& out) {
+  std::string var;
+  for (option* o : options().raw_options) {
+    var = "DVC_";
+    for (char c : o->name) var += std::toupper(static_cast<unsigned char>(c));
+    const char* value = std::getenv(var.c_str());
+    if (!value) continue;
+    if (!o->is_vector()) {
+      out.add_parsed(*o, value, var);
+      continue;
+    }
+    // Vector values are separated by whitespace.
+    size_t begin = out.values.size();
+    std::string_view rest = value;
+    while (!(rest = trim(rest)).empty()) {
+      size_t n = 0;
+      while (n < rest.size() &&
+             !std::isspace(static_cast<unsigned char>(rest[n])))
+        n++;
+      out.values.push_back(rest.substr(0, n));
+      rest.remove_prefix(n);
+    }
+    if (out.values.size() > begin)
+      out.assignments.push_back({o, begin, out.values.size()});
+  }
+}
 
+// The binary cache of a parsed options file is:
+//
+//   "DVCOPTC2"
+//   the file_stat of the options file: uint64 dev, ino, size, int64 mtime_ns
+//   uint64 count, then per entry uint32 name size, uint32 value size, name,
+//   value
+constexpr std::string_view options_cache_magic = "DVCOPTC2";
+
+// The contents of options files and their caches, which parsed entries
+// point into.  They are read rather than mapped, since an options file
+// edited in place while it is parsed would fault a mapping with SIGBUS.
+using file_texts = std::deque<std::string>;
+
+// The stat of the options file when it was last read, unless it was racy
+// then.
+struct {
+  std::mutex mu;  // also serializes reloads
+  std::optional<file_stat> loaded;
+} options_file_state;
+
+using entries = std::vector<std::pair<std::string_view, std::string_view>>;
+
+// Reads the cache at path, if it is for a file with this stat.
+bool read_options_cache(const std::string& path, const file_stat& stat,
+                        file_texts& texts, entries& out) {
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) return false;
+  std::string_view data = texts.emplace_back(load_file(path));
+  auto read = [&](auto& x) {
+    if (data.size() < sizeof(x)) return false;
+    std::memcpy(&x, data.data(), sizeof(x));
+    data.remove_prefix(sizeof(x));
     return true;
+  };
+  auto read_string = [&](uint32_t size, std::string_view& s) {
+    if (data.size() < size) return false;
+    s = data.substr(0, size);
+    data.remove_prefix(size);
+    return true;
+  };
+  file_stat cached;
+  uint64_t count;
+  if (data.substr(0, options_cache_magic.size()) != options_cache_magic)
+    return false;
+  data.remove_prefix(options_cache_magic.size());
+  if (!read(cached.dev) || !read(cached.ino) || !read(cached.size) ||
+      !read(cached.mtime_ns) || cached != stat || !read(count))
+    return false;
+  out.reserve(count);
+  for (uint64_t i = 0; i < count; i++) {
+    uint32_t name_size, value_size;
+    std::string_view name, value;
+    if (!read(name_size) || !read(value_size) ||
+        !read_string(name_size, name) || !read_string(value_size, value)) {
+      out.clear();
+      return false;
+    }
+    out.emplace_back(name, value);
   }
+  return true;
+}
 
-  void parse() {
-    while (true) {
-      if (peek(0).eof()) return;
-
-      if (literal_mode)
-        dvc::args.push_back(parse_arg());
-      else if (peek(0) == '-') {
-        if (peek(1) == '-') {
-          if (peek(2).eoa())
-            parse_double_dash();
-          else
-            parse_long_option();
-        } else if (!peek(1).eoa() && std::isalpha(peek(1).to_char())) {
-          parse_short_options();
-        } else {
-          dvc::args.push_back(parse_arg());
-        }
-      } else {
-        dvc::args.push_back(parse_arg());
-      }
+void write_options_cache(const std::string& path, const file_stat& stat,
+                         const entries& parsed) {
+  std::string tmp = concat(path, ".", ::getpid());
+  {
+    file_writer writer(tmp, truncate);
+    writer.write(options_cache_magic);
+    writer.rwrite(stat.dev);
+    writer.rwrite(stat.ino);
+    writer.rwrite(stat.size);
+    writer.rwrite(stat.mtime_ns);
+    writer.rwrite(uint64_t(parsed.size()));
+    for (const auto& [name, value] : parsed) {
+      writer.rwrite(uint32_t(name.size()));
+      writer.rwrite(uint32_t(value.size()));
+      writer.write(name);
+      writer.write(value);
     }
   }
-};
+  std::filesystem::rename(tmp, path);
+}
+
+// Parses lines of "name = value", skipping blank lines and # comments.
+// Malformed lines are skipped and described in error.
+entries parse_options_lines(const std::string& path, std::string_view data,
+                            std::string& error) {
+  entries parsed;
+  for (size_t line_number = 1; !data.empty(); line_number++) {
+    size_t eol = data.find('\n');
+    std::string_view line = trim(data.substr(0, eol));
+    data.remove_prefix(eol == std::string_view::npos ? data.size() : eol + 1);
+    if (line.empty() || line[0] == '#') continue;
+    size_t eq = line.find('=');
+    if (eq == std::string_view::npos) {
+      append_concat(error, path, ":", line_number,
+                    ": expected name = value\n");
+      continue;
+    }
+    parsed.emplace_back(trim(line.substr(0, eq)), trim(line.substr(eq + 1)));
+  }
+  return parsed;
+}
+
+// Reads the options file at path through its cache, path.cache, which is
+// rewritten whenever the file's stat changes.  A racy file, or one whose
+// stat changes while it is parsed, is not cached and its stat is not
+// recorded, so that it is read again.  Throws if path can't be read.
+entries read_options_file(const std::string& path, file_texts& texts,
+                          std::string& error) {
+  file_stat stat = file_stat::of(path);
+  bool racy = stat.racy();
+  std::string cache_path = path + ".cache";
+  entries parsed;
+  if (racy || !read_options_cache(cache_path, stat, texts, parsed)) {
+    parsed = parse_options_lines(path, texts.emplace_back(load_file(path)),
+                                 error);
+    racy = racy || file_stat::of(path) != stat;
+    try {
+      if (error.empty() && !racy) write_options_cache(cache_path, stat, parsed);
+    } catch (const std::exception&) {
+      // Read-only directories just go without a cache.
+    }
+  }
+  options_file_state.loaded.reset();
+  if (!racy) options_file_state.loaded = stat;
+  return parsed;
+}
+
+void parse_options_file(const std::string& path, file_texts& texts,
+                        source& out) {
+  std::string error;
+  entries parsed;
+  try {
+    parsed = read_options_file(path, texts, error);
+  } catch (const std::filesystem::filesystem_error& e) {
+    DVC_FAIL("cannot read options file ", path, ": ", e.code().message());
+  }
+  if (!error.empty()) DVC_FAIL(error);
+  std::string where = concat("options file ", path);
+  for (const auto& [name, value] : parsed) {
+    option& o = options().get_option(name);
+    if (o.is_vector() && !out.assignments.empty() &&
+        out.assignments.back().o == &o) {
+      // Consecutive lines for a vector option form one assignment.
+      out.values.push_back(value);
+      out.assignments.back().end++;
+      continue;
+    }
+    // A vector set again further on would otherwise be silently appended to.
+    if (o.is_vector())
+      for (const auto& a : out.assignments)
+        if (a.o == &o)
+          DVC_FAIL("option ", name, " set on non-consecutive lines in ",
+                   where);
+    out.add_parsed(o, value, where);
+  }
+}
+
+bool options_file_changed(const std::string& path) {
+  std::lock_guard lock(options_file_state.mu);
+  try {
+    return !options_file_state.loaded ||
+           file_stat::of(path) != *options_file_state.loaded;
+  } catch (const std::filesystem::filesystem_error&) {
+    return false;  // perhaps being replaced
+  }
+}
+
+// The write end of the watcher's pipe, for the SIGHUP handler.
+std::atomic<int> sighup_fd{-1};
+
+void on_sighup(int) {
+  int saved_errno = errno;
+  char c = 'h';
+  [[maybe_unused]] ssize_t r = ::write(sighup_fd.load(), &c, 1);
+  errno = saved_errno;
+}
+
+struct {
+  std::mutex mu;
+  std::thread thread;
+  int pipe[2] = {-1, -1};
+  std::atomic<bool> stop{false};
+  struct sigaction old_action;
+} watcher;
 
 }  // namespace
 
@@ -197,6 +473,8 @@ std::string program_name;
 std::vector<std::string> args;
 
 bool DVC_OPTION(help, h, false, "list program options");
+std::string DVC_OPTION(options_file, -, "",
+                       "file of option defaults, one name = value per line");
 
 void init_options(int argc, char** argv) {
   static bool called = false;
@@ -209,18 +487,52 @@ void init_options(int argc, char** argv) {
 
   program_name = argv[0];
 
-  std::vector<Char> tokens;
+  // Response and options files, alive until the values are applied.
+  std::vector<mapped_file> files;
+  file_texts texts;
 
-  for (char** s = argv + 1; s != argv + argc; s++) {
-    for (size_t i = 0; true; i++) {
-      tokens.push_back({int(uint8_t((*s)[i]))});
-      if ((*s)[i] == 0) break;
+  std::vector<std::string_view> expanded;
+  expanded.reserve(argc);
+  for (int i = 1; i < argc; i++) {
+    if (std::string_view(argv[i]) == "--") {
+      expanded.insert(expanded.end(), argv + i, argv + argc);
+      break;
     }
+    expand_arg(argv[i], files, expanded);
   }
-  tokens.push_back({-1});
-
-  ArgParser arg_parser(std::move(tokens));
-  arg_parser.parse();
+  source command_line;
+  dvc::args.reserve(expanded.size());
+  ArgParser(std::move(expanded), command_line).parse();
+
+  source environment;
+  parse_environment(environment);
+
+  // The options file can itself be named on the command line or in the
+  // environment.
+  std::string_view options_file_path = options_file;
+  for (const source* s : {&environment, &command_line})
+    for (const auto& a : s->assignments)
+      if (a.o == &DVC_OPTION_options_file)
+        options_file_path = s->values[a.begin];
+  source file;
+  if (!options_file_path.empty())
+    parse_options_file(std::string(options_file_path), texts, file);
+
+  // Later sources take precedence.  An option may be set only once per
+  // source, but may be set again by a later one.
+  std::vector<bool> set(options().raw_options.size());
+  for (const source* s : {&file, &environment, &command_line}) {
+    for (size_t i = 0; i < set.size(); i++) {
+      option* o = options().raw_options[i];
+      set[i] = set[i] || o->set;
+      o->set = false;
+    }
+    s->apply();
+  }
+  for (size_t i = 0; i < set.size(); i++)
+    options().raw_options[i]->set = options().raw_options[i]->set || set[i];
+  for (const source* s : {&environment, &command_line})
+    for (const auto& a : s->assignments) a.o->pinned = true;
 
   options().check_required();
 
@@ -235,4 +547,110 @@ void init_options(int argc, char** argv) {
   }
 }
 
+bool set_reloadable_option(std::string_view name, std::string_view value,
+                           std::string* error) {
+  std::string message;
+  auto it = options().options_by_name.find(name);
+  if (it == options().options_by_name.end()) {
+    message = concat("unknown option '", name, "'");
+  } else if (!it->second->is_reloadable()) {
+    message = concat("option '", name, "' is not reloadable");
+  } else {
+    std::lock_guard lock(options_file_state.mu);
+    if (it->second->reload(value, message)) return true;
+  }
+  if (error) *error = std::move(message);
+  return false;
+}
+
+bool reload_options(std::string* error) {
+  std::lock_guard lock(options_file_state.mu);
+  std::string errors;
+  file_texts texts;
+  std::unordered_map<option*, std::string_view> values;
+  if (!options_file.empty()) {
+    try {
+      for (const auto& [name, value] :
+           read_options_file(options_file, texts, errors)) {
+        auto it = options().options_by_name.find(name);
+        if (it == options().options_by_name.end()) {
+          append_concat(errors, options_file, ": unknown option '", name,
+                        "'\n");
+        } else if (it->second->is_reloadable()) {
+          values[it->second] = value;
+        }
+      }
+    } catch (const std::exception& e) {
+      if (error) *error = e.what();
+      return false;
+    }
+  }
+  auto value_of = [&](option* o) -> std::optional<std::string_view> {
+    auto it = values.find(o);
+    if (it == values.end()) return std::nullopt;
+    return it->second;
+  };
+  // Check every value before setting any, so that a bad file changes
+  // nothing.
+  std::string message;
+  for (option* o : options().raw_options) {
+    if (!o->is_reloadable() || o->pinned) continue;
+    if (!o->check_reload(value_of(o), message))
+      append_concat(errors, message, "\n");
+  }
+  if (errors.empty()) {
+    for (option* o : options().raw_options) {
+      if (!o->is_reloadable() || o->pinned) continue;
+      // Only fails if a validator changed since the check.
+      if (!o->reload(value_of(o), message))
+        append_concat(errors, message, "\n");
+    }
+  }
+  if (error) *error = errors;
+  return errors.empty();
+}
+
+void watch_options(std::chrono::milliseconds poll_interval) {
+  std::lock_guard lock(watcher.mu);
+  DVC_ASSERT(!watcher.thread.joinable(), "already watching options");
+  if (::pipe2(watcher.pipe, O_CLOEXEC | O_NONBLOCK) != 0)
+    DVC_FATAL("pipe2: ", std::strerror(errno));
+  sighup_fd = watcher.pipe[1];
+  struct sigaction action = {};
+  action.sa_handler = on_sighup;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  ::sigaction(SIGHUP, &action, &watcher.old_action);
+  watcher.stop = false;
+  watcher.thread = std::thread([poll_interval] {
+    while (true) {
+      pollfd p = {watcher.pipe[0], POLLIN, 0};
+      int ready = ::poll(&p, 1, poll_interval.count());
+      if (watcher.stop) return;
+      bool signalled = false;
+      char buffer[64];
+      while (ready > 0 && ::read(watcher.pipe[0], buffer, sizeof(buffer)) > 0)
+        signalled = true;
+      if (!signalled &&
+          (options_file.empty() || !options_file_changed(options_file)))
+        continue;
+      std::string error;
+      if (!reload_options(&error)) DVC_ERROR("reloading options: ", error);
+    }
+  });
+}
+
+void stop_watching_options() {
+  std::lock_guard lock(watcher.mu);
+  if (!watcher.thread.joinable()) return;
+  ::sigaction(SIGHUP, &watcher.old_action, nullptr);
+  watcher.stop = true;
+  char c = 's';
+  [[maybe_unused]] ssize_t r = ::write(watcher.pipe[1], &c, 1);
+  watcher.thread.join();
+  sighup_fd = -1;
+  ::close(watcher.pipe[0]);
+  ::close(watcher.pipe[1]);
+}
+
 }  // namespace dvc
@@ -1,7 +1,13 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <vector>
 
@@ -43,6 +49,10 @@
 // std::vector, then it is a scalar option, and has one argument. Otherwise, `T`
 // is a std::vector, then it is a vector option, and has multiple arguments.
 //
+// If `T` is `dvc::reloadable<U>`, then it is a scalar option of type `U`
+// that can also be changed while the program runs; see reloadable below.
+// Read it with `*name`.
+//
 
 #define DVC_OPTION(name, letter, default_value, description)
 #undef DVC_OPTION
@@ -56,11 +66,105 @@ namespace dvc {
 extern std::string program_name;
 extern std::vector<std::string> args;
 
+// Sets options from, in increasing precedence:
+//
+// - the file named by --options_file, of "name = value" lines, where
+//   consecutive lines for a vector option give its values and bools take
+//   true or false.  The parse is cached in a binary file beside it, reused
+//   while the file's mtime, inode and size are unchanged, unless it was
+//   modified in the last two seconds.
+//
+// - environment variables DVC_<NAME>, with NAME the option's name in upper
+//   case.  Vector values are separated by whitespace.
+//
+// - argv, in which an argument @file before any -- is replaced by the lines
+//   of file, read in place from a mapping.
+//
+// Each source may set an option once; a later source overrides it, and
+// replaces a vector's values.
 void init_options(int argc, char** argv);
 
+// Sets a reloadable option from a string, as on the command line.  Returns
+// false, leaving the option unchanged, if it is unknown or not reloadable,
+// or the value doesn't parse or validate, and then sets *error if given.
+bool set_reloadable_option(std::string_view name, std::string_view value,
+                           std::string* error = nullptr);
+
+// Re-reads --options_file, and sets each reloadable option not set from the
+// environment or command line to its value there, or its default if it is
+// absent.  The file is applied whole or not at all: if it has a malformed
+// line or an unknown option, or any value doesn't parse or validate, every
+// option keeps its value, and the errors are returned in *error, one per
+// line.
+bool reload_options(std::string* error = nullptr);
+
+// Starts a thread that calls reload_options() on SIGHUP, and when
+// --options_file's mtime, inode or size changes, checked every
+// poll_interval.  While the file was modified in the last two seconds, a
+// change could leave all three the same, so it is reloaded at every poll.
+// Errors are logged.
+void watch_options(std::chrono::milliseconds poll_interval =
+                       std::chrono::seconds(1));
+void stop_watching_options();
+
 constexpr struct required_t {
 } required;
 
+// The value of a reloadable option: an immutable snapshot, replaced by
+// publishing a new one, so reading costs one atomic load and never blocks.
+// Old snapshots are kept until exit, since a reader may still hold a
+// reference, so each change costs the size of a T.
+template <typename T>
+class reloadable {
+ public:
+  reloadable() = default;
+  reloadable(const reloadable&) = delete;
+  reloadable& operator=(const reloadable&) = delete;
+
+  const T& get() const { return *current_.load(std::memory_order_acquire); }
+  const T& operator*() const { return get(); }
+  const T* operator->() const { return &get(); }
+
+  // Values for which validate returns false are rejected.
+  void set_validator(std::function<bool(const T&)> validate) {
+    std::lock_guard lock(mu_);
+    validate_ = std::move(validate);
+  }
+
+  // Calls f with each new value, on the thread that set it, after it is
+  // published.  f must not set this option.
+  void on_change(std::function<void(const T&)> f) {
+    std::lock_guard lock(mu_);
+    callbacks_.push_back(std::move(f));
+  }
+
+  // Whether set(value) would accept value.
+  bool valid(const T& value) {
+    std::lock_guard lock(mu_);
+    return !validate_ || validate_(value);
+  }
+
+  // Publishes value, unless it is rejected by the validator.  Returns
+  // whether it was accepted.
+  bool set(T value) {
+    std::lock_guard lock(mu_);
+    if (validate_ && !validate_(value)) return false;
+    const T* current = current_.load(std::memory_order_relaxed);
+    if (current && *current == value) return true;
+    versions_.push_back(std::make_unique<const T>(std::move(value)));
+    current_.store(versions_.back().get(), std::memory_order_release);
+    for (const auto& f : callbacks_) f(*versions_.back());
+    return true;
+  }
+
+ private:
+  std::atomic<const T*> current_{nullptr};
+  std::mutex mu_;
+  std::vector<std::unique_ptr<const T>> versions_;
+  std::function<bool(const T&)> validate_;
+  std::vector<std::function<void(const T&)>> callbacks_;
+};
+
 struct option;
 void register_option(option*);
 
@@ -73,6 +177,7 @@ struct option {
   std::string file;
   int line;
   bool set = false;
+  bool pinned = false;  // set from the environment or command line
 
   option(const std::string& name, const std::string& letter,
          const std::string& description, const std::string& file, int line)
@@ -82,11 +187,28 @@ struct option {
         file(file),
         line(line) {}
 
-  virtual void set_value(const std::string&) = 0;
-  virtual void add_value(const std::string&) = 0;
+  virtual void set_value(std::string_view) = 0;
+  virtual void add_value(std::string_view) = 0;
+  // Called before n calls of add_value.
+  virtual void reserve_values(size_t /* n */) {}
   virtual bool is_bool() const { return false; }
   virtual bool is_vector() const { return false; }
   virtual bool is_scalar() const { return false; }
+  virtual bool is_reloadable() const { return false; }
+
+  // For reloadable options: sets the value from a string, or to the
+  // default if there is none.  Returns false and sets error if the value is
+  // rejected.
+  virtual bool reload(std::optional<std::string_view> /* value */,
+                      std::string& /* error */) {
+    DVC_FATAL("unexpected reload on option: ", name);
+  }
+
+  // Like reload, without changing the value.
+  virtual bool check_reload(std::optional<std::string_view> /* value */,
+                            std::string& /* error */) {
+    DVC_FATAL("unexpected check_reload on option: ", name);
+  }
 
   virtual std::string to_string() const = 0;
 
@@ -120,6 +242,7 @@ struct option {
     }
     o << std::endl;
     o << "    " << description;
+    if (is_reloadable()) o << " (reloadable)";
     if (is_bool()) {
       o << std::endl;
     } else if (required)
@@ -161,15 +284,17 @@ struct typed_option<bool> : option {
     DVC_FATAL("bool options cannot be required: ", name);
   }
 
-  void set_value(const std::string& string) override {
-    if (string != "1")
-      DVC_FATAL("set_value of not '1' called for bool option: ", name);
+  // "1" sets the option and "0", from an options file or the environment,
+  // clears one set by an earlier source.
+  void set_value(std::string_view string) override {
+    if (string != "1" && string != "0")
+      DVC_FATAL("set_value of not '1' or '0' called for bool option: ", name);
     if (set) DVC_FAIL("option ", name, " passed multiple times");
     set = true;
-    ref = true;
+    ref = string == "1";
   }
 
-  void add_value(const std::string&) override {
+  void add_value(std::string_view) override {
     DVC_FATAL("unexpected add_value on scalar option: ", name);
   }
 
@@ -209,7 +334,7 @@ struct typed_option : option {
     register_option(this);
   }
 
-  void set_value(const std::string& string) override {
+  void set_value(std::string_view string) override {
     if (set) DVC_FAIL("option ", name, " passed multiple times");
 
     set = true;
@@ -218,7 +343,7 @@ struct typed_option : option {
                typeid(type).name(), "' with input '", string, "'.");
   }
 
-  void add_value(const std::string&) override {
+  void add_value(std::string_view) override {
     DVC_FATAL("unexpected add_value on scalar option: ", name);
   }
 
@@ -259,11 +384,19 @@ struct typed_option<std::vector<E>> : option {
     register_option(this);
   }
 
-  void set_value(const std::string& string) override {
+  void set_value(std::string_view string) override {
     DVC_FATAL("unexpected set_value on vector option: ", name, " = ", string);
   }
 
-  void add_value(const std::string& string) override {
+  void reserve_values(size_t n) override {
+    if (!set) {
+      ref.clear();
+      set = true;
+    }
+    ref.reserve(ref.size() + n);
+  }
+
+  void add_value(std::string_view string) override {
     if (!set) {
       ref.clear();
       set = true;
@@ -273,7 +406,7 @@ struct typed_option<std::vector<E>> : option {
       DVC_FAIL("Unable to parse option '", name, "' of type '",
                typeid(E).name(), "' with input '", string, "'.");
 
-    ref.push_back(e);
+    ref.push_back(std::move(e));
   }
 
   std::string to_string() const override {
@@ -291,4 +424,84 @@ struct typed_option<std::vector<E>> : option {
   }
 };
 
+// RELOADABLE
+template <typename T>
+struct typed_option<reloadable<T>> : option {
+  bool is_scalar() const override { return true; }
+  bool is_reloadable() const override { return true; }
+
+  using type = reloadable<T>;
+  type& ref;
+  T default_value;
+
+  typed_option(type& ref, const std::string& name, const std::string& letter,
+               dvc::required_t, const std::string& description,
+               const std::string& file, int line)
+      : option(name, letter, description, file, line), ref(ref) {
+    DVC_FATAL("reloadable options cannot be required: ", name);
+  }
+
+  typed_option(type& ref, const std::string& name, const std::string& letter,
+               T default_value, const std::string& description,
+               const std::string& file, int line)
+      : option(name, letter, description, file, line),
+        ref(ref),
+        default_value(default_value) {
+    ref.set(default_value);
+    required = false;
+    register_option(this);
+  }
+
+  void set_value(std::string_view string) override {
+    if (set) DVC_FAIL("option ", name, " passed multiple times");
+    set = true;
+    std::string error;
+    if (!reload(string, error)) DVC_FAIL(error);
+  }
+
+  void add_value(std::string_view) override {
+    DVC_FATAL("unexpected add_value on scalar option: ", name);
+  }
+
+  bool reload(std::optional<std::string_view> value,
+              std::string& error) override {
+    T t = default_value;
+    if (!parse(value, t, error)) return false;
+    if (!ref.set(std::move(t))) return invalid(value, error);
+    return true;
+  }
+
+  bool check_reload(std::optional<std::string_view> value,
+                    std::string& error) override {
+    T t = default_value;
+    if (!parse(value, t, error)) return false;
+    if (!ref.valid(t)) return invalid(value, error);
+    return true;
+  }
+
+  std::string to_string() const override {
+    return dvc::concat("[option ", name, " of type ", typeid(ref).name(),
+                       " defined at ", file, ":", line, "]");
+  }
+
+  void write_help_args(std::ostream& o) const override { o << "<arg>"; };
+  void write_default(std::ostream& o) const override { o << default_value; };
+
+ private:
+  bool parse(std::optional<std::string_view> value, T& t,
+             std::string& error) const {
+    if (!value || dvc::destring(*value, t)) return true;
+    error = dvc::concat("Unable to parse option '", name, "' of type '",
+                        typeid(T).name(), "' with input '", *value, "'.");
+    return false;
+  }
+
+  bool invalid(std::optional<std::string_view> value,
+               std::string& error) const {
+    error = dvc::concat("Invalid value for option '", name, "': '",
+                        value ? *value : "<default>", "'.");
+    return false;
+  }
+};
+
 }  // namespace dvc
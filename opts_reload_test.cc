@@ -0,0 +1,175 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+dvc::reloadable<int> DVC_OPTION(batch_size, -, 32, "items per batch");
+dvc::reloadable<std::string> DVC_OPTION(level, -, "info", "log level");
+dvc::reloadable<double> DVC_OPTION(ratio, -, 0.5, "sampling ratio");
+dvc::reloadable<int> DVC_OPTION(pinned, -, 1, "set on the command line");
+int DVC_OPTION(fixed, -, 7, "not reloadable");
+
+// Waits up to a few seconds for f() to be true.
+template <typename F>
+bool eventually(F f) {
+  for (int i = 0; i < 5000; i++) {
+    if (f()) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return false;
+}
+
+void test_startup() {
+  DVC_ASSERT_EQ(*batch_size, 64);
+  DVC_ASSERT_EQ(*level, "debug");
+  DVC_ASSERT_EQ(*ratio, 0.5);
+  DVC_ASSERT_EQ(*pinned, 5);
+  DVC_ASSERT_EQ(fixed, 8);
+  DVC_ASSERT(DVC_OPTION_batch_size.help_string().find("items per batch "
+                                                      "(reloadable)") !=
+             std::string::npos);
+  DVC_ASSERT(DVC_OPTION_fixed.help_string().find("(reloadable)") ==
+             std::string::npos);
+}
+
+std::vector<int> changes;
+
+void test_set() {
+  batch_size.set_validator([](int n) { return n > 0; });
+  batch_size.on_change([](int n) { changes.push_back(n); });
+
+  const int& before = *batch_size;
+  DVC_ASSERT(dvc::set_reloadable_option("batch_size", "128"));
+  DVC_ASSERT_EQ(*batch_size, 128);
+  DVC_ASSERT_EQ(before, 64);  // old snapshots stay readable
+
+  std::string error;
+  DVC_ASSERT(!dvc::set_reloadable_option("batch_size", "-1", &error));
+  DVC_ASSERT(error.find("Invalid value") != std::string::npos, error);
+  DVC_ASSERT(!dvc::set_reloadable_option("batch_size", "x", &error));
+  DVC_ASSERT(!dvc::set_reloadable_option("fixed", "1", &error));
+  DVC_ASSERT(error.find("not reloadable") != std::string::npos, error);
+  DVC_ASSERT(!dvc::set_reloadable_option("missing", "1", &error));
+  DVC_ASSERT_EQ(*batch_size, 128);
+
+  // Setting the same value again is not a change.
+  DVC_ASSERT(dvc::set_reloadable_option("batch_size", "128"));
+  DVC_ASSERT(changes == std::vector<int>{128});
+}
+
+void test_reload(const std::filesystem::path& options_file) {
+  dvc::save_file(options_file,
+                 "batch_size = 256\n"
+                 "pinned = 10\n"
+                 "fixed = 9\n"
+                 "not an assignment\n");
+  std::string error;
+  // A malformed file changes nothing.
+  DVC_ASSERT(!dvc::reload_options(&error));
+  DVC_ASSERT(error.find("expected name = value") != std::string::npos, error);
+  DVC_ASSERT_EQ(*batch_size, 128);
+  DVC_ASSERT_EQ(*level, "debug");
+  DVC_ASSERT_EQ(*ratio, 0.5);
+
+  // Nor does one with a value rejected by its validator.
+  dvc::save_file(options_file, "batch_size = 0\nratio = 0.25\n");
+  DVC_ASSERT(!dvc::reload_options(&error));
+  DVC_ASSERT(error.find("Invalid value") != std::string::npos, error);
+  DVC_ASSERT_EQ(*batch_size, 128);
+  DVC_ASSERT_EQ(*ratio, 0.5);
+
+  dvc::save_file(options_file,
+                 "batch_size = 256\n"
+                 "ratio = 0.25\n"
+                 "pinned = 10\n"
+                 "fixed = 9\n");
+  DVC_ASSERT(dvc::reload_options(&error), error);
+  DVC_ASSERT_EQ(*batch_size, 256);
+  DVC_ASSERT_EQ(*level, "info");  // back to its default
+  DVC_ASSERT_EQ(*ratio, 0.25);
+  DVC_ASSERT_EQ(*pinned, 5);  // the command line wins
+  DVC_ASSERT_EQ(fixed, 8);
+}
+
+void test_watch(const std::filesystem::path& options_file) {
+  dvc::watch_options(std::chrono::milliseconds(10));
+  dvc::save_file(options_file, "batch_size = 512\n");
+  DVC_ASSERT(eventually([] { return *batch_size == 512; }));
+
+  // An edit in the same mtime tick that keeps the size is still seen.
+  struct stat st;
+  DVC_ASSERT_EQ(::stat(options_file.c_str(), &st), 0);
+  dvc::save_file(options_file, "batch_size = 513\n");
+  timespec times[2] = {st.st_atim, st.st_mtim};
+  DVC_ASSERT_EQ(::utimensat(AT_FDCWD, options_file.c_str(), times, 0), 0);
+  DVC_ASSERT(eventually([] { return *batch_size == 513; }));
+
+  DVC_ASSERT(dvc::set_reloadable_option("batch_size", "1"));
+  ::raise(SIGHUP);
+  DVC_ASSERT(eventually([] { return *batch_size == 513; }));
+  dvc::stop_watching_options();
+}
+
+void test_concurrency() {
+  std::atomic<bool> stop{false};
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 3; i++) {
+    readers.emplace_back([&] {
+      while (!stop.load()) DVC_ASSERT_GT(*batch_size, 0);
+    });
+  }
+  for (int i = 1; i <= 1000; i++)
+    DVC_ASSERT(dvc::set_reloadable_option("batch_size", std::to_string(i)));
+  stop = true;
+  for (auto& reader : readers) reader.join();
+}
+
+void benchmark() {
+  constexpr size_t n = 100'000'000;
+  size_t start = dvc::now();
+  int64_t sum = 0;
+  for (size_t i = 0; i < n; i++) sum += *batch_size;
+  size_t end = dvc::now();
+  DVC_LOG("reloadable read: ", double(end - start) / n, "ns (sum ", sum, ")");
+}
+
+int main(int argc, char** argv) {
+  std::filesystem::path options_file =
+      std::filesystem::temp_directory_path() /
+      dvc::concat("opts_reload_test.", ::getpid());
+  dvc::save_file(options_file,
+                 "# startup values\n"
+                 "batch_size = 64\n"
+                 "level = debug\n"
+                 "pinned = 9\n"
+                 "fixed = 8\n");
+  std::string options_file_arg = "--options_file=" + options_file.native();
+  std::string pinned_arg = "--pinned=5";
+  std::vector<char*> args = {argv[0], options_file_arg.data(),
+                             pinned_arg.data()};
+  args.insert(args.end(), argv + 1, argv + argc);
+  args.push_back(nullptr);
+  int args_count = args.size() - 1;
+  char** args_data = args.data();
+  dvc::program program(args_count, args_data);
+
+  test_startup();
+  test_set();
+  test_reload(options_file);
+  test_watch(options_file);
+  test_concurrency();
+  benchmark();
+  std::filesystem::remove(options_file);
+  std::filesystem::remove(options_file.native() + ".cache");
+}
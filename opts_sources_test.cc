@@ -0,0 +1,244 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+
+int DVC_OPTION(count, c, 1, "a scalar");
+bool DVC_OPTION(verbose, v, false, "a bool");
+std::string DVC_OPTION(label, l, "", "a string");
+std::vector<std::string> DVC_OPTION(names, n, {"default"}, "a vector");
+
+using environment = std::vector<std::pair<std::string, std::string>>;
+
+// Calls init_options with args and env in a child process, since it can be
+// called only once, and then check().  Returns the child's exit status, or
+// -1 if it was killed, as by a failed assertion in check.
+template <typename Check>
+int run(std::vector<std::string> args, const environment& env, Check check) {
+  std::cout.flush();
+  std::cerr.flush();
+  pid_t pid = ::fork();
+  DVC_ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    for (const auto& [name, value] : env)
+      ::setenv(name.c_str(), value.c_str(), 1);
+    args.insert(args.begin(), "opts_sources_test");
+    std::vector<char*> argv;
+    for (auto& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+    dvc::init_options(args.size(), argv.data());
+    check();
+    std::cout.flush();
+    ::_exit(0);
+  }
+  int status;
+  DVC_ASSERT_EQ(::waitpid(pid, &status, 0), pid);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int run(std::vector<std::string> args, const environment& env = {}) {
+  return run(std::move(args), env, [] {});
+}
+
+// Sets the mtime of path to a fixed time long ago, so that it is not
+// recently modified.
+void set_mtime(const std::filesystem::path& path, time_t seconds) {
+  timespec times[2] = {{seconds, 0}, {seconds, 0}};
+  DVC_ASSERT_EQ(::utimensat(AT_FDCWD, path.c_str(), times, 0), 0);
+}
+
+void test_response_files(const std::filesystem::path& dir) {
+  dvc::save_file(dir / "a.rsp", "--count\r\n\r\n5\r\n@" +
+                                    (dir / "b.rsp").native() + "\n\n");
+  dvc::save_file(dir / "b.rsp", "-v\n--names\nx\ny");
+  std::string a = "@" + (dir / "a.rsp").native();
+  DVC_ASSERT_EQ(run({"pos", a}, {}, [] {
+                  DVC_ASSERT_EQ(count, 5);
+                  DVC_ASSERT(verbose);
+                  DVC_ASSERT((names == std::vector<std::string>{"x", "y"}));
+                  DVC_ASSERT((dvc::args == std::vector<std::string>{"pos"}));
+                }),
+                0);
+
+  // After --, @file is an argument.
+  DVC_ASSERT_EQ(run({"--", a}, {}, [&] {
+                  DVC_ASSERT_EQ(count, 1);
+                  DVC_ASSERT((dvc::args == std::vector<std::string>{a}));
+                }),
+                0);
+
+  // A file that names itself is expanded until the depth limit.
+  std::filesystem::path loop = dir / "loop.rsp";
+  dvc::save_file(loop, "@" + loop.native() + "\n");
+  DVC_ASSERT_EQ(run({"@" + loop.native()}), EXIT_FAILURE);
+
+  // A missing file fails, rather than aborting.
+  DVC_ASSERT_EQ(run({"@" + (dir / "missing.rsp").native()}), EXIT_FAILURE);
+}
+
+void test_environment() {
+  DVC_ASSERT_EQ(run({},
+                    {{"DVC_COUNT", "7"},
+                     {"DVC_VERBOSE", "true"},
+                     {"DVC_LABEL", "two words"},
+                     {"DVC_NAMES", "  a b\tc\n"}},
+                    [] {
+                      DVC_ASSERT_EQ(count, 7);
+                      DVC_ASSERT(verbose);
+                      DVC_ASSERT_EQ(label, "two words");
+                      DVC_ASSERT((names ==
+                                  std::vector<std::string>{"a", "b", "c"}));
+                    }),
+                0);
+  DVC_ASSERT_EQ(run({}, {{"DVC_VERBOSE", "1"}}, [] { DVC_ASSERT(verbose); }),
+                0);
+  DVC_ASSERT_EQ(run({}, {{"DVC_VERBOSE", "yes"}}), EXIT_FAILURE);
+  DVC_ASSERT_EQ(run({}, {{"DVC_COUNT", "x"}}), EXIT_FAILURE);
+}
+
+void test_options_file(const std::filesystem::path& dir) {
+  std::filesystem::path file = dir / "options";
+  std::string arg = "--options_file=" + file.native();
+  dvc::save_file(file,
+                 "# a comment\n"
+                 "count = 3\n"
+                 "\n"
+                 "  label =  x y  \n"
+                 "names = p\n"
+                 "names = q\n"
+                 "verbose = true\n");
+  DVC_ASSERT_EQ(run({arg}, {}, [] {
+                  DVC_ASSERT_EQ(count, 3);
+                  DVC_ASSERT_EQ(label, "x y");
+                  DVC_ASSERT((names == std::vector<std::string>{"p", "q"}));
+                  DVC_ASSERT(verbose);
+                }),
+                0);
+
+  dvc::save_file(file, "count\n");
+  DVC_ASSERT_EQ(run({arg}), EXIT_FAILURE);
+  dvc::save_file(file, "missing = 1\n");
+  DVC_ASSERT_EQ(run({arg}), EXIT_FAILURE);
+  DVC_ASSERT_EQ(run({"--options_file=" + (dir / "missing").native()}),
+                EXIT_FAILURE);
+}
+
+void test_precedence(const std::filesystem::path& dir) {
+  std::filesystem::path file = dir / "precedence";
+  std::string arg = "--options_file=" + file.native();
+  dvc::save_file(file,
+                 "count = 1\n"
+                 "verbose = true\n"
+                 "label = file\n"
+                 "names = p\n"
+                 "names = q\n");
+  DVC_ASSERT_EQ(run({arg, "--label=argv"},
+                    {{"DVC_COUNT", "2"},
+                     {"DVC_VERBOSE", "false"},
+                     {"DVC_LABEL", "env"},
+                     {"DVC_NAMES", "e"}},
+                    [] {
+                      DVC_ASSERT_EQ(count, 2);
+                      DVC_ASSERT(!verbose);
+                      DVC_ASSERT_EQ(label, "argv");
+                      DVC_ASSERT((names == std::vector<std::string>{"e"}));
+                    }),
+                0);
+  DVC_ASSERT_EQ(run({arg, "-c", "3", "-n", "x"}, {{"DVC_COUNT", "2"}}, [] {
+                  DVC_ASSERT_EQ(count, 3);
+                  DVC_ASSERT(verbose);
+                  DVC_ASSERT((names == std::vector<std::string>{"x"}));
+                }),
+                0);
+  // The options file can be named in the environment.
+  DVC_ASSERT_EQ(run({}, {{"DVC_OPTIONS_FILE", file.native()}},
+                    [] { DVC_ASSERT_EQ(label, "file"); }),
+                0);
+
+  // Each source may set a scalar once.
+  DVC_ASSERT_EQ(run({"-c", "3", "-c", "4"}), EXIT_FAILURE);
+  dvc::save_file(file, "count = 1\ncount = 2\n");
+  DVC_ASSERT_EQ(run({arg}), EXIT_FAILURE);
+  dvc::save_file(file, "verbose = true\nverbose = false\n");
+  DVC_ASSERT_EQ(run({arg}), EXIT_FAILURE);
+  // A vector's values must be on consecutive lines.
+  dvc::save_file(file, "names = p\ncount = 1\nnames = q\n");
+  DVC_ASSERT_EQ(run({arg}), EXIT_FAILURE);
+}
+
+// Replaces the value cached for count, to tell whether the cache is read.
+void edit_cache(const std::filesystem::path& cache, char from, char to) {
+  std::string data = dvc::load_file(cache);
+  size_t i = data.find(std::string("count") + from);
+  DVC_ASSERT_NE(i, std::string::npos);
+  data[i + 5] = to;
+  dvc::save_file(cache, data);
+}
+
+void test_cache(const std::filesystem::path& dir) {
+  std::filesystem::path file = dir / "cached";
+  std::filesystem::path cache = file.native() + ".cache";
+  std::string arg = "--options_file=" + file.native();
+  auto expect_count = [&](int n) {
+    DVC_ASSERT_EQ(run({arg}, {}, [n] { DVC_ASSERT_EQ(count, n); }), 0);
+  };
+
+  dvc::save_file(file, "count = 5\n");
+  set_mtime(file, 1'000'000'000);
+  expect_count(5);
+  DVC_ASSERT(std::filesystem::exists(cache));
+
+  // An unchanged file is read from its cache.
+  edit_cache(cache, '5', '6');
+  expect_count(6);
+
+  // A new mtime.
+  set_mtime(file, 1'000'000'001);
+  expect_count(5);
+
+  // A new inode, with the same mtime and size.
+  edit_cache(cache, '5', '6');
+  std::filesystem::path copy = dir / "copy";
+  std::filesystem::copy_file(file, copy);
+  std::filesystem::rename(copy, file);
+  set_mtime(file, 1'000'000'001);
+  expect_count(5);
+
+  // A new size, with the same mtime and inode.
+  edit_cache(cache, '5', '6');
+  dvc::save_file(file, "count =  5\n");
+  set_mtime(file, 1'000'000'001);
+  expect_count(5);
+
+  // A file modified just now is not cached, since another write in the same
+  // mtime tick could go unseen.
+  std::filesystem::remove(cache);
+  dvc::save_file(file, "count = 7\n");
+  expect_count(7);
+  DVC_ASSERT(!std::filesystem::exists(cache));
+}
+
+int main() {
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              dvc::concat("opts_sources_test.", ::getpid());
+  std::filesystem::create_directories(dir);
+
+  test_response_files(dir);
+  test_environment();
+  test_options_file(dir);
+  test_precedence(dir);
+  test_cache(dir);
+
+  std::filesystem::remove_all(dir);
+}
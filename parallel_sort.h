@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "dvc/thread_pool.h"
+
+namespace dvc {
+
+namespace parallel_sort_detail {
+
+// The number of parts to split size elements into on pool, so that each
+// is big enough to be worth a task.
+inline size_t parts(thread_pool& pool, size_t size) {
+  return std::max<size_t>(1, std::min(pool.size(), size / 4096));
+}
+
+// The start of the i'th of n nearly equal parts of [0, size).
+inline size_t part_begin(size_t size, size_t n, size_t i) {
+  return size / n * i + std::min(i, size % n);
+}
+
+}  // namespace parallel_sort_detail
+
+// Sorts [first, last) on pool: one task per thread sorts a part, and then
+// pairs of sorted runs are merged in parallel until one is left.  Merges go
+// through a buffer of the same size.
+template <typename RandomIt, typename Compare = std::less<>>
+void parallel_sort(RandomIt first, RandomIt last,
+                   thread_pool& pool = default_pool(),
+                   Compare compare = Compare()) {
+  using T = typename std::iterator_traits<RandomIt>::value_type;
+  size_t size = last - first;
+  size_t threads = parallel_sort_detail::parts(pool, size);
+  if (threads == 1) {
+    std::sort(first, last, compare);
+    return;
+  }
+
+  // runs[i] is the start of the i'th sorted run, with runs.back() == size.
+  std::vector<size_t> runs;
+  for (size_t i = 0; i <= threads; i++)
+    runs.push_back(parallel_sort_detail::part_begin(size, threads, i));
+  pool.parallel_for(
+      0, threads,
+      [&](size_t i) {
+        std::sort(first + runs[i], first + runs[i + 1], compare);
+      },
+      1);
+
+  std::vector<T> buffer(size);
+  bool in_buffer = false;  // whether the runs are in buffer
+  while (runs.size() > 2) {
+    size_t merges = (runs.size() - 1) / 2;
+    auto merge = [&](auto from, auto to) {
+      pool.parallel_for(
+          0, merges,
+          [&](size_t i) {
+            size_t a = runs[2 * i], b = runs[2 * i + 1], c = runs[2 * i + 2];
+            std::merge(std::make_move_iterator(from + a),
+                       std::make_move_iterator(from + b),
+                       std::make_move_iterator(from + b),
+                       std::make_move_iterator(from + c), to + a, compare);
+          },
+          1);
+      // An odd run out is moved across unmerged.
+      if ((runs.size() - 1) % 2)
+        std::move(from + runs[runs.size() - 2], from + runs.back(),
+                  to + runs[runs.size() - 2]);
+    };
+    if (in_buffer)
+      merge(buffer.begin(), first);
+    else
+      merge(first, buffer.begin());
+    in_buffer = !in_buffer;
+    std::vector<size_t> merged;
+    for (size_t i = 0; i < runs.size(); i += 2) merged.push_back(runs[i]);
+    if (merged.back() != size) merged.push_back(size);
+    runs = std::move(merged);
+  }
+  if (in_buffer) std::move(buffer.begin(), buffer.end(), first);
+}
+
+template <typename Container, typename Compare = std::less<>>
+void parallel_sort(Container& container, thread_pool& pool = default_pool(),
+                   Compare compare = Compare()) {
+  parallel_sort(container.begin(), container.end(), pool, compare);
+}
+
+// Sorts a vector and removes duplicates, with the deduplication also split
+// across pool.
+template <typename T>
+void parallel_sort_unique(std::vector<T>& v,
+                          thread_pool& pool = default_pool()) {
+  parallel_sort(v, pool);
+  size_t threads = parallel_sort_detail::parts(pool, v.size());
+  if (threads == 1) {
+    v.erase(std::unique(v.begin(), v.end()), v.end());
+    return;
+  }
+  std::vector<char> keep(v.size());
+  std::vector<size_t> kept(threads + 1);
+  pool.parallel_for(
+      0, threads,
+      [&](size_t t) {
+        size_t end = parallel_sort_detail::part_begin(v.size(), threads, t + 1);
+        for (size_t i = parallel_sort_detail::part_begin(v.size(), threads, t);
+             i < end; i++) {
+          keep[i] = i == 0 || !(v[i - 1] == v[i]);
+          kept[t + 1] += keep[i];
+        }
+      },
+      1);
+  for (size_t t = 0; t < threads; t++) kept[t + 1] += kept[t];
+  std::vector<T> result(kept.back());
+  pool.parallel_for(
+      0, threads,
+      [&](size_t t) {
+        size_t out = kept[t];
+        size_t end = parallel_sort_detail::part_begin(v.size(), threads, t + 1);
+        for (size_t i = parallel_sort_detail::part_begin(v.size(), threads, t);
+             i < end; i++)
+          if (keep[i]) result[out++] = std::move(v[i]);
+      },
+      1);
+  v = std::move(result);
+}
+
+// Sorts fixed-width byte strings, such as digests, into the same order as
+// std::sort.  An LSD radix sort orders them by their first min(N, 8) bytes,
+// skipping passes over bytes that are the same in every key, and then any
+// runs with equal prefixes are finished with std::sort, which for digests is
+// a single scan.
+template <size_t N>
+void radix_sort(std::vector<std::array<std::byte, N>>& keys) {
+  using key = std::array<std::byte, N>;
+  constexpr size_t prefix = std::min<size_t>(N, 8);
+  if (keys.size() < 2) return;
+
+  // Counts for every prefix byte, in one pass.
+  std::vector<std::array<size_t, 256>> counts(prefix);
+  for (auto& c : counts) c.fill(0);
+  for (const key& k : keys)
+    for (size_t b = 0; b < prefix; b++) counts[b][uint8_t(k[b])]++;
+
+  std::vector<key> buffer(keys.size());
+  for (size_t b = prefix; b-- > 0;) {
+    std::array<size_t, 256>& c = counts[b];
+    if (c[uint8_t(keys[0][b])] == keys.size()) continue;
+    size_t offset = 0;
+    for (size_t& count : c) {
+      size_t n = count;
+      count = offset;
+      offset += n;
+    }
+    for (const key& k : keys) buffer[c[uint8_t(k[b])]++] = k;
+    keys.swap(buffer);
+  }
+
+  if constexpr (N > prefix) {
+    auto same_prefix = [](const key& a, const key& b) {
+      return std::memcmp(a.data(), b.data(), prefix) == 0;
+    };
+    for (size_t i = 0; i + 1 < keys.size();) {
+      size_t j = i + 1;
+      while (j < keys.size() && same_prefix(keys[i], keys[j])) j++;
+      if (j - i > 1) std::sort(keys.begin() + i, keys.begin() + j);
+      i = j;
+    }
+  }
+}
+
+}  // namespace dvc
@@ -0,0 +1,99 @@
+#include "dvc/parallel_sort.h"
+
+#include <random>
+#include <thread>
+
+#include "dvc/container.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(sort_size, -, 4000000, "number of keys to sort");
+
+void test_parallel_sort() {
+  std::mt19937_64 ran;
+  for (size_t size : {0, 1, 1000, 50000, 123457}) {
+    for (size_t threads : {1, 2, 3, 7}) {
+      dvc::thread_pool pool(threads);
+      std::vector<uint32_t> v(size);
+      for (auto& x : v) x = ran() % 1000;
+      std::vector<uint32_t> expected = v;
+      std::sort(expected.begin(), expected.end());
+      std::vector<uint32_t> unique = v;
+      dvc::parallel_sort(v, pool);
+      DVC_ASSERT(v == expected);
+      dvc::parallel_sort_unique(unique, pool);
+      dvc::sort_unique(expected);
+      DVC_ASSERT(unique == expected);
+    }
+  }
+  std::vector<int> descending = {1, 5, 3};
+  dvc::parallel_sort(descending, dvc::default_pool(), std::greater<>());
+  DVC_ASSERT((descending == std::vector<int>{5, 3, 1}));
+}
+
+template <size_t N>
+std::vector<std::array<std::byte, N>> random_keys(size_t n, size_t common) {
+  std::mt19937_64 ran;
+  std::vector<std::array<std::byte, N>> keys(n);
+  for (auto& key : keys)
+    for (size_t i = 0; i < N; i++) key[i] = std::byte(i < common ? 0 : ran());
+  return keys;
+}
+
+template <size_t N>
+void test_radix_sort() {
+  // Shared leading bytes exercise pass skipping and the prefix fix-up.
+  for (size_t common : {size_t(0), size_t(3), N}) {
+    auto keys = random_keys<N>(20000, common);
+    keys.resize(30000, keys[0]);
+    auto expected = keys;
+    std::sort(expected.begin(), expected.end());
+    dvc::radix_sort(keys);
+    DVC_ASSERT(keys == expected, N, " ", common);
+  }
+}
+
+template <size_t N>
+void benchmark_key_width() {
+  auto keys = random_keys<N>(sort_size, 0);
+  auto copy = keys;
+  size_t t0 = dvc::now();
+  std::sort(copy.begin(), copy.end());
+  size_t t1 = dvc::now();
+  dvc::radix_sort(keys);
+  size_t t2 = dvc::now();
+  DVC_ASSERT(keys == copy);
+  DVC_LOG(N, "-byte keys: std::sort ", double(t1 - t0) / keys.size(),
+          "ns/key, radix_sort ", double(t2 - t1) / keys.size(), "ns/key");
+}
+
+void benchmark_threads() {
+  std::mt19937_64 ran;
+  std::vector<uint64_t> keys(sort_size);
+  for (auto& key : keys) key = ran();
+  for (size_t threads = 1;
+       threads <= 2 * std::max(1u, std::thread::hardware_concurrency());
+       threads *= 2) {
+    dvc::thread_pool pool(threads);
+    auto copy = keys;
+    size_t start = dvc::now();
+    dvc::parallel_sort(copy, pool);
+    size_t end = dvc::now();
+    DVC_LOG("parallel_sort threads=", threads, ": ",
+            double(end - start) / keys.size(), "ns/key");
+  }
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_parallel_sort();
+  test_radix_sort<4>();
+  test_radix_sort<32>();
+  benchmark_threads();
+  benchmark_key_width<8>();
+  benchmark_key_width<16>();
+  benchmark_key_width<32>();
+}
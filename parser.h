@@ -1,6 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "dvc/log.h"
@@ -35,4 +42,170 @@ class parser {
   size_t pos_ = 0;
 };
 
+// A parser front end with the same peek(offset)/pop()/pos() interface as
+// parser, that pulls tokens on demand from a lexer instead of requiring them
+// all up front.  Lexer is any type with a `Token next()` member that keeps
+// returning an end-of-input token once the input is exhausted.
+//
+// Tokens are held in a ring buffer of capacity tokens, so memory is bounded
+// for any input length.  Positions before pos() are forgotten as the buffer
+// wraps unless pinned by a live checkpoint, which allows backtracking to it
+// with rewind().  Looking further ahead than capacity tokens from the oldest
+// pinned position is a fatal error.  References returned by peek() and pop()
+// are valid until the next call that reads a token from the lexer.
+template <class Token, class Lexer, size_t capacity = 256>
+class stream_parser {
+  static_assert((capacity & (capacity - 1)) == 0, "capacity must be pow2");
+
+ public:
+  stream_parser(const std::string& filename, Lexer lexer)
+      : filename(filename), lexer(std::move(lexer)) {}
+
+  const Token& peek(size_t offset = 0) {
+    size_t target = pos_ + offset;
+    while (filled_ <= target) {
+      if (filled_ - retained_from() >= capacity)
+        DVC_FATAL("lookahead of ", target - retained_from(),
+                  " tokens exceeds capacity ", capacity, " in ", filename);
+      buffer_[filled_ % capacity] = lexer.next();
+      filled_++;
+    }
+    return buffer_[target % capacity];
+  }
+
+  const Token& pop() {
+    const Token& token = peek();
+    incr();
+    return token;
+  }
+
+  size_t pos() const { return pos_; }
+
+  void pos(size_t pos) {
+    DVC_ASSERT_GE(pos, oldest(), "position no longer retained in ", filename);
+    pos_ = pos;
+  }
+
+  void incr(size_t offset = 1) { pos_ += offset; }
+
+  // Pins the current position until destroyed, so that rewind() can return
+  // to it.  Checkpoints must not outlive their parser.
+  class checkpoint {
+   public:
+    explicit checkpoint(stream_parser& parser)
+        : parser_(parser), pos_(parser.pos()) {
+      parser_.pins_.push_back(pos_);
+    }
+
+    ~checkpoint() {
+      auto& pins = parser_.pins_;
+      pins.erase(std::find(pins.begin(), pins.end(), pos_));
+    }
+
+    checkpoint(const checkpoint&) = delete;
+    checkpoint& operator=(const checkpoint&) = delete;
+
+    size_t pos() const { return pos_; }
+
+   private:
+    stream_parser& parser_;
+    size_t pos_;
+  };
+
+  void rewind(const checkpoint& c) { pos(c.pos()); }
+
+ private:
+  // The oldest position still in the buffer.
+  size_t oldest() const { return filled_ < capacity ? 0 : filled_ - capacity; }
+
+  // The oldest position that must stay in the buffer.
+  size_t retained_from() const {
+    size_t from = std::min(pos_, filled_);
+    for (size_t pin : pins_) from = std::min(from, pin);
+    return std::max(from, oldest());
+  }
+
+  std::string filename;
+  Lexer lexer;
+  std::array<Token, capacity> buffer_;
+  size_t pos_ = 0;
+  size_t filled_ = 0;
+  std::vector<size_t> pins_;
+};
+
+// A lexer that runs another lexer on a background thread, so that lexing
+// overlaps with parsing.  Tokens are handed over in batches through a queue of
+// at most max_batches batches.  is_end identifies the end-of-input token,
+// after which the background thread stops and next() keeps returning it.
+template <class Token, class Lexer>
+class threaded_lexer {
+ public:
+  template <typename IsEnd>
+  threaded_lexer(Lexer lexer, IsEnd is_end, size_t batch_size = 1024,
+                 size_t max_batches = 4)
+      : state_(std::make_unique<state>()) {
+    state& s = *state_;
+    s.thread = std::thread([&s, lexer = std::move(lexer), is_end, batch_size,
+                            max_batches]() mutable {
+      for (bool last = false; !last;) {
+        std::vector<Token> tokens;
+        tokens.reserve(batch_size);
+        while (!last && tokens.size() < batch_size) {
+          tokens.push_back(lexer.next());
+          last = is_end(tokens.back());
+        }
+        std::unique_lock lock(s.mu);
+        s.cv.wait(lock,
+                  [&] { return s.stopped || s.batches.size() < max_batches; });
+        if (s.stopped) return;
+        s.batches.push_back({std::move(tokens), last});
+        s.cv.notify_all();
+      }
+    });
+  }
+
+  threaded_lexer(threaded_lexer&&) = default;
+
+  ~threaded_lexer() {
+    if (!state_) return;
+    {
+      std::lock_guard lock(state_->mu);
+      state_->stopped = true;
+    }
+    state_->cv.notify_all();
+    state_->thread.join();
+  }
+
+  Token next() {
+    if (pos_ == current_.tokens.size()) {
+      if (current_.last) return current_.tokens.back();
+      std::unique_lock lock(state_->mu);
+      state_->cv.wait(lock, [&] { return !state_->batches.empty(); });
+      current_ = std::move(state_->batches.front());
+      state_->batches.pop_front();
+      state_->cv.notify_all();
+      pos_ = 0;
+    }
+    return current_.tokens[pos_++];
+  }
+
+ private:
+  struct batch {
+    std::vector<Token> tokens;
+    bool last = false;
+  };
+
+  struct state {
+    std::mutex mu;
+    std::condition_variable cv;
+    std::deque<batch> batches;
+    bool stopped = false;
+    std::thread thread;
+  };
+
+  std::unique_ptr<state> state_;
+  batch current_;
+  size_t pos_ = 0;
+};
+
 }  // namespace dvc
@@ -0,0 +1,170 @@
+#include "dvc/parser.h"
+
+#include <random>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/scanner.h"
+#include "dvc/time.h"
+
+enum class kind { identifier, number, punct, end };
+
+struct token {
+  kind k = kind::end;
+  std::string_view text;
+};
+
+class lexer {
+ public:
+  explicit lexer(std::string_view input) : s("input", input) {}
+
+  token next() {
+    constexpr dvc::char_class digits = dvc::char_class::range('0', '9');
+    s.skip_whitespace();
+    if (s.at_end()) return {kind::end, {}};
+    if (std::string_view id = s.scan_identifier(); !id.empty())
+      return {kind::identifier, id};
+    if (digits.contains(s.peek())) return {kind::number, s.skip_while(digits)};
+    std::string_view rest = s.rest();
+    s.incr();
+    return {kind::punct, rest.substr(0, 1)};
+  }
+
+ private:
+  dvc::scanner_view s;
+};
+
+// Statements are either "name = number;" or "name(number, number);".
+std::string make_input(size_t nstatements) {
+  std::mt19937_64 ran;
+  std::string input;
+  for (size_t i = 0; i < nstatements; i++) {
+    input += "name_" + std::to_string(ran() % 100);
+    if (ran() % 2)
+      input += " = " + std::to_string(ran() % 1000) + ";\n";
+    else
+      input += "(" + std::to_string(ran() % 1000) + ", " +
+               std::to_string(ran() % 1000) + ");\n";
+  }
+  return input;
+}
+
+struct totals {
+  size_t assignments = 0;
+  size_t calls = 0;
+  size_t sum = 0;
+
+  bool operator==(const totals& o) const {
+    return assignments == o.assignments && calls == o.calls && sum == o.sum;
+  }
+};
+
+bool accept(std::string_view text, const token& t) { return t.text == text; }
+
+size_t number(const token& t) {
+  DVC_ASSERT(t.k == kind::number);
+  return std::stoul(std::string(t.text));
+}
+
+// Parses by trying an assignment first and backtracking to try a call.
+template <typename Parser>
+totals parse(Parser& p) {
+  totals result;
+  while (p.peek().k != kind::end) {
+    typename Parser::checkpoint start(p);
+    DVC_ASSERT(p.pop().k == kind::identifier);
+    if (accept("=", p.pop())) {
+      result.sum += number(p.pop());
+      result.assignments++;
+    } else {
+      p.rewind(start);
+      p.incr();
+      DVC_ASSERT(accept("(", p.pop()));
+      result.sum += number(p.pop());
+      DVC_ASSERT(accept(",", p.pop()));
+      result.sum += number(p.pop());
+      DVC_ASSERT(accept(")", p.pop()));
+      result.calls++;
+    }
+    DVC_ASSERT(accept(";", p.pop()));
+  }
+  return result;
+}
+
+// The same over the vector-backed parser, which keeps every token.
+struct vector_parser : dvc::parser<token> {
+  using dvc::parser<token>::parser;
+
+  struct checkpoint {
+    explicit checkpoint(vector_parser& p) : pos(p.pos()) {}
+    size_t pos;
+  };
+
+  void rewind(const checkpoint& c) { pos(c.pos); }
+};
+
+std::vector<token> lex_all(std::string_view input) {
+  lexer l(input);
+  std::vector<token> tokens;
+  do {
+    tokens.push_back(l.next());
+  } while (tokens.back().k != kind::end);
+  // parser::incr requires a token after the last one popped.
+  tokens.push_back(tokens.back());
+  return tokens;
+}
+
+void test_equivalence() {
+  constexpr size_t n = 1000000;
+  std::string input = make_input(n);
+
+  size_t start = dvc::now();
+  vector_parser vp("input", lex_all(input));
+  totals vector_totals = parse(vp);
+  size_t middle = dvc::now();
+  dvc::stream_parser<token, lexer> sp("input", lexer(input));
+  totals stream_totals = parse(sp);
+  size_t threaded = dvc::now();
+  dvc::stream_parser<token, dvc::threaded_lexer<token, lexer>> tp(
+      "input", {lexer(input), [](const token& t) { return t.k == kind::end; }});
+  totals threaded_totals = parse(tp);
+  size_t end = dvc::now();
+
+  DVC_LOG("vector parser: ", double(middle - start) / n, "ns/statement");
+  DVC_LOG("stream parser: ", double(threaded - middle) / n, "ns/statement");
+  DVC_LOG("threaded stream parser: ", double(end - threaded) / n,
+          "ns/statement");
+  DVC_ASSERT(vector_totals == stream_totals);
+  DVC_ASSERT(vector_totals == threaded_totals);
+  DVC_ASSERT_EQ(vector_totals.assignments + vector_totals.calls, n);
+}
+
+void test_lookahead() {
+  struct counter {
+    int i = 0;
+    int next() { return i++; }
+  };
+  dvc::stream_parser<int, counter, 8> p("counter", counter());
+  DVC_ASSERT_EQ(p.peek(7), 7);
+  DVC_ASSERT_EQ(p.pop(), 0);
+  DVC_ASSERT_EQ(p.peek(7), 8);
+  {
+    decltype(p)::checkpoint c(p);
+    p.incr(7);
+    DVC_ASSERT_EQ(p.pop(), 8);
+    p.rewind(c);
+    DVC_ASSERT_EQ(p.pop(), 1);
+  }
+  p.incr(100);
+  DVC_ASSERT_EQ(p.pop(), 102);
+  DVC_ASSERT_EQ(p.peek(7), 110);
+  p.pos(104);
+  DVC_ASSERT_EQ(p.peek(), 104);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_lookahead();
+  test_equivalence();
+}
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dvc/arena.h"
+#include "dvc/hash.h"
+#include "dvc/log.h"
+#include "dvc/scanner.h"
+
+namespace dvc {
+
+// A parsing expression grammar library.  Grammars are composed from the
+// class templates below, and every rule is a type with a static
+// `template <class State> bool match(State&)`, so a whole grammar is
+// instantiated and inlined as ordinary code.  Named and recursive rules are
+// declared as structs deriving from their expression:
+//
+//   struct value;
+//   struct list : seq<ch<'['>, opt<list_of<value, ch<','>>>, ch<']'>> {};
+//   struct value : choice<list, plus<in<digits>>> {};
+//
+// Every rule leaves the state as it found it when it fails.  Parsing is
+// linear time for grammars without backtracking through repeated rules, and
+// for any grammar when those rules are wrapped in memo<>.
+namespace peg {
+
+// A syntax tree node produced by capture<>.  Nodes are allocated in the
+// state's arena and point into the input text.
+struct node {
+  size_t tag;
+  std::string_view text;
+  node* first_child = nullptr;
+  node* next_sibling = nullptr;
+
+  size_t num_children() const {
+    size_t n = 0;
+    for (node* c = first_child; c; c = c->next_sibling) n++;
+    return n;
+  }
+
+  template <typename F>
+  void for_each_child(F&& f) const {
+    for (node* c = first_child; c; c = c->next_sibling) f(*c);
+  }
+};
+
+namespace peg_detail {
+
+inline size_t next_rule_id() {
+  static std::atomic<size_t> next{0};
+  return next++;
+}
+
+template <typename Rule>
+size_t rule_id() {
+  static const size_t id = next_rule_id();
+  return id;
+}
+
+struct memo_entry {
+  uint64_t key = 0;  // 0 for an empty slot
+  size_t end;        // npos for a failed match
+  node** nodes;
+  size_t num_nodes;
+};
+
+}  // namespace peg_detail
+
+// The input and parse state threaded through all rules.  Derive from it to
+// give actions somewhere to put their results.
+class state {
+ public:
+  explicit state(std::string_view text) : text(text) {}
+
+  state(const state&) = delete;
+  state& operator=(const state&) = delete;
+
+  bool at_end() const { return pos == text.size(); }
+  char peek() const { return text[pos]; }
+
+  // Records a failure at the current position, for error messages.
+  bool fail() {
+    if (pos > furthest) furthest = pos;
+    return false;
+  }
+
+  // The root nodes captured so far.
+  const std::vector<node*>& nodes() const { return stack; }
+
+  // A message locating the furthest position any rule failed at.
+  std::string error(const std::string& filename) const {
+    scanner_view s(filename, text);
+    s.pos(furthest);
+    return concat(filename, ":", s.line() + 1, ":", s.column() + 1,
+                  ": syntax error");
+  }
+
+  std::string_view text;
+  size_t pos = 0;
+  size_t furthest = 0;
+  std::vector<node*> stack;
+  dvc::arena arena;
+
+  peg_detail::memo_entry* find_memo(uint64_t key) {
+    if (memo_.empty()) memo_.resize(1024);
+    size_t mask = memo_.size() - 1;
+    for (size_t i = mix64(key) & mask;; i = (i + 1) & mask)
+      if (memo_[i].key == key || memo_[i].key == 0) return &memo_[i];
+  }
+
+  void add_memo(peg_detail::memo_entry entry) {
+    if (2 * (memo_size_ + 1) > memo_.size()) {
+      std::vector<peg_detail::memo_entry> old(memo_.size() * 2);
+      old.swap(memo_);
+      for (const auto& e : old)
+        if (e.key) *find_memo(e.key) = e;
+    }
+    *find_memo(entry.key) = entry;
+    memo_size_++;
+  }
+
+ private:
+  std::vector<peg_detail::memo_entry> memo_;
+  size_t memo_size_ = 0;
+};
+
+// Terminals.
+
+template <char c>
+struct ch {
+  template <class State>
+  static bool match(State& s) {
+    if (s.at_end() || s.peek() != c) return s.fail();
+    s.pos++;
+    return true;
+  }
+};
+
+template <char lo, char hi>
+struct range {
+  template <class State>
+  static bool match(State& s) {
+    if (s.at_end() || s.peek() < lo || s.peek() > hi) return s.fail();
+    s.pos++;
+    return true;
+  }
+};
+
+template <char... cs>
+struct str {
+  template <class State>
+  static bool match(State& s) {
+    static constexpr char chars[] = {cs...};
+    if (s.text.substr(s.pos, sizeof(chars)) !=
+        std::string_view(chars, sizeof(chars)))
+      return s.fail();
+    s.pos += sizeof(chars);
+    return true;
+  }
+};
+
+// One character of a char_class.
+template <const char_class& chars>
+struct in {
+  template <class State>
+  static bool match(State& s) {
+    if (s.at_end() || !chars.contains(s.peek())) return s.fail();
+    s.pos++;
+    return true;
+  }
+};
+
+// Zero or more characters of a char_class; the same as star<in<chars>> but
+// skipped in bulk.
+template <const char_class& chars>
+struct skip {
+  template <class State>
+  static bool match(State& s) {
+    s.pos = chars.skip(s.text.data() + s.pos, s.text.data() + s.text.size(),
+                       true) -
+            s.text.data();
+    return true;
+  }
+};
+
+struct any {
+  template <class State>
+  static bool match(State& s) {
+    if (s.at_end()) return s.fail();
+    s.pos++;
+    return true;
+  }
+};
+
+struct eof {
+  template <class State>
+  static bool match(State& s) {
+    return s.at_end() || s.fail();
+  }
+};
+
+// Combinators.
+
+template <class... Rules>
+struct seq {
+  template <class State>
+  static bool match(State& s) {
+    size_t pos = s.pos;
+    size_t depth = s.stack.size();
+    if ((Rules::match(s) && ...)) return true;
+    s.pos = pos;
+    s.stack.resize(depth);
+    return false;
+  }
+};
+
+template <class... Rules>
+struct choice {
+  template <class State>
+  static bool match(State& s) {
+    return (Rules::match(s) || ...);
+  }
+};
+
+template <class Rule>
+struct star {
+  template <class State>
+  static bool match(State& s) {
+    for (size_t pos = s.pos; Rule::match(s) && s.pos != pos; pos = s.pos) {
+    }
+    return true;
+  }
+};
+
+template <class Rule>
+struct plus {
+  template <class State>
+  static bool match(State& s) {
+    return Rule::match(s) && star<Rule>::match(s);
+  }
+};
+
+template <class Rule>
+struct opt {
+  template <class State>
+  static bool match(State& s) {
+    Rule::match(s);
+    return true;
+  }
+};
+
+// One or more Rule separated by Sep.
+template <class Rule, class Sep>
+struct list_of : seq<Rule, star<seq<Sep, Rule>>> {};
+
+// Lookahead predicates, which never consume input.
+template <class Rule>
+struct and_ {
+  template <class State>
+  static bool match(State& s) {
+    size_t pos = s.pos;
+    size_t depth = s.stack.size();
+    bool matched = Rule::match(s);
+    s.pos = pos;
+    s.stack.resize(depth);
+    return matched;
+  }
+};
+
+template <class Rule>
+struct not_ {
+  template <class State>
+  static bool match(State& s) {
+    return !and_<Rule>::match(s);
+  }
+};
+
+// Calls Action::apply(matched_text, state) when Rule matches.  Actions are
+// not undone if an enclosing rule later fails, so side effects belong in
+// rules that cannot be backtracked over, or in capture<> nodes instead.
+template <class Rule, class Action>
+struct action {
+  template <class State>
+  static bool match(State& s) {
+    size_t pos = s.pos;
+    if (!Rule::match(s)) return false;
+    Action::apply(s.text.substr(pos, s.pos - pos), s);
+    return true;
+  }
+};
+
+// Builds a node tagged tag for the text matched by Rule, whose children are
+// the nodes captured within it.
+template <size_t tag, class Rule>
+struct capture {
+  template <class State>
+  static bool match(State& s) {
+    size_t pos = s.pos;
+    size_t depth = s.stack.size();
+    if (!Rule::match(s)) return false;
+    node* n = s.arena.template make<node>(tag, s.text.substr(pos, s.pos - pos));
+    for (size_t i = s.stack.size(); i-- > depth;) {
+      s.stack[i]->next_sibling = n->first_child;
+      n->first_child = s.stack[i];
+    }
+    s.stack.resize(depth);
+    s.stack.push_back(n);
+    return true;
+  }
+};
+
+// Packrat memoisation: the result of Rule at each position, including the
+// nodes it captured, is computed once and replayed after that.  Rule must
+// not be left recursive, and its actions run only on the first match.
+template <class Rule>
+struct memo {
+  template <class State>
+  static bool match(State& s) {
+    uint64_t key = (uint64_t(peg_detail::rule_id<Rule>() + 1) << 40) | s.pos;
+    peg_detail::memo_entry* entry = s.find_memo(key);
+    if (entry->key == key) {
+      if (entry->end == std::string_view::npos) return false;
+      s.stack.insert(s.stack.end(), entry->nodes,
+                     entry->nodes + entry->num_nodes);
+      s.pos = entry->end;
+      return true;
+    }
+    size_t depth = s.stack.size();
+    if (!Rule::match(s)) {
+      s.add_memo({key, std::string_view::npos, nullptr, 0});
+      return false;
+    }
+    size_t num_nodes = s.stack.size() - depth;
+    node** nodes = static_cast<node**>(
+        s.arena.alloc(num_nodes * sizeof(node*), alignof(node*)));
+    std::copy(s.stack.begin() + depth, s.stack.end(), nodes);
+    s.add_memo({key, s.pos, nodes, num_nodes});
+    return true;
+  }
+};
+
+// Matches Grammar against all of s.text.
+template <class Grammar, class State>
+bool parse(State& s) {
+  s.pos = 0;
+  return seq<Grammar, eof>::match(s);
+}
+
+// As parse, but fails with the position of the error.
+template <class Grammar, class State>
+void parse_or_die(State& s, const std::string& filename) {
+  if (!parse<Grammar>(s)) DVC_FAIL(s.error(filename));
+}
+
+}  // namespace peg
+}  // namespace dvc
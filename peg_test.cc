@@ -0,0 +1,261 @@
+#include "dvc/peg.h"
+
+#include <random>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+using namespace dvc::peg;
+
+namespace json {
+
+enum tag { kString, kNumber, kObject, kArray, kMember, kTrue, kFalse, kNull };
+
+constexpr dvc::char_class ws_chars(" \t\r\n");
+constexpr dvc::char_class digit_chars = dvc::char_class::range('0', '9');
+constexpr dvc::char_class exp_chars("eE");
+constexpr dvc::char_class sign_chars("+-");
+constexpr dvc::char_class plain_chars = ~dvc::char_class("\"\\");
+
+struct ws : skip<ws_chars> {};
+template <class Rule>
+struct tok : seq<Rule, ws> {};
+
+struct string : seq<ch<'"'>, skip<plain_chars>,
+                    star<seq<ch<'\\'>, any, skip<plain_chars>>>, ch<'"'>> {};
+struct digits : seq<in<digit_chars>, skip<digit_chars>> {};
+struct number
+    : seq<opt<ch<'-'>>, digits, opt<seq<ch<'.'>, digits>>,
+          opt<seq<in<exp_chars>, opt<in<sign_chars>>, digits>>> {};
+
+struct value;
+struct member : capture<kMember, seq<capture<kString, tok<string>>,
+                                     tok<ch<':'>>, value>> {};
+struct object : seq<tok<ch<'{'>>, opt<list_of<member, tok<ch<','>>>>, ch<'}'>> {
+};
+struct array : seq<tok<ch<'['>>, opt<list_of<value, tok<ch<','>>>>, ch<']'>> {};
+struct value
+    : seq<choice<capture<kString, string>, capture<kNumber, number>,
+                 capture<kObject, object>, capture<kArray, array>,
+                 capture<kTrue, str<'t', 'r', 'u', 'e'>>,
+                 capture<kFalse, str<'f', 'a', 'l', 's', 'e'>>,
+                 capture<kNull, str<'n', 'u', 'l', 'l'>>>,
+          ws> {};
+struct document : seq<ws, value> {};
+
+}  // namespace json
+
+struct counts {
+  size_t values = 0;
+  size_t members = 0;
+  size_t string_bytes = 0;
+
+  bool operator==(const counts& o) const {
+    return values == o.values && members == o.members &&
+           string_bytes == o.string_bytes;
+  }
+};
+
+void count(const node& n, counts& c) {
+  if (n.tag == json::kMember) {
+    c.members++;
+    c.string_bytes += n.first_child->text.size();
+    count(*n.first_child->next_sibling, c);
+    return;
+  }
+  c.values++;
+  if (n.tag == json::kString) c.string_bytes += n.text.size();
+  n.for_each_child([&](const node& child) { count(child, c); });
+}
+
+// A hand-written recursive descent validator for the same grammar.
+class hand_parser {
+ public:
+  explicit hand_parser(std::string_view text) : text(text) {}
+
+  counts parse() {
+    ws();
+    value();
+    DVC_ASSERT_EQ(pos, text.size());
+    return c;
+  }
+
+ private:
+  void ws() {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\n' ||
+                                 text[pos] == '\t' || text[pos] == '\r'))
+      pos++;
+  }
+
+  void expect(char ch) {
+    DVC_ASSERT_EQ(text[pos], ch);
+    pos++;
+  }
+
+  void string() {
+    size_t start = pos;
+    expect('"');
+    while (text[pos] != '"') pos += text[pos] == '\\' ? 2 : 1;
+    pos++;
+    c.string_bytes += pos - start;
+  }
+
+  void digits() {
+    DVC_ASSERT(std::isdigit(text[pos]));
+    while (pos < text.size() && std::isdigit(text[pos])) pos++;
+  }
+
+  void number() {
+    if (text[pos] == '-') pos++;
+    digits();
+    if (pos < text.size() && text[pos] == '.') {
+      pos++;
+      digits();
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+      pos++;
+      if (text[pos] == '+' || text[pos] == '-') pos++;
+      digits();
+    }
+  }
+
+  template <typename F>
+  void list(char close, F f) {
+    pos++;
+    ws();
+    if (text[pos] != close) {
+      f();
+      while (text[pos] == ',') {
+        pos++;
+        ws();
+        f();
+      }
+    }
+    expect(close);
+  }
+
+  void value() {
+    c.values++;
+    char ch = text[pos];
+    if (ch == '"') {
+      string();
+    } else if (ch == '{') {
+      list('}', [&] {
+        c.members++;
+        string();
+        ws();
+        expect(':');
+        ws();
+        value();
+      });
+    } else if (ch == '[') {
+      list(']', [&] { value(); });
+    } else if (text.substr(pos, 4) == "true" || text.substr(pos, 4) == "null") {
+      pos += 4;
+    } else if (text.substr(pos, 5) == "false") {
+      pos += 5;
+    } else {
+      number();
+    }
+    ws();
+  }
+
+  std::string_view text;
+  size_t pos = 0;
+  counts c;
+};
+
+void make_value(std::mt19937_64& ran, int depth, std::string& out) {
+  switch (depth > 4 ? ran() % 4 : ran() % 6) {
+    case 0:
+      out += "\"str\\\"ing " + std::to_string(ran() % 1000) + "\"";
+      break;
+    case 1:
+      out += std::to_string(int64_t(ran() % 100000) - 50000) + ".25e-3";
+      break;
+    case 2:
+      out += "true";
+      break;
+    case 3:
+      out += "null";
+      break;
+    case 4:
+      out += "{ ";
+      for (size_t i = 0, n = ran() % 6; i < n; i++) {
+        if (i) out += ",\n";
+        out += "\"key" + std::to_string(i) + "\": ";
+        make_value(ran, depth + 1, out);
+      }
+      out += " }";
+      break;
+    default:
+      out += "[";
+      for (size_t i = 0, n = ran() % 6; i < n; i++) {
+        if (i) out += ", ";
+        make_value(ran, depth + 1, out);
+      }
+      out += "]";
+  }
+}
+
+void test_json() {
+  std::mt19937_64 ran;
+  std::string text = "[";
+  for (int i = 0; i < 100000; i++) {
+    if (i) text += ",\n";
+    make_value(ran, 1, text);
+  }
+  text += "]";
+
+  size_t start = dvc::now();
+  counts hand = hand_parser(text).parse();
+  size_t middle = dvc::now();
+  state s(text);
+  DVC_ASSERT(parse<json::document>(s), s.error("json"));
+  counts peg;
+  DVC_ASSERT_EQ(s.nodes().size(), 1u);
+  count(*s.nodes()[0], peg);
+  size_t end = dvc::now();
+
+  DVC_LOG("hand-written json: ", double(middle - start) / text.size(),
+          "ns/byte");
+  DVC_LOG("peg json with tree: ", double(end - middle) / text.size(),
+          "ns/byte");
+  DVC_ASSERT(hand == peg);
+  DVC_ASSERT_GT(peg.values, 100000u);
+}
+
+void test_errors() {
+  state s("[1, 2,\n 3,, 4]");
+  DVC_ASSERT(!parse<json::document>(s));
+  DVC_ASSERT_EQ(s.error("input"), "input:2:4: syntax error");
+}
+
+// Every alternative of s starts with a, so without memoisation parsing takes
+// time exponential in the nesting depth.
+namespace backtrack {
+struct s_rule;
+struct a_rule : capture<1, choice<seq<ch<'('>, s_rule, ch<')'>>, ch<'a'>>> {};
+struct s_rule : choice<seq<memo<a_rule>, ch<'x'>>, seq<memo<a_rule>, ch<'y'>>,
+                       seq<memo<a_rule>, ch<'z'>>> {};
+}  // namespace backtrack
+
+void test_memo() {
+  constexpr size_t depth = 30;
+  std::string text = std::string(depth, '(') + "az";
+  for (size_t i = 0; i < depth; i++) text += ")z";
+  state s(text);
+  DVC_ASSERT(parse<backtrack::s_rule>(s));
+  size_t nesting = 0;
+  for (const node* n = s.nodes()[0]; n; n = n->first_child) nesting++;
+  DVC_ASSERT_EQ(nesting, depth + 1);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_errors();
+  test_memo();
+  test_json();
+}
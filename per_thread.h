@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace dvc {
+
+namespace per_thread_detail {
+
+struct entry {
+  void* instance;
+  uint64_t generation;
+};
+
+// The calling thread's instances, indexed by per_thread slot.  Kept trivial so
+// that the fast path needs no thread_local initialization guard.
+struct cache {
+  entry* entries;
+  size_t size;
+};
+
+inline thread_local cache thread_cache = {nullptr, 0};
+inline thread_local std::vector<entry> thread_cache_storage;
+
+// Slots are recycled when a per_thread is destroyed, so the caches stay
+// bounded by the number of live per_thread objects.  Generations are never
+// reused, so a stale cache entry for a recycled slot is never matched.
+struct registry {
+  std::mutex mu;
+  std::vector<size_t> free_slots;
+  size_t next_slot = 0;
+  uint64_t next_generation = 1;
+
+  std::pair<size_t, uint64_t> acquire() {
+    std::lock_guard lock(mu);
+    size_t slot;
+    if (free_slots.empty()) {
+      slot = next_slot++;
+    } else {
+      slot = free_slots.back();
+      free_slots.pop_back();
+    }
+    return {slot, next_generation++};
+  }
+
+  void release(size_t slot) {
+    std::lock_guard lock(mu);
+    free_slots.push_back(slot);
+  }
+};
+
+inline registry& get_registry() {
+  static registry r;
+  return r;
+}
+
+}  // namespace per_thread_detail
+
+// One instance of T for each thread that calls local(), all owned by the
+// per_thread object so that they outlive the threads that filled them.
+//
+// local() is a couple of thread_local loads on the fast path.  for_each()
+// visits every instance and must not race with threads still using theirs.
+template <typename T>
+class per_thread {
+ public:
+  per_thread() : per_thread([] { return std::make_unique<T>(); }) {}
+
+  template <typename Factory>
+  explicit per_thread(Factory factory) : factory_(std::move(factory)) {
+    std::tie(slot_, generation_) = per_thread_detail::get_registry().acquire();
+  }
+
+  per_thread(const per_thread&) = delete;
+  per_thread& operator=(const per_thread&) = delete;
+
+  ~per_thread() { per_thread_detail::get_registry().release(slot_); }
+
+  T& local() {
+    const per_thread_detail::cache& cache = per_thread_detail::thread_cache;
+    if (slot_ < cache.size && cache.entries[slot_].generation == generation_)
+      return *static_cast<T*>(cache.entries[slot_].instance);
+    return local_slow();
+  }
+
+  template <typename F>
+  void for_each(F&& f) {
+    std::lock_guard lock(mu_);
+    for (const auto& instance : instances_) f(*instance);
+  }
+
+  size_t size() {
+    std::lock_guard lock(mu_);
+    return instances_.size();
+  }
+
+ private:
+  T& local_slow() {
+    T* instance;
+    {
+      std::lock_guard lock(mu_);
+      instances_.push_back(factory_());
+      instance = instances_.back().get();
+    }
+    auto& storage = per_thread_detail::thread_cache_storage;
+    if (storage.size() <= slot_) storage.resize(slot_ + 1, {nullptr, 0});
+    storage[slot_] = {instance, generation_};
+    per_thread_detail::thread_cache = {storage.data(), storage.size()};
+    return *instance;
+  }
+
+  std::function<std::unique_ptr<T>()> factory_;
+  size_t slot_;
+  uint64_t generation_;
+  std::mutex mu_;
+  std::vector<std::unique_ptr<T>> instances_;
+};
+
+// A T per thread for mergeable accumulators such as the sketches: add() goes
+// to the calling thread's instance, and merged() combines them all into a copy
+// of the prototype.  Same threading rules as per_thread::for_each.
+template <typename T>
+class sharded {
+ public:
+  explicit sharded(T prototype = T())
+      : prototype_(std::move(prototype)),
+        shards_([this] { return std::make_unique<T>(prototype_); }) {}
+
+  template <typename... Args>
+  void add(Args&&... args) {
+    shards_.local().add(std::forward<Args>(args)...);
+  }
+
+  T& local() { return shards_.local(); }
+
+  T merged() {
+    T result = prototype_;
+    shards_.for_each([&](const T& shard) { result.merge(shard); });
+    return result;
+  }
+
+ private:
+  const T prototype_;
+  per_thread<T> shards_;
+};
+
+}  // namespace dvc
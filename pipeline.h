@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dvc/clock.h"
+#include "dvc/log.h"
+#include "dvc/queue.h"
+#include "dvc/string.h"
+
+namespace dvc {
+
+// Counters for one stage of a pipeline, summed over its threads.
+struct stage_stats {
+  std::string name;
+  size_t threads = 0;
+  uint64_t items_in = 0;
+  uint64_t bytes_in = 0;  // for inputs with a size()
+  uint64_t items_out = 0;
+  uint64_t busy_ns = 0;      // in the stage function
+  uint64_t max_item_ns = 0;  // the slowest single call
+  uint64_t wait_in_ns = 0;   // blocked on an empty input
+  uint64_t wait_out_ns = 0;  // blocked on a full output
+
+  void add(const stage_stats& other) {
+    items_in += other.items_in;
+    bytes_in += other.bytes_in;
+    items_out += other.items_out;
+    busy_ns += other.busy_ns;
+    max_item_ns = std::max(max_item_ns, other.max_item_ns);
+    wait_in_ns += other.wait_in_ns;
+    wait_out_ns += other.wait_out_ns;
+  }
+};
+
+namespace pipeline_detail {
+
+// Spins, then yields, then sleeps, for waits on a queue.
+class backoff {
+ public:
+  void pause() {
+    if (n_ < 64) {
+    } else if (n_ < 128) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    n_++;
+  }
+
+ private:
+  size_t n_ = 0;
+};
+
+template <typename T, typename = void>
+struct has_size : std::false_type {};
+template <typename T>
+struct has_size<T, std::void_t<decltype(std::declval<const T&>().size())>>
+    : std::true_type {};
+
+class channel_base {
+ public:
+  virtual ~channel_base() = default;
+  virtual void open(size_t capacity) = 0;
+
+  size_t producers = 0;
+  size_t consumers = 0;
+};
+
+class stage_base {
+ public:
+  stage_base(std::string name, size_t threads) {
+    stats.name = std::move(name);
+    stats.threads = threads;
+  }
+  virtual ~stage_base() = default;
+  virtual void run(stage_stats& stats) = 0;
+
+  stage_stats stats;
+  std::mutex mu;
+};
+
+}  // namespace pipeline_detail
+
+// A sequence of stages connected by bounded queues, each stage run by its
+// own threads.  A stage blocks when its output queue is full, so a slow
+// stage holds back the ones before it rather than letting queues grow.
+// Items move between stages in batches to amortize queue traffic.
+//
+//   pipeline p;
+//   auto& blocks = p.source<std::string>("read", [&](auto& emit) { ... });
+//   auto& hashes = p.stage<digest>("hash", blocks, 4, hash_block);
+//   p.sink("write", hashes, 1, [&](digest d) { ... });
+//   p.run();
+//
+// Stages block, so they run on dedicated threads rather than a
+// thread_pool.  A pipeline runs once.
+class pipeline {
+ public:
+  explicit pipeline(size_t queue_capacity = 1024, size_t batch = 32)
+      : queue_capacity_(queue_capacity), batch_(batch) {}
+
+  pipeline(const pipeline&) = delete;
+  pipeline& operator=(const pipeline&) = delete;
+
+  // The queue between two stages.  Single-producer single-consumer
+  // connections use an spsc_queue, and others an mpmc_queue.
+  template <typename T>
+  class channel : public pipeline_detail::channel_base {
+   public:
+    void open(size_t capacity) override {
+      if (producers == 1 && consumers == 1)
+        spsc_ = std::make_unique<spsc_queue<T>>(capacity);
+      else
+        mpmc_ = std::make_unique<mpmc_queue<T>>(capacity);
+      remaining_producers_ = producers;
+    }
+
+    // Pushes all n items, waiting while the queue is full.
+    void push(T* items, size_t n, stage_stats& stats) {
+      pipeline_detail::backoff backoff;
+      uint64_t start = 0;
+      while (n > 0) {
+        size_t pushed = spsc_ ? spsc_->try_push_batch(items, n)
+                              : mpmc_->try_push_batch(items, n);
+        items += pushed;
+        n -= pushed;
+        if (n > 0) {
+          if (start == 0) start = tsc_clock::ticks();
+          backoff.pause();
+        }
+      }
+      if (start) stats.wait_out_ns += tsc_clock::to_ns(tsc_clock::ticks() - start);
+    }
+
+    // Pops up to n items, waiting while the queue is empty.  Returns 0 once
+    // every producer is done and the queue is drained.
+    size_t pop(T* items, size_t n, stage_stats& stats) {
+      pipeline_detail::backoff backoff;
+      uint64_t start = 0;
+      size_t popped;
+      while (true) {
+        bool closed = remaining_producers_.load(std::memory_order_acquire) == 0;
+        popped = spsc_ ? spsc_->try_pop_batch(items, n)
+                       : mpmc_->try_pop_batch(items, n);
+        if (popped > 0 || closed) break;
+        if (start == 0) start = tsc_clock::ticks();
+        backoff.pause();
+      }
+      if (start) stats.wait_in_ns += tsc_clock::to_ns(tsc_clock::ticks() - start);
+      return popped;
+    }
+
+    void producer_done() {
+      remaining_producers_.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+   private:
+    std::unique_ptr<spsc_queue<T>> spsc_;
+    std::unique_ptr<mpmc_queue<T>> mpmc_;
+    std::atomic<size_t> remaining_producers_{0};
+  };
+
+  // Buffers a source's items into batches.
+  template <typename T>
+  class emitter {
+   public:
+    emitter(channel<T>& out, size_t batch, stage_stats& stats)
+        : out_(out), batch_(batch), stats_(stats) {
+      buffer_.reserve(batch);
+    }
+
+    void operator()(T item) {
+      buffer_.push_back(std::move(item));
+      if (buffer_.size() == batch_) flush();
+    }
+
+    void flush() {
+      stats_.items_out += buffer_.size();
+      out_.push(buffer_.data(), buffer_.size(), stats_);
+      buffer_.clear();
+    }
+
+   private:
+    channel<T>& out_;
+    size_t batch_;
+    stage_stats& stats_;
+    std::vector<T> buffer_;
+  };
+
+  // A stage with no input, run by one thread, that calls f(emit) once; f
+  // produces items by calling emit(item).  Time in f, less time blocked on
+  // the output, counts as busy.
+  template <typename T, typename F>
+  channel<T>& source(std::string name, F f) {
+    auto& out = make_channel<T>();
+    out.producers = 1;
+    add_stage(std::move(name), 1, [this, &out, f](stage_stats& stats) mutable {
+      emitter<T> emit(out, batch_, stats);
+      uint64_t start = tsc_clock::ticks();
+      f(emit);
+      emit.flush();
+      stats.busy_ns = tsc_clock::to_ns(tsc_clock::ticks() - start) -
+                      stats.wait_out_ns;
+      out.producer_done();
+    });
+    return out;
+  }
+
+  // A stage that calls f(item) for each item of in on threads threads and
+  // passes on what it returns.  With more than one thread, output order is
+  // not input order.
+  template <typename Out, typename In, typename F>
+  channel<Out>& stage(std::string name, channel<In>& in, size_t threads, F f) {
+    auto& out = make_channel<Out>();
+    in.consumers += threads;
+    out.producers += threads;
+    add_stage(std::move(name), threads,
+              [this, &in, &out, f](stage_stats& stats) mutable {
+                std::vector<In> inputs(batch_);
+                std::vector<Out> outputs;
+                outputs.reserve(batch_);
+                while (size_t n = in.pop(inputs.data(), batch_, stats)) {
+                  for (size_t i = 0; i < n; i++)
+                    outputs.push_back(timed(stats, f, inputs[i]));
+                  stats.items_out += n;
+                  out.push(outputs.data(), n, stats);
+                  outputs.clear();
+                }
+                out.producer_done();
+              });
+    return out;
+  }
+
+  // A final stage that calls f(item) for each item of in on threads threads.
+  template <typename In, typename F>
+  void sink(std::string name, channel<In>& in, size_t threads, F f) {
+    in.consumers += threads;
+    add_stage(std::move(name), threads,
+              [this, &in, f](stage_stats& stats) mutable {
+                std::vector<In> inputs(batch_);
+                while (size_t n = in.pop(inputs.data(), batch_, stats))
+                  for (size_t i = 0; i < n; i++) timed(stats, f, inputs[i]);
+              });
+  }
+
+  // Runs every stage to completion.
+  void run() {
+    DVC_ASSERT(!ran_, "a pipeline runs once");
+    ran_ = true;
+    for (auto& c : channels_) {
+      DVC_ASSERT(c->consumers > 0, "a pipeline stage's output is not consumed");
+      c->open(queue_capacity_);
+    }
+    stopwatch wall;
+    std::vector<std::thread> threads;
+    for (auto& s : stages_)
+      for (size_t i = 0; i < s->stats.threads; i++)
+        threads.emplace_back([&s = *s] {
+          stage_stats stats;
+          s.run(stats);
+          std::lock_guard lock(s.mu);
+          s.stats.add(stats);
+        });
+    for (auto& thread : threads) thread.join();
+    wall_ns_ = wall.elapsed_ns();
+  }
+
+  // The stages' statistics, in the order they were added, after run().
+  std::vector<stage_stats> stats() const {
+    std::vector<stage_stats> result;
+    for (auto& s : stages_) result.push_back(s->stats);
+    return result;
+  }
+
+  uint64_t wall_ns() const { return wall_ns_; }
+
+  // A table of throughput and latency per stage, after run().
+  std::string report() const {
+    double seconds = std::max<uint64_t>(wall_ns_, 1) * 1e-9;
+    std::string out =
+        concat("pipeline ran ", wall_ns_ * 1e-6, "ms\n",
+               "stage threads items items/s MB/s ns/item max_ns busy% "
+               "wait_in% wait_out%\n");
+    for (auto& s : stages_) {
+      const stage_stats& st = s->stats;
+      uint64_t items = st.items_in ? st.items_in : st.items_out;
+      double thread_ns = double(wall_ns_) * st.threads / 100;
+      append_concat(out, st.name, ' ', st.threads, ' ', items, ' ',
+                    items / seconds, ' ', st.bytes_in / seconds / 1e6, ' ',
+                    items ? st.busy_ns / items : 0, ' ', st.max_item_ns, ' ',
+                    st.busy_ns / thread_ns, ' ', st.wait_in_ns / thread_ns, ' ',
+                    st.wait_out_ns / thread_ns, '\n');
+    }
+    return out;
+  }
+
+ private:
+  template <typename T>
+  class stage_impl : public pipeline_detail::stage_base {
+   public:
+    stage_impl(std::string name, size_t threads, T f)
+        : stage_base(std::move(name), threads), f_(std::move(f)) {}
+    void run(stage_stats& stats) override {
+      T f = f_;  // each thread gets its own copy of the stage function
+      f(stats);
+    }
+
+   private:
+    T f_;
+  };
+
+  template <typename T>
+  channel<T>& make_channel() {
+    auto c = std::make_unique<channel<T>>();
+    channel<T>& result = *c;
+    channels_.push_back(std::move(c));
+    return result;
+  }
+
+  template <typename F>
+  void add_stage(std::string name, size_t threads, F f) {
+    DVC_ASSERT(!ran_);
+    DVC_ASSERT_GT(threads, 0u);
+    stages_.push_back(
+        std::make_unique<stage_impl<F>>(std::move(name), threads, std::move(f)));
+  }
+
+  // Calls f(std::move(item)), accounting for it in stats.
+  template <typename F, typename In>
+  static auto timed(stage_stats& stats, F& f, In& item) {
+    stats.items_in++;
+    if constexpr (pipeline_detail::has_size<In>::value)
+      stats.bytes_in += item.size();
+    uint64_t start = tsc_clock::ticks();
+    struct record {
+      stage_stats& stats;
+      uint64_t start;
+      ~record() {
+        uint64_t ns = tsc_clock::to_ns(tsc_clock::ticks() - start);
+        stats.busy_ns += ns;
+        stats.max_item_ns = std::max(stats.max_item_ns, ns);
+      }
+    } r{stats, start};
+    return f(std::move(item));
+  }
+
+  size_t queue_capacity_;
+  size_t batch_;
+  bool ran_ = false;
+  uint64_t wall_ns_ = 0;
+  std::vector<std::unique_ptr<pipeline_detail::channel_base>> channels_;
+  std::vector<std::unique_ptr<pipeline_detail::stage_base>> stages_;
+};
+
+}  // namespace dvc
@@ -0,0 +1,123 @@
+#include "dvc/pipeline.h"
+
+#include <unistd.h>
+
+#include <array>
+#include <filesystem>
+#include <numeric>
+
+#include "dvc/file.h"
+#include "dvc/hex.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/scanner.h"
+#include "dvc/sha3.h"
+
+std::string DVC_OPTION(pipeline_input, -, "",
+                       "file to hash in the example, or empty to generate one");
+size_t DVC_OPTION(pipeline_input_mb, -, 64, "size of the generated input");
+size_t DVC_OPTION(block_kb, -, 1024, "approximate size of hashed blocks");
+size_t DVC_OPTION(hash_threads, -, 4, "threads in the hash stage");
+
+void test_pipeline() {
+  for (size_t threads : {1, 3}) {
+    dvc::pipeline p(16, 4);
+    auto& numbers = p.source<int>("count", [](auto& emit) {
+      for (int i = 1; i <= 10000; i++) emit(i);
+    });
+    auto& squares = p.stage<int64_t>("square", numbers, threads,
+                                     [](int i) { return int64_t(i) * i; });
+    auto& strings = p.stage<std::string>(
+        "format", squares, 2, [](int64_t x) { return std::to_string(x); });
+    std::atomic<int64_t> sum = 0;
+    std::atomic<size_t> bytes = 0;
+    p.sink("sum", strings, threads, [&](std::string s) {
+      sum += std::stoll(s);
+      bytes += s.size();
+    });
+    p.run();
+    DVC_ASSERT_EQ(sum, 333383335000);
+
+    std::vector<dvc::stage_stats> stats = p.stats();
+    DVC_ASSERT_EQ(stats.size(), 4u);
+    DVC_ASSERT_EQ(stats[0].items_out, 10000u);
+    DVC_ASSERT_EQ(stats[1].threads, threads);
+    DVC_ASSERT_EQ(stats[1].items_in, 10000u);
+    DVC_ASSERT_EQ(stats[2].items_out, 10000u);
+    DVC_ASSERT_EQ(stats[3].items_in, 10000u);
+    DVC_ASSERT_EQ(stats[3].bytes_in, bytes);
+  }
+}
+
+struct block {
+  size_t index = 0;
+  std::string_view data;
+  size_t size() const { return data.size(); }
+};
+
+struct digest {
+  size_t index = 0;
+  std::array<std::byte, 32> sha;
+};
+
+// Reads a file, splits it into blocks at line boundaries, hashes the blocks
+// in parallel and writes one line per block.
+void example() {
+  std::filesystem::path input = pipeline_input;
+  std::filesystem::path dir = std::filesystem::temp_directory_path();
+  if (input.empty()) {
+    input = dir / dvc::concat("pipeline_test.", ::getpid(), ".in");
+    dvc::file_writer writer(input, dvc::truncate);
+    std::string line;
+    for (size_t i = 0; writer.tell() < pipeline_input_mb << 20; i++) {
+      line.assign(i % 97 + 1, char('a' + i % 26));
+      writer.println(i, ' ', line);
+    }
+  }
+  std::filesystem::path output =
+      dir / dvc::concat("pipeline_test.", ::getpid(), ".out");
+
+  dvc::mapped_file file(input);
+  file.advise_sequential();
+  dvc::file_writer writer(output, dvc::truncate);
+
+  dvc::pipeline p;
+  auto& blocks = p.source<block>("read", [&](auto& emit) {
+    dvc::scanner_view s(input.string(), file.data());
+    static constexpr dvc::char_class newline("\n");
+    for (size_t index = 0; !s.at_end(); index++) {
+      size_t begin = s.pos();
+      s.pos(std::min(begin + (block_kb << 10), file.size()));
+      s.skip_until(newline);
+      if (!s.at_end()) s.incr();
+      emit(block{index, file.data().substr(begin, s.pos() - begin)});
+    }
+  });
+  auto& digests = p.stage<digest>(
+      "hash", blocks, hash_threads,
+      [](block b) { return digest{b.index, dvc::SHA3_256(b.data)}; });
+  size_t written = 0;
+  p.sink("write", digests, 1, [&](digest d) {
+    writer.println(d.index, ' ', dvc::ByteArrayToHexFixedString(d.sha));
+    written++;
+  });
+  p.run();
+
+  size_t expected_blocks = p.stats()[0].items_out;
+  DVC_ASSERT_EQ(written, expected_blocks);
+  DVC_ASSERT_EQ(p.stats()[1].bytes_in, file.size());
+  DVC_LOG("\n", p.report());
+  DVC_LOG("hashed ", file.size() >> 20, "MB in ", expected_blocks,
+          " blocks: ", double(file.size()) / p.wall_ns(), "GB/s end to end");
+
+  std::filesystem::remove(output);
+  if (pipeline_input.empty()) std::filesystem::remove(input);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_pipeline();
+  example();
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dvc/hash.h"
+#include "dvc/log.h"
+
+namespace dvc {
+
+// A KLL quantile sketch (Karnin, Lang and Liberty, 2016) of a stream of T.
+//
+// Items are held in a stack of compactors; level h holds items of weight 2^h.
+// When a level exceeds its capacity it is sorted and every other item,
+// starting at a random offset, is promoted to the level above.  Capacities
+// shrink geometrically towards the bottom, so the sketch holds O(k) items and
+// rank queries have error about 1.7 / k with high probability (k = 200 gives
+// under 1%).  Sketches with the same k merge by concatenating levels.
+template <typename T = double>
+class kll_sketch {
+ public:
+  explicit kll_sketch(uint32_t k = 200) : k_(k) {
+    DVC_ASSERT_GE(k, 8u);
+    add_level();
+  }
+
+  void add(const T& t) {
+    if (n_++ == 0) {
+      min_ = t;
+      max_ = t;
+    } else {
+      if (t < min_) min_ = t;
+      if (max_ < t) max_ = t;
+    }
+    levels_[0].push_back(t);
+    if (++retained_ >= total_capacity_) compress();
+  }
+
+  void merge(const kll_sketch& other) {
+    DVC_ASSERT_EQ(k_, other.k_);
+    if (other.n_ == 0) return;
+    if (n_ == 0) {
+      min_ = other.min_;
+      max_ = other.max_;
+    } else {
+      if (other.min_ < min_) min_ = other.min_;
+      if (max_ < other.max_) max_ = other.max_;
+    }
+    n_ += other.n_;
+    while (levels_.size() < other.levels_.size()) add_level();
+    for (size_t h = 0; h < other.levels_.size(); h++)
+      levels_[h].insert(levels_[h].end(), other.levels_[h].begin(),
+                        other.levels_[h].end());
+    retained_ += other.retained_;
+    while (retained_ >= total_capacity_) compress();
+  }
+
+  uint64_t size() const { return n_; }
+  bool empty() const { return n_ == 0; }
+  const T& min() const { return min_; }
+  const T& max() const { return max_; }
+
+  // The number of items retained, which is O(k) regardless of size().
+  size_t retained() const { return retained_; }
+
+  // An item whose rank is approximately q * size(), for q in [0, 1].
+  T quantile(double q) const {
+    DVC_ASSERT(!empty(), "quantile of empty sketch");
+    if (q <= 0) return min_;
+    if (q >= 1) return max_;
+    auto items = weighted_items();
+    uint64_t target = uint64_t(std::ceil(q * n_));
+    uint64_t cumulative = 0;
+    for (const auto& [t, weight] : items) {
+      cumulative += weight;
+      if (cumulative >= target) return t;
+    }
+    return max_;
+  }
+
+  template <size_t n>
+  std::array<T, n> quantiles(const std::array<double, n>& qs) const {
+    std::array<T, n> result;
+    for (size_t i = 0; i < n; i++) result[i] = quantile(qs[i]);
+    return result;
+  }
+
+  // The approximate fraction of items less than or equal to t.
+  double rank(const T& t) const {
+    if (empty()) return 0;
+    uint64_t r = 0;
+    for (size_t h = 0; h < levels_.size(); h++)
+      for (const T& u : levels_[h])
+        if (!(t < u)) r += uint64_t(1) << h;
+    return double(r) / n_;
+  }
+
+  template <typename Writer>
+  void write(Writer& writer) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writer.vwrite(k_);
+    writer.vwrite(n_);
+    if (n_ == 0) return;
+    writer.rwrite(min_);
+    writer.rwrite(max_);
+    writer.vwrite(levels_.size());
+    for (const auto& level : levels_) {
+      writer.vwrite(level.size());
+      for (const T& t : level) writer.rwrite(t);
+    }
+  }
+
+  template <typename Reader>
+  static kll_sketch read(Reader& reader) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    kll_sketch sketch(reader.vread());
+    sketch.n_ = reader.vread();
+    if (sketch.n_ == 0) return sketch;
+    sketch.min_ = reader.template rread<T>();
+    sketch.max_ = reader.template rread<T>();
+    size_t nlevels = reader.vread();
+    while (sketch.levels_.size() < nlevels) sketch.add_level();
+    for (auto& level : sketch.levels_) {
+      level.resize(reader.vread());
+      for (T& t : level) t = reader.template rread<T>();
+      sketch.retained_ += level.size();
+    }
+    return sketch;
+  }
+
+ private:
+  // Level capacities shrink by 2/3 per level below the top.  The sketch is
+  // compressed lazily: only when all levels together are at capacity is the
+  // lowest level over its own capacity compacted.
+  void add_level() {
+    levels_.emplace_back();
+    capacities_.resize(levels_.size());
+    total_capacity_ = 0;
+    for (size_t h = 0; h < levels_.size(); h++) {
+      size_t depth = levels_.size() - 1 - h;
+      capacities_[h] = std::max<size_t>(
+          2, size_t(std::ceil(k_ * std::pow(2.0 / 3.0, double(depth)))));
+      total_capacity_ += capacities_[h];
+    }
+  }
+
+  void compress() {
+    size_t h = 0;
+    while (levels_[h].size() < capacities_[h]) h++;
+    if (h + 1 == levels_.size()) add_level();
+    std::vector<T>& level = levels_[h];
+    std::sort(level.begin(), level.end());
+    // An odd item out stays behind so that the total weight is exact.
+    size_t begin = level.size() % 2;
+    size_t offset = mix64(++random_state_) & 1;
+    std::vector<T>& above = levels_[h + 1];
+    for (size_t i = begin + offset; i < level.size(); i += 2)
+      above.push_back(level[i]);
+    retained_ -= (level.size() - begin) / 2;
+    level.resize(begin);
+  }
+
+  std::vector<std::pair<T, uint64_t>> weighted_items() const {
+    std::vector<std::pair<T, uint64_t>> items;
+    items.reserve(retained());
+    for (size_t h = 0; h < levels_.size(); h++)
+      for (const T& t : levels_[h]) items.emplace_back(t, uint64_t(1) << h);
+    std::sort(items.begin(), items.end(), [](const auto& a, const auto& b) {
+      return a.first < b.first;
+    });
+    return items;
+  }
+
+  uint32_t k_;
+  uint64_t n_ = 0;
+  T min_ = T();
+  T max_ = T();
+  std::vector<std::vector<T>> levels_;
+  std::vector<size_t> capacities_;
+  size_t retained_ = 0;
+  size_t total_capacity_ = 0;
+  uint64_t random_state_ = 0;
+};
+
+}  // namespace dvc
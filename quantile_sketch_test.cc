@@ -0,0 +1,91 @@
+#include "dvc/quantile_sketch.h"
+
+#include <random>
+#include <thread>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/per_thread.h"
+#include "dvc/program.h"
+
+void check_quantiles(const dvc::kll_sketch<double>& sketch, size_t n) {
+  for (double q : {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999}) {
+    double error = std::abs(sketch.quantile(q) / n - q);
+    DVC_ASSERT_LT(error, 0.01, "q = ", q);
+  }
+  DVC_ASSERT_EQ(sketch.min(), 0.0);
+  DVC_ASSERT_EQ(sketch.max(), double(n - 1));
+}
+
+void test_accuracy() {
+  size_t n = size_t(1) << 24;
+  std::vector<double> values(n);
+  for (size_t i = 0; i < n; i++) values[i] = i;
+  std::shuffle(values.begin(), values.end(), std::mt19937_64());
+
+  dvc::kll_sketch<double> sketch;
+  size_t start = dvc::now();
+  for (double value : values) sketch.add(value);
+  size_t end = dvc::now();
+
+  DVC_LOG("kll: ", double(end - start) / n, "ns, ", sketch.retained(),
+          " retained");
+  DVC_ASSERT_EQ(sketch.size(), n);
+  DVC_ASSERT_LT(sketch.retained(), 1000u);
+  check_quantiles(sketch, n);
+  DVC_ASSERT_LT(std::abs(sketch.rank(n / 3) - 1.0 / 3), 0.01);
+}
+
+void test_threads(size_t nthreads) {
+  size_t n = size_t(1) << 24;
+
+  dvc::sharded<dvc::kll_sketch<double>> sketch;
+  size_t start = dvc::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+    threads.emplace_back([&, t] {
+      std::mt19937_64 ran(t);
+      auto& local = sketch.local();
+      for (size_t i = 0; i < n / nthreads; i++) local.add(ran() % n);
+    });
+  for (std::thread& thread : threads) thread.join();
+  dvc::kll_sketch<double> merged = sketch.merged();
+  size_t end = dvc::now();
+
+  DVC_LOG("kll ", nthreads, " threads: ", double(end - start) / n, "ns");
+  DVC_ASSERT_EQ(merged.size(), n / nthreads * nthreads);
+  for (double q : {0.1, 0.5, 0.9})
+    DVC_ASSERT_LT(std::abs(merged.quantile(q) / n - q), 0.01);
+}
+
+void test_serialize() {
+  dvc::kll_sketch<double> sketch(100);
+  for (size_t i = 0; i < 100000; i++) sketch.add(i % 1000);
+
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "quantile_sketch_test.kll";
+  {
+    dvc::file_writer writer(path, dvc::truncate);
+    sketch.write(writer);
+  }
+  dvc::file_reader reader(path);
+  auto copy = dvc::kll_sketch<double>::read(reader);
+  std::filesystem::remove(path);
+
+  DVC_ASSERT_EQ(copy.size(), sketch.size());
+  DVC_ASSERT_EQ(copy.retained(), sketch.retained());
+  DVC_ASSERT_EQ(copy.quantile(0.5), sketch.quantile(0.5));
+  copy.merge(sketch);
+  DVC_ASSERT_EQ(copy.size(), 2 * sketch.size());
+  DVC_ASSERT_LT(std::abs(copy.quantile(0.5) - 500), 20.0);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_accuracy();
+  for (size_t nthreads = 1; nthreads <= 2 * std::thread::hardware_concurrency();
+       nthreads *= 2)
+    test_threads(nthreads);
+  test_serialize();
+}
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "dvc/log.h"
+
+namespace dvc {
+
+inline constexpr size_t cache_line_size = 64;
+
+namespace queue_detail {
+
+inline size_t round_up_capacity(size_t capacity) {
+  DVC_ASSERT_GT(capacity, 0u);
+  size_t n = 1;
+  while (n < capacity) n *= 2;
+  return n;
+}
+
+// Uninitialized storage for n Ts.
+template <typename T>
+struct slots {
+  explicit slots(size_t n)
+      : data(static_cast<T*>(::operator new(n * sizeof(T),
+                                            std::align_val_t(alignof(T))))) {}
+  ~slots() { ::operator delete(data, std::align_val_t(alignof(T))); }
+
+  T* data;
+};
+
+}  // namespace queue_detail
+
+// A bounded lock-free queue for one producer thread and one consumer thread.
+// Each side caches the other's index, so in the steady state a push or pop
+// touches no cache line written by the other thread; the batch operations
+// also publish their index once per batch.  Capacity is rounded up to a
+// power of two.
+template <typename T>
+class spsc_queue {
+ public:
+  explicit spsc_queue(size_t capacity)
+      : mask_(queue_detail::round_up_capacity(capacity) - 1),
+        slots_(mask_ + 1) {}
+
+  spsc_queue(const spsc_queue&) = delete;
+  spsc_queue& operator=(const spsc_queue&) = delete;
+
+  ~spsc_queue() {
+    for (size_t i = consumer_.head; i != producer_.tail; i++)
+      slots_.data[i & mask_].~T();
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  // Producer only.
+  bool try_push(T&& t) { return try_push_batch(&t, 1) == 1; }
+
+  // Producer only.  Moves up to n items from items, returning how many.
+  size_t try_push_batch(T* items, size_t n) {
+    size_t tail = producer_.tail;
+    if (producer_.head_cache + capacity() - tail < n)
+      producer_.head_cache = head_.load(std::memory_order_acquire);
+    n = std::min(n, producer_.head_cache + capacity() - tail);
+    for (size_t i = 0; i < n; i++)
+      new (&slots_.data[(tail + i) & mask_]) T(std::move(items[i]));
+    if (n > 0) {
+      producer_.tail = tail + n;
+      tail_.store(tail + n, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // Consumer only.
+  bool try_pop(T& t) { return try_pop_batch(&t, 1) == 1; }
+
+  // Consumer only.  Moves up to n items into items, returning how many.
+  size_t try_pop_batch(T* items, size_t n) {
+    size_t head = consumer_.head;
+    if (consumer_.tail_cache - head < n)
+      consumer_.tail_cache = tail_.load(std::memory_order_acquire);
+    n = std::min(n, consumer_.tail_cache - head);
+    for (size_t i = 0; i < n; i++) {
+      T& slot = slots_.data[(head + i) & mask_];
+      items[i] = std::move(slot);
+      slot.~T();
+    }
+    if (n > 0) {
+      consumer_.head = head + n;
+      head_.store(head + n, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // Approximate unless called by the consumer.
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  const size_t mask_;
+  queue_detail::slots<T> slots_;
+
+  alignas(cache_line_size) std::atomic<size_t> head_{0};
+  alignas(cache_line_size) std::atomic<size_t> tail_{0};
+
+  // Private to each side.
+  struct alignas(cache_line_size) {
+    size_t tail = 0;
+    size_t head_cache = 0;
+  } producer_;
+  struct alignas(cache_line_size) {
+    size_t head = 0;
+    size_t tail_cache = 0;
+  } consumer_;
+};
+
+// A bounded lock-free queue for any number of producers and consumers
+// (Vyukov's design): each slot carries a sequence number saying whether it
+// is ready to be written or read in the current lap, so producers and
+// consumers only contend on their own index.  A batch claims a run of
+// consecutive ready slots with a single compare-and-swap.  Capacity is
+// rounded up to a power of two.
+template <typename T>
+class mpmc_queue {
+ public:
+  explicit mpmc_queue(size_t capacity)
+      : mask_(queue_detail::round_up_capacity(capacity) - 1),
+        cells_(new cell[mask_ + 1]) {
+    for (size_t i = 0; i <= mask_; i++)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  mpmc_queue(const mpmc_queue&) = delete;
+  mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+  ~mpmc_queue() {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    for (size_t i = head_.load(std::memory_order_relaxed); i != tail; i++)
+      cells_[i & mask_].storage()->~T();
+  }
+
+  size_t capacity() const { return mask_ + 1; }
+
+  bool try_push(T&& t) { return try_push_batch(&t, 1) == 1; }
+
+  // Moves up to n items from items, returning how many.
+  size_t try_push_batch(T* items, size_t n) {
+    size_t pos = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      size_t ready = count_ready(pos, n, 0);
+      if (ready == 0) {
+        size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+        if (seq == pos) continue;    // became ready meanwhile
+        if (seq < pos) return 0;     // full
+        pos = tail_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (tail_.compare_exchange_weak(pos, pos + ready,
+                                      std::memory_order_relaxed)) {
+        for (size_t i = 0; i < ready; i++) {
+          cell& c = cells_[(pos + i) & mask_];
+          new (c.storage()) T(std::move(items[i]));
+          c.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return ready;
+      }
+    }
+  }
+
+  bool try_pop(T& t) { return try_pop_batch(&t, 1) == 1; }
+
+  // Moves up to n items into items, returning how many.
+  size_t try_pop_batch(T* items, size_t n) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    while (true) {
+      size_t ready = count_ready(pos, n, 1);
+      if (ready == 0) {
+        size_t seq = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+        if (seq == pos + 1) continue;
+        if (seq < pos + 1) return 0;  // empty
+        pos = head_.load(std::memory_order_relaxed);
+        continue;
+      }
+      if (head_.compare_exchange_weak(pos, pos + ready,
+                                      std::memory_order_relaxed)) {
+        for (size_t i = 0; i < ready; i++) {
+          cell& c = cells_[(pos + i) & mask_];
+          T* slot = c.storage();
+          items[i] = std::move(*slot);
+          slot->~T();
+          c.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        return ready;
+      }
+    }
+  }
+
+ private:
+  struct cell {
+    std::atomic<size_t> sequence;
+    alignas(T) unsigned char data[sizeof(T)];
+
+    T* storage() { return std::launder(reinterpret_cast<T*>(data)); }
+  };
+
+  // The number of slots from pos, up to n, whose sequence is pos + offset.
+  size_t count_ready(size_t pos, size_t n, size_t offset) const {
+    size_t i = 0;
+    while (i < n && i <= mask_ &&
+           cells_[(pos + i) & mask_].sequence.load(std::memory_order_acquire) ==
+               pos + i + offset)
+      i++;
+    return i;
+  }
+
+  const size_t mask_;
+  std::unique_ptr<cell[]> cells_;
+  alignas(cache_line_size) std::atomic<size_t> tail_{0};
+  alignas(cache_line_size) std::atomic<size_t> head_{0};
+};
+
+}  // namespace dvc
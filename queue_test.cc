@@ -0,0 +1,113 @@
+#include "dvc/queue.h"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+void test_spsc() {
+  dvc::spsc_queue<std::unique_ptr<int>> q(3);
+  DVC_ASSERT_EQ(q.capacity(), 4u);
+  for (int i = 0; i < 4; i++) DVC_ASSERT(q.try_push(std::make_unique<int>(i)));
+  DVC_ASSERT(!q.try_push(std::make_unique<int>(4)));
+  std::unique_ptr<int> p;
+  DVC_ASSERT(q.try_pop(p));
+  DVC_ASSERT_EQ(*p, 0);
+  std::unique_ptr<int> batch[8];
+  DVC_ASSERT_EQ(q.try_pop_batch(batch, 8), 3u);
+  DVC_ASSERT_EQ(*batch[2], 3);
+  DVC_ASSERT(q.empty());
+
+  // Leftover items are destroyed with the queue.
+  auto shared = std::make_shared<int>(0);
+  {
+    dvc::spsc_queue<std::shared_ptr<int>> leftovers(8);
+    std::shared_ptr<int> copy = shared;
+    leftovers.try_push(std::move(copy));
+    DVC_ASSERT_EQ(shared.use_count(), 2);
+  }
+  DVC_ASSERT_EQ(shared.use_count(), 1);
+}
+
+// Every item pushed by each producer is popped exactly once, and each
+// producer's items arrive in order.
+template <typename Queue>
+void stress(Queue& q, size_t producers, size_t consumers, size_t n,
+            size_t batch) {
+  std::vector<std::vector<uint64_t>> seen(consumers);
+  std::vector<std::thread> threads;
+  std::atomic<size_t> remaining = producers * n;
+  for (size_t p = 0; p < producers; p++)
+    threads.emplace_back([&, p] {
+      std::vector<uint64_t> items(batch);
+      for (size_t i = 0; i < n;) {
+        size_t k = std::min(batch, n - i);
+        for (size_t j = 0; j < k; j++) items[j] = (p << 32) | (i + j);
+        for (size_t pushed = 0; pushed < k;) {
+          size_t m = q.try_push_batch(items.data() + pushed, k - pushed);
+          if (m == 0) std::this_thread::yield();
+          pushed += m;
+        }
+        i += k;
+      }
+    });
+  for (size_t c = 0; c < consumers; c++)
+    threads.emplace_back([&, c] {
+      std::vector<uint64_t> items(batch);
+      std::vector<uint64_t> last(producers, 0);
+      while (remaining > 0) {
+        size_t k = q.try_pop_batch(items.data(), batch);
+        if (k == 0) std::this_thread::yield();
+        for (size_t j = 0; j < k; j++) {
+          uint64_t p = items[j] >> 32, i = items[j] & 0xffffffff;
+          DVC_ASSERT(i + 1 > last[p], "out of order");
+          last[p] = i + 1;
+          seen[c].push_back(items[j]);
+        }
+        remaining -= k;
+      }
+    });
+  for (auto& thread : threads) thread.join();
+  std::vector<uint64_t> all;
+  for (auto& s : seen) all.insert(all.end(), s.begin(), s.end());
+  std::sort(all.begin(), all.end());
+  DVC_ASSERT_EQ(all.size(), producers * n);
+  for (size_t p = 0; p < producers; p++)
+    for (size_t i = 0; i < n; i++) DVC_ASSERT_EQ(all[p * n + i], (p << 32) | i);
+}
+
+template <typename Queue>
+double benchmark(size_t producers, size_t consumers, size_t batch) {
+  constexpr size_t n = 1000000;
+  Queue q(1024);
+  size_t start = dvc::now();
+  stress(q, producers, consumers, n, batch);
+  return double(dvc::now() - start) / (n * producers);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_spsc();
+  for (size_t batch : {1, 7, 64}) {
+    dvc::spsc_queue<uint64_t> spsc(64);
+    stress(spsc, 1, 1, 100000, batch);
+    for (size_t threads : {1, 3}) {
+      dvc::mpmc_queue<uint64_t> mpmc(64);
+      stress(mpmc, threads, threads, 100000, batch);
+    }
+  }
+
+  for (size_t batch : {1, 32}) {
+    DVC_LOG("spsc batch ", batch, ": ",
+            benchmark<dvc::spsc_queue<uint64_t>>(1, 1, batch), "ns/item");
+    DVC_LOG("mpmc 1x1 batch ", batch, ": ",
+            benchmark<dvc::mpmc_queue<uint64_t>>(1, 1, batch), "ns/item");
+    DVC_LOG("mpmc 4x4 batch ", batch, ": ",
+            benchmark<dvc::mpmc_queue<uint64_t>>(4, 4, batch), "ns/item");
+  }
+}
@@ -1,55 +1,410 @@
+#pragma once
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <cmath>
 #include <cstdint>
-#include <map>
-#include <mutex>
+#include <limits>
 #include <random>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "dvc/log.h"
+#include "dvc/per_thread.h"
 
 namespace dvc {
 
+// Returns a uniformly distributed double in the open interval (0, 1).
+template <typename Generator>
+double random_unit(Generator& generator) {
+  return (double(generator() >> 11) + 0.5) * 0x1.0p-53;
+}
+
+// A uniform sample of up to capacity elements of a population, in a form that
+// can be merged with samples of disjoint populations (for example from other
+// threads, shards or processes) and written with file_writer.
+template <typename T>
+struct uniform_samples {
+  size_t capacity = 0;
+  size_t population = 0;
+  std::vector<T> items;
+
+  // Draws without replacement from the union of both populations: the next
+  // element comes from each side with probability proportional to the part
+  // of its population not yet drawn, and is then a uniform pick from that
+  // side's remaining items.
+  template <typename Generator>
+  void merge(uniform_samples other, Generator& ran) {
+    DVC_ASSERT_EQ(capacity, other.capacity);
+    std::array<std::vector<T>*, 2> sides = {&items, &other.items};
+    std::array<size_t, 2> remaining = {population, other.population};
+    std::vector<T> result;
+    result.reserve(std::min(capacity, population + other.population));
+    while (result.size() < capacity && remaining[0] + remaining[1] > 0) {
+      size_t pos = std::uniform_int_distribution<size_t>(
+          0, remaining[0] + remaining[1] - 1)(ran);
+      size_t i = pos < remaining[0] ? 0 : 1;
+      std::vector<T>& side = *sides[i];
+      size_t j = std::uniform_int_distribution<size_t>(0, side.size() - 1)(ran);
+      result.push_back(std::move(side[j]));
+      side[j] = std::move(side.back());
+      side.pop_back();
+      remaining[i]--;
+    }
+    population += other.population;
+    items = std::move(result);
+  }
+
+  template <typename Writer>
+  void write(Writer& writer) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writer.vwrite(capacity);
+    writer.vwrite(population);
+    writer.vwrite(items.size());
+    for (const T& t : items) writer.rwrite(t);
+  }
+
+  template <typename Reader>
+  static uniform_samples read(Reader& reader) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    uniform_samples samples;
+    samples.capacity = reader.vread();
+    samples.population = reader.vread();
+    samples.items.resize(reader.vread());
+    for (T& t : samples.items) t = reader.template rread<T>();
+    return samples;
+  }
+};
+
+// A weighted sample without replacement of up to capacity elements, stored
+// with their keys: log(weight) plus standard Gumbel noise.  The elements with
+// the capacity largest keys of a population are such a sample (A-Res), so
+// samples of disjoint populations merge by keeping the largest keys.
+template <typename T>
+struct keyed_samples {
+  size_t capacity = 0;
+  std::vector<std::pair<double, T>> items;
+
+  void merge(const keyed_samples& other) {
+    DVC_ASSERT_EQ(capacity, other.capacity);
+    items.insert(items.end(), other.items.begin(), other.items.end());
+    trim();
+  }
+
+  void trim() {
+    if (items.size() <= capacity) return;
+    std::nth_element(
+        items.begin(), items.begin() + capacity, items.end(),
+        [](const auto& a, const auto& b) { return a.first > b.first; });
+    items.resize(capacity);
+  }
+
+  std::vector<T> samples() const {
+    std::vector<T> result;
+    result.reserve(items.size());
+    for (const auto& [key, t] : items) result.push_back(t);
+    return result;
+  }
+
+  template <typename Writer>
+  void write(Writer& writer) const {
+    static_assert(std::is_trivially_copyable_v<T>);
+    writer.vwrite(capacity);
+    writer.vwrite(items.size());
+    for (const auto& [key, t] : items) {
+      writer.rwrite(key);
+      writer.rwrite(t);
+    }
+  }
+
+  template <typename Reader>
+  static keyed_samples read(Reader& reader) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    keyed_samples samples;
+    samples.capacity = reader.vread();
+    samples.items.resize(reader.vread());
+    for (auto& [key, t] : samples.items) {
+      key = reader.template rread<double>();
+      t = reader.template rread<T>();
+    }
+    return samples;
+  }
+};
+
+// A uniform random sample of nsamples elements of everything passed to
+// operator(), which may be called concurrently from any number of threads.
+//
+// Each thread fills its own fixed-size reservoir using Algorithm L (Li, 1994):
+// after the reservoir is full it draws a geometric count of elements to skip
+// before the next replacement, so most calls just decrement a counter.  The
+// per-thread reservoirs are merged into one uniform sample by snapshot() and
+// build_samples(), which must not run concurrently with operator().
 template <typename T, size_t nsamples>
 class sampler {
  public:
-  sampler() : next_population(0) {}
+  static_assert(nsamples > 0);
+
+  void operator()(const T& t) { shards_.local().add(t); }
+
+  size_t size() {
+    size_t population = 0;
+    shards_.for_each([&](shard& s) { population += s.population(); });
+    return population;
+  }
+
+  uniform_samples<T> snapshot() {
+    std::mt19937_64 ran(std::random_device{}());
+    uniform_samples<T> result{nsamples, 0, {}};
+    shards_.for_each([&](shard& s) {
+      result.merge({nsamples, s.population(),
+                    std::vector<T>(s.reservoir.begin(),
+                                   s.reservoir.begin() + s.reservoir_size())},
+                   ran);
+    });
+    return result;
+  }
+
+  std::vector<T> build_samples() {
+    std::vector<T> result = snapshot().items;
+    std::shuffle(result.begin(), result.end(),
+                 std::mt19937_64(std::random_device{}()));
+    return result;
+  }
+
+ private:
+  struct shard {
+    shard() : ran(std::random_device{}()) {}
+
+    void add(const T& t) {
+      size_t n = population_.load(std::memory_order_relaxed);
+      population_.store(n + 1, std::memory_order_relaxed);
+      if (n < nsamples) {
+        reservoir[n] = t;
+        if (n + 1 == nsamples) {
+          w = std::exp(std::log(random_unit(ran)) / nsamples);
+          draw_skip();
+        }
+      } else if (skip > 0) {
+        skip--;
+      } else {
+        reservoir[std::uniform_int_distribution<size_t>(0, nsamples - 1)(
+            ran)] = t;
+        w *= std::exp(std::log(random_unit(ran)) / nsamples);
+        draw_skip();
+      }
+    }
 
-  void operator()(T t) {
-    size_t population = ++next_population;
-    size_t pos = dis(ran, param(size_t(0), size_t(population - 1)));
-    if (pos < nsamples) {
-      std::lock_guard lock(mu);
-      if (population <= nsamples)
-        samples_[population] = std::pair(population - 1, t);
-      else
-        samples_[population] = std::pair(pos, t);
+    void draw_skip() {
+      double s = std::floor(std::log(random_unit(ran)) / std::log1p(-w));
+      skip = s < double(std::numeric_limits<size_t>::max() / 2)
+                 ? size_t(s)
+                 : std::numeric_limits<size_t>::max() / 2;
     }
+
+    size_t population() const {
+      return population_.load(std::memory_order_relaxed);
+    }
+
+    size_t reservoir_size() const { return std::min(population(), nsamples); }
+
+    std::array<T, nsamples> reservoir;
+    std::atomic_size_t population_ = 0;
+    size_t skip = 0;
+    double w = 0;
+    std::mt19937_64 ran;
+  };
+
+  per_thread<shard> shards_;
+};
+
+// A weighted reservoir of nsamples elements using A-ExpJ (Efraimidis and
+// Spirakis, 2006).  Each element gets the key log(u) / weight for a uniform
+// u, and the reservoir keeps the largest keys.  Once it is full, the total
+// weight to skip before the next insertion is drawn from the current minimum
+// key, so a skipped element costs one subtraction.
+template <typename T, size_t nsamples>
+class weighted_reservoir {
+ public:
+  weighted_reservoir() : ran(std::random_device{}()) {}
+
+  void add(const T& t, double weight) {
+    if (!(weight > 0)) return;
+    if (size_ < nsamples) {
+      heap_[size_++] = {std::log(random_unit(ran)) / weight, t};
+      std::push_heap(heap_.begin(), heap_.begin() + size_, greater_key);
+      if (size_ == nsamples) draw_skip();
+    } else if ((skip_weight_ -= weight) > 0) {
+      return;
+    } else {
+      double threshold = std::exp(heap_[0].first * weight);
+      double r = threshold + (1 - threshold) * random_unit(ran);
+      std::pop_heap(heap_.begin(), heap_.end(), greater_key);
+      heap_.back() = {std::log(r) / weight, t};
+      std::push_heap(heap_.begin(), heap_.end(), greater_key);
+      draw_skip();
+    }
+  }
+
+  // Divides all weights, past and future, by exp(log_factor).
+  void rescale(double log_factor) {
+    double factor = std::exp(log_factor);
+    for (size_t i = 0; i < size_; i++) heap_[i].first *= factor;
+    skip_weight_ /= factor;
+  }
+
+  void clear() { size_ = 0; }
+
+  // Adds the contents to samples, offsetting the keys by log_offset.
+  void export_to(keyed_samples<T>& samples, double log_offset = 0) const {
+    for (size_t i = 0; i < size_; i++)
+      samples.items.emplace_back(-std::log(-heap_[i].first) + log_offset,
+                                 heap_[i].second);
+    samples.trim();
+  }
+
+ private:
+  static bool greater_key(const std::pair<double, T>& a,
+                          const std::pair<double, T>& b) {
+    return a.first > b.first;
+  }
+
+  void draw_skip() {
+    skip_weight_ = std::log(random_unit(ran)) / heap_[0].first;
   }
 
-  size_t size() { return next_population; }
+  std::array<std::pair<double, T>, nsamples> heap_;
+  size_t size_ = 0;
+  double skip_weight_ = 0;
+  std::mt19937_64 ran;
+};
+
+// A weighted random sample without replacement of nsamples elements of
+// everything passed to operator(), where each element is chosen with
+// probability proportional to its weight.  Same threading rules as sampler.
+template <typename T, size_t nsamples>
+class weighted_sampler {
+ public:
+  static_assert(nsamples > 0);
+
+  void operator()(const T& t, double weight) {
+    shards_.local().add(t, weight);
+  }
+
+  keyed_samples<T> snapshot() {
+    keyed_samples<T> result{nsamples, {}};
+    shards_.for_each(
+        [&](weighted_reservoir<T, nsamples>& s) { s.export_to(result); });
+    return result;
+  }
 
   std::vector<T> build_samples() {
-    if (samples_.empty()) return {};
-    std::vector<T> result(nsamples);
-    for (const auto& [population, posnt] : samples_) {
-      const auto& [pos, t] = posnt;
-      result.at(pos) = t;
-    }
-    if (next_population < nsamples) result.resize(next_population);
-    std::shuffle(result.begin(), result.end(), ran);
+    std::vector<T> result = snapshot().samples();
+    std::shuffle(result.begin(), result.end(),
+                 std::mt19937_64(std::random_device{}()));
     return result;
   }
 
  private:
-  std::ranlux48_base ran;
-  std::uniform_int_distribution<size_t> dis;
-  using param = typename decltype(dis)::param_type;
-  std::atomic_size_t next_population;
-  std::mutex mu;
+  per_thread<weighted_reservoir<T, nsamples>> shards_;
+};
+
+// A time-decayed random sample of nsamples elements of everything passed to
+// operator(), where an element's weight doubles every half_life units of its
+// time (forward decay), and elements more than window units older than the
+// newest are excluded.  Same threading rules as sampler.
+//
+// The window is covered by nbuckets buckets per thread, each a weighted
+// reservoir, so memory stays bounded and the window boundary is exact to
+// within window / nbuckets.  Times should be roughly nondecreasing per thread;
+// an element older than its thread's current bucket is put in that bucket.
+template <typename T, size_t nsamples, size_t nbuckets = 16>
+class decayed_sampler {
+ public:
+  static_assert(nsamples > 0 && nbuckets > 0);
+
+  decayed_sampler(double half_life,
+                  double window = std::numeric_limits<double>::infinity())
+      : rate_(std::log(2.0) / half_life),
+        bucket_width_(window / nbuckets),
+        shards_([this] { return std::make_unique<shard>(rate_); }) {}
+
+  void operator()(const T& t, double time) {
+    shard& s = shards_.local();
+    int64_t bucket = bucket_of(time);
+    if (bucket > s.bucket) s.advance(bucket);
+    s.add(t, time);
+  }
+
+  keyed_samples<T> snapshot() {
+    int64_t newest = std::numeric_limits<int64_t>::min();
+    shards_.for_each([&](shard& s) { newest = std::max(newest, s.bucket); });
+    keyed_samples<T> result{nsamples, {}};
+    shards_.for_each([&](shard& s) { s.export_to(result, newest); });
+    return result;
+  }
+
+  std::vector<T> build_samples() {
+    std::vector<T> result = snapshot().samples();
+    std::shuffle(result.begin(), result.end(),
+                 std::mt19937_64(std::random_device{}()));
+    return result;
+  }
+
+ private:
+  int64_t bucket_of(double time) const {
+    return std::isinf(bucket_width_) ? 0 : int64_t(time / bucket_width_);
+  }
+
+  struct shard {
+    explicit shard(double rate) : rate(rate) {}
+
+    static size_t slot(int64_t b) {
+      return size_t((b % int64_t(nbuckets) + int64_t(nbuckets)) %
+                    int64_t(nbuckets));
+    }
+
+    void advance(int64_t to) {
+      for (int64_t b = std::max(bucket + 1, to - int64_t(nbuckets) + 1);
+           b <= to; b++)
+        buckets[slot(b)].clear();
+      bucket = to;
+    }
+
+    // Weights are exp(rate * (time - landmark)); the landmark moves forward
+    // whenever they would otherwise grow large enough to lose precision.
+    void add(const T& t, double time) {
+      if (!started) {
+        landmark = time;
+        started = true;
+      }
+      double exponent = rate * (time - landmark);
+      if (exponent > 32) {
+        for (auto& b : buckets) b.rescale(exponent);
+        landmark = time;
+        exponent = 0;
+      }
+      buckets[slot(bucket)].add(t, std::exp(exponent));
+    }
+
+    void export_to(keyed_samples<T>& samples, int64_t newest) const {
+      for (int64_t b = std::max(bucket - int64_t(nbuckets) + 1,
+                                newest - int64_t(nbuckets) + 1);
+           b <= bucket; b++)
+        buckets[slot(b)].export_to(samples, rate * landmark);
+    }
+
+    double rate;
+    double landmark = 0;
+    bool started = false;
+    int64_t bucket = std::numeric_limits<int64_t>::min() / 2;
+    std::array<weighted_reservoir<T, nsamples>, nbuckets> buckets;
+  };
 
-  std::map<size_t, std::pair<size_t, T>> samples_;
+  double rate_;
+  double bucket_width_;
+  per_thread<shard> shards_;
 };
 
 }  // namespace dvc
@@ -1,12 +1,32 @@
 #include "dvc/sampler.h"
 
+#include <thread>
+
+#include "dvc/container.h"
+#include "dvc/file.h"
 #include "dvc/log.h"
-#include "dvc/math.h"
 #include "dvc/program.h"
 
-int main(int argc, char** argv) {
-  dvc::program program(argc, argv);
+void check_samples(std::vector<size_t> samples, size_t n) {
+  DVC_ASSERT_EQ(samples.size(), 500u);
+
+  size_t total = 0;
+  for (size_t sample : samples) {
+    DVC_ASSERT_LT(sample, n);
+    total += sample;
+  }
 
+  size_t avg = total / size_t(500);
+
+  DVC_ASSERT_GT(avg, n / 2 - n / 25);
+  DVC_ASSERT_LT(avg, n / 2 + n / 25);
+
+  dvc::sort(samples);
+  DVC_ASSERT(std::adjacent_find(samples.begin(), samples.end()) ==
+             samples.end());
+}
+
+void test_single_thread() {
   dvc::sampler<size_t, 500> sampler;
 
   size_t n = (size_t(1) << 28);
@@ -14,25 +34,147 @@ int main(int argc, char** argv) {
   size_t start = dvc::now();
   for (size_t i = 0; i < n; i++) {
     sampler(i);
-    //    if (dvc::is_pow2(i)) {
-    //      DVC_DUMP(i);
-    //      DVC_DUMP(sampler.samples_.size());
-    //    }
   }
   size_t end = dvc::now();
 
-  DVC_LOG((end - start) / n, "ns");
+  DVC_LOG(double(end - start) / n, "ns");
+
+  DVC_ASSERT_EQ(sampler.size(), n);
+  check_samples(sampler.build_samples(), n);
+}
+
+void test_threads(size_t nthreads) {
+  dvc::sampler<size_t, 500> sampler;
+
+  size_t n = (size_t(1) << 28);
+
+  size_t start = dvc::now();
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < nthreads; t++)
+    threads.emplace_back([&, t] {
+      for (size_t i = t; i < n; i += nthreads) sampler(i);
+    });
+  for (std::thread& thread : threads) thread.join();
+  size_t end = dvc::now();
+
+  DVC_LOG(nthreads, " threads: ", double(end - start) / n, "ns");
+
+  DVC_ASSERT_EQ(sampler.size(), n);
+  check_samples(sampler.build_samples(), n);
+}
+
+void test_small() {
+  dvc::sampler<int, 500> sampler;
+  DVC_ASSERT(sampler.build_samples().empty());
+  for (int i = 0; i < 100; i++) sampler(i);
+  std::vector<int> samples = sampler.build_samples();
+  DVC_ASSERT_EQ(samples.size(), 100u);
+  dvc::sort(samples);
+  for (int i = 0; i < 100; i++) DVC_ASSERT_EQ(samples[i], i);
+}
+
+void test_weighted() {
+  dvc::weighted_sampler<size_t, 500> sampler;
+
+  size_t n = (size_t(1) << 26);
+
+  size_t start = dvc::now();
+  for (size_t i = 0; i < n; i++) {
+    sampler(i, i % 2 ? 9.0 : 1.0);
+  }
+  size_t end = dvc::now();
+
+  DVC_LOG("weighted: ", double(end - start) / n, "ns");
+
+  std::vector<size_t> samples = sampler.build_samples();
+  DVC_ASSERT_EQ(samples.size(), 500u);
+  size_t heavy = 0;
+  for (size_t sample : samples) heavy += sample % 2;
+  DVC_ASSERT_GT(heavy, 425u);
+  DVC_ASSERT_LT(heavy, 475u);
+}
+
+void test_decayed() {
+  size_t n = (size_t(1) << 24);
+
+  dvc::decayed_sampler<size_t, 500> sampler(n / 8);
+  size_t start = dvc::now();
+  for (size_t i = 0; i < n; i++) {
+    sampler(i, i);
+  }
+  size_t end = dvc::now();
+
+  DVC_LOG("decayed: ", double(end - start) / n, "ns");
 
   std::vector<size_t> samples = sampler.build_samples();
+  DVC_ASSERT_EQ(samples.size(), 500u);
+  size_t recent = 0;
+  for (size_t sample : samples) recent += sample >= n - n / 4;
+  DVC_ASSERT_GT(recent, 325u);
+  DVC_ASSERT_LT(recent, 425u);
+}
 
+void test_window() {
+  size_t n = (size_t(1) << 24);
+
+  dvc::decayed_sampler<size_t, 500> sampler(1e300, n / 4);
+  for (size_t i = 0; i < n; i++) {
+    sampler(i, i);
+  }
+
+  size_t window_start = n - n / 4;
+  std::vector<size_t> samples = sampler.build_samples();
+  DVC_ASSERT_EQ(samples.size(), 500u);
   size_t total = 0;
   for (size_t sample : samples) {
-    DVC_DUMP(sample);
-    total += sample;
+    DVC_ASSERT_GE(sample, window_start);
+    total += sample - window_start;
   }
+  size_t avg = total / 500;
+  DVC_ASSERT_GT(avg, n / 8 - n / 80);
+  DVC_ASSERT_LT(avg, n / 8 + n / 80);
+}
 
-  size_t avg = total / size_t(500);
+void test_merge() {
+  size_t n = (size_t(1) << 22);
+
+  dvc::sampler<size_t, 500> low, high;
+  for (size_t i = 0; i < n; i++) (i < n / 4 ? low : high)(i);
+
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "sampler_test.samples";
+  {
+    dvc::file_writer writer(path, dvc::truncate);
+    high.snapshot().write(writer);
+  }
+  dvc::file_reader reader(path);
+  auto high_samples = dvc::uniform_samples<size_t>::read(reader);
+  std::filesystem::remove(path);
+  DVC_ASSERT_EQ(high_samples.population, n - n / 4);
+
+  auto samples = low.snapshot();
+  std::mt19937_64 ran;
+  samples.merge(std::move(high_samples), ran);
+  DVC_ASSERT_EQ(samples.population, n);
+  check_samples(samples.items, n);
+
+  dvc::weighted_sampler<size_t, 500> wlow, whigh;
+  for (size_t i = 0; i < n; i++) (i < n / 2 ? wlow : whigh)(i, 1.0);
+  auto keyed = wlow.snapshot();
+  keyed.merge(whigh.snapshot());
+  check_samples(keyed.samples(), n);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
 
-  DVC_ASSERT_GT(avg, size_t(134217728) - size_t(10000000));
-  DVC_ASSERT_LT(avg, size_t(134217728) + size_t(10000000));
+  test_small();
+  test_single_thread();
+  for (size_t nthreads = 1; nthreads <= 2 * std::thread::hardware_concurrency();
+       nthreads *= 2)
+    test_threads(nthreads);
+  test_weighted();
+  test_decayed();
+  test_window();
+  test_merge();
 }
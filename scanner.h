@@ -1,6 +1,12 @@
 #pragma once
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 #include "dvc/log.h"
 
@@ -46,4 +52,237 @@ class scanner {
   size_t line_ = 0;
 };
 
+// A set of chars, usable in constant expressions:
+//
+//    constexpr char_class digits = char_class::range('0', '9');
+//    constexpr char_class sign("+-");
+//
+// Sets made of at most max_ranges contiguous ranges are scanned 16 bytes at a
+// time with SSE2; others fall back to a table lookup per byte.
+class char_class {
+ public:
+  static constexpr int max_ranges = 8;
+
+  constexpr char_class() {}
+
+  constexpr char_class(std::string_view chars) {
+    for (char c : chars) set(uint8_t(c));
+    finish();
+  }
+
+  static constexpr char_class range(char first, char last) {
+    char_class result;
+    for (int c = uint8_t(first); c <= uint8_t(last); c++) result.set(c);
+    result.finish();
+    return result;
+  }
+
+  constexpr bool contains(char c) const {
+    return (bits_[uint8_t(c) / 64] >> (uint8_t(c) % 64)) & 1;
+  }
+
+  constexpr char_class operator|(const char_class& other) const {
+    char_class result;
+    for (int i = 0; i < 4; i++) result.bits_[i] = bits_[i] | other.bits_[i];
+    result.finish();
+    return result;
+  }
+
+  constexpr char_class operator~() const {
+    char_class result;
+    for (int i = 0; i < 4; i++) result.bits_[i] = ~bits_[i];
+    result.finish();
+    return result;
+  }
+
+  // Returns the first position in [begin, end) whose char's membership is not
+  // `in`, or end.
+  const char* skip(const char* begin, const char* end, bool in) const;
+
+ private:
+  constexpr void set(int c) { bits_[c / 64] |= uint64_t(1) << (c % 64); }
+
+  constexpr void finish() {
+    nranges_ = 0;
+    for (int c = 0; c < 256;) {
+      if (!contains(char(c))) {
+        c++;
+        continue;
+      }
+      int first = c;
+      while (c < 256 && contains(char(c))) c++;
+      if (nranges_ == max_ranges) {
+        nranges_ = -1;
+        return;
+      }
+      ranges_[nranges_++] = {uint8_t(first), uint8_t(c - 1)};
+    }
+  }
+
+  uint64_t bits_[4] = {};
+  struct char_range {
+    uint8_t first = 0;
+    uint8_t last = 0;
+  };
+  char_range ranges_[max_ranges] = {};
+  int nranges_ = 0;
+};
+
+inline constexpr char_class whitespace_chars(" \t\n\v\f\r");
+inline constexpr char_class identifier_start_chars =
+    char_class::range('a', 'z') | char_class::range('A', 'Z') |
+    char_class("_");
+inline constexpr char_class identifier_chars =
+    identifier_start_chars | char_class::range('0', '9');
+
+inline const char* char_class::skip(const char* begin, const char* end,
+                                    bool in) const {
+  const char* p = begin;
+#if defined(__SSE2__)
+  if (nranges_ >= 0) {
+    __m128i firsts[max_ranges], spans[max_ranges];
+    for (int i = 0; i < nranges_; i++) {
+      firsts[i] = _mm_set1_epi8(char(ranges_[i].first));
+      spans[i] = _mm_set1_epi8(char(ranges_[i].last - ranges_[i].first));
+    }
+    for (; end - p >= 16; p += 16) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i member = _mm_setzero_si128();
+      for (int i = 0; i < nranges_; i++) {
+        // Unsigned x - first <= last - first.
+        __m128i offset = _mm_sub_epi8(x, firsts[i]);
+        member = _mm_or_si128(
+            member, _mm_cmpeq_epi8(_mm_max_epu8(offset, spans[i]), spans[i]));
+      }
+      unsigned mask = _mm_movemask_epi8(member);
+      if (in) mask = ~mask & 0xFFFF;
+      if (mask) return p + __builtin_ctz(mask);
+    }
+  }
+#endif
+  while (p != end && contains(*p) == in) p++;
+  return p;
+}
+
+namespace scanner_detail {
+
+inline size_t count_newlines(const char* begin, const char* end) {
+  size_t n = 0;
+  const char* p = begin;
+#if defined(__SSE2__)
+  const __m128i newline = _mm_set1_epi8('\n');
+  for (; end - p >= 16; p += 16) {
+    __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    n += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(x, newline)));
+  }
+#endif
+  for (; p != end; p++) n += *p == '\n';
+  return n;
+}
+
+}  // namespace scanner_detail
+
+// A scanner over borrowed data, such as a std::string that outlives it or a
+// mapped_file, with bulk operations that skip runs of chars 16 at a time.
+//
+// Line numbers are not tracked while scanning; line() counts newlines before
+// pos() when asked, incrementally from the previous call.
+class scanner_view {
+ public:
+  scanner_view(const std::string& filename, std::string_view data)
+      : filename(filename), data(data) {}
+
+  static constexpr char eof = 0;
+
+  char peek(size_t offset = 0) const {
+    return pos_ + offset < data.size() ? data[pos_ + offset] : eof;
+  }
+
+  char pop() {
+    char c = peek();
+    incr();
+    return c;
+  }
+
+  size_t pos() const { return pos_; }
+  void pos(size_t pos) { pos_ = pos; }
+
+  void incr(size_t offset = 1) {
+    pos_ += offset;
+    DVC_ASSERT_LE(pos(), data.size(), "unexpected end of file ", filename);
+  }
+
+  bool at_end() const { return pos_ == data.size(); }
+  std::string_view rest() const { return data.substr(pos_); }
+  std::string_view get_data() const { return data; }
+
+  // The zero-based line of pos().
+  size_t line() const {
+    if (pos_ >= line_pos_)
+      line_ += scanner_detail::count_newlines(data.data() + line_pos_,
+                                              data.data() + pos_);
+    else
+      line_ -= scanner_detail::count_newlines(data.data() + pos_,
+                                              data.data() + line_pos_);
+    line_pos_ = pos_;
+    return line_;
+  }
+
+  // The zero-based column of pos().
+  size_t column() const {
+    size_t newline = data.rfind('\n', pos_ == 0 ? 0 : pos_ - 1);
+    if (pos_ == 0 || newline == std::string_view::npos) return pos_;
+    return pos_ - newline - 1;
+  }
+
+  // Advances past chars in chars, returning them.
+  std::string_view skip_while(const char_class& chars) {
+    return advance_to(chars.skip(current(), end(), true));
+  }
+
+  // Advances to the next char in chars (or the end), returning the chars
+  // skipped.
+  std::string_view skip_until(const char_class& chars) {
+    return advance_to(chars.skip(current(), end(), false));
+  }
+
+  // The position of the next char in chars at or after pos(), or npos.
+  size_t find_any_of(const char_class& chars) const {
+    const char* p = chars.skip(current(), end(), false);
+    return p == end() ? std::string_view::npos : p - data.data();
+  }
+
+  std::string_view skip_whitespace() { return skip_while(whitespace_chars); }
+
+  // Scans [A-Za-z_][A-Za-z0-9_]*, or returns an empty view if pos() is not at
+  // the start of an identifier.
+  std::string_view scan_identifier() {
+    if (!identifier_start_chars.contains(peek())) return {};
+    return advance_to(identifier_chars.skip(current() + 1, end(), true));
+  }
+
+  // Advances past literal if the data at pos() starts with it.
+  bool consume(std::string_view literal) {
+    if (data.substr(pos_, literal.size()) != literal) return false;
+    pos_ += literal.size();
+    return true;
+  }
+
+ private:
+  const char* current() const { return data.data() + pos_; }
+  const char* end() const { return data.data() + data.size(); }
+
+  std::string_view advance_to(const char* p) {
+    std::string_view skipped(current(), p - current());
+    pos_ = p - data.data();
+    return skipped;
+  }
+
+  std::string filename;
+  std::string_view data;
+  size_t pos_ = 0;
+  mutable size_t line_pos_ = 0;
+  mutable size_t line_ = 0;
+};
+
 }  // namespace dvc
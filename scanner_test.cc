@@ -0,0 +1,167 @@
+#include "dvc/scanner.h"
+
+#include <random>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/program.h"
+
+// A config-like input: "name = value" lines with comments and indentation.
+std::string make_input(size_t nlines) {
+  std::mt19937_64 ran;
+  std::string input;
+  for (size_t i = 0; i < nlines; i++) {
+    input.append(ran() % 8, ' ');
+    if (ran() % 5 == 0) {
+      input += "# a comment about setting number ";
+      input += std::to_string(i);
+    } else {
+      input += "setting_" + std::to_string(ran() % 1000) + "_name";
+      input += "  =  ";
+      input += std::to_string(ran());
+    }
+    input += '\n';
+  }
+  return input;
+}
+
+struct counts {
+  size_t identifiers = 0;
+  size_t identifier_chars = 0;
+  size_t numbers = 0;
+  size_t lines = 0;
+
+  bool operator==(const counts& o) const {
+    return identifiers == o.identifiers &&
+           identifier_chars == o.identifier_chars && numbers == o.numbers &&
+           lines == o.lines;
+  }
+};
+
+counts scan_per_char(const std::string& input) {
+  dvc::scanner s("input", input);
+  counts c;
+  while (s.pos() < input.size()) {
+    char ch = s.peek();
+    if (ch == '#') {
+      while (s.peek() != '\n') s.incr();
+    } else if (std::isalpha(ch) || ch == '_') {
+      c.identifiers++;
+      while (std::isalnum(s.peek()) || s.peek() == '_') {
+        c.identifier_chars++;
+        s.incr();
+      }
+    } else if (std::isdigit(ch)) {
+      c.numbers++;
+      while (std::isdigit(s.peek())) s.incr();
+    } else {
+      if (ch == '\n') c.lines++;
+      s.incr();
+    }
+  }
+  return c;
+}
+
+counts scan_bulk(std::string_view input) {
+  constexpr dvc::char_class digits = dvc::char_class::range('0', '9');
+  constexpr dvc::char_class newline("\n");
+  dvc::scanner_view s("input", input);
+  counts c;
+  while (!s.at_end()) {
+    s.skip_whitespace();
+    char ch = s.peek();
+    if (ch == '#') {
+      s.skip_until(newline);
+    } else if (std::string_view id = s.scan_identifier(); !id.empty()) {
+      c.identifiers++;
+      c.identifier_chars += id.size();
+    } else if (digits.contains(ch)) {
+      c.numbers++;
+      s.skip_while(digits);
+    } else if (!s.at_end()) {
+      s.incr();
+    }
+  }
+  c.lines = s.line();
+  return c;
+}
+
+void test_equivalence() {
+  std::string input = make_input(1000000);
+
+  size_t start = dvc::now();
+  counts per_char = scan_per_char(input);
+  size_t middle = dvc::now();
+  counts bulk = scan_bulk(input);
+  size_t end = dvc::now();
+
+  DVC_LOG("scanner per char: ", double(middle - start) / input.size(),
+          "ns/byte");
+  DVC_LOG("scanner_view bulk: ", double(end - middle) / input.size(),
+          "ns/byte");
+  DVC_ASSERT(per_char == bulk);
+  DVC_ASSERT_EQ(bulk.lines, 1000000u);
+}
+
+void test_char_class() {
+  constexpr dvc::char_class hex =
+      dvc::char_class::range('0', '9') | dvc::char_class("abcdefABCDEF");
+  static_assert(hex.contains('7') && hex.contains('f') && !hex.contains('g'));
+  static_assert(!(~hex).contains('a') && (~hex).contains('\0'));
+
+  // More than max_ranges ranges takes the table path.
+  dvc::char_class sparse("acegikmoqsuwy");
+  std::string data(100, 'a');
+  data[70] = 'b';
+  dvc::scanner_view s("data", data);
+  DVC_ASSERT_EQ(s.skip_while(sparse).size(), 70u);
+  DVC_ASSERT_EQ(s.find_any_of(dvc::char_class("z")), std::string::npos);
+  DVC_ASSERT_EQ(s.skip_while(dvc::whitespace_chars).size(), 0u);
+  for (size_t i = 0; i < 256; i++) {
+    std::string one(40, char(i));
+    one[33] = char(i + 1);
+    dvc::scanner_view t("one", one);
+    DVC_ASSERT_EQ(t.skip_while(dvc::char_class(std::string(1, char(i)))).size(),
+                  33u);
+  }
+}
+
+void test_lines() {
+  std::string data = "ab\ncd\n\nefgh\n";
+  dvc::scanner_view s("data", data);
+  s.pos(4);
+  DVC_ASSERT_EQ(s.line(), 1u);
+  DVC_ASSERT_EQ(s.column(), 1u);
+  s.pos(8);
+  DVC_ASSERT_EQ(s.line(), 3u);
+  DVC_ASSERT_EQ(s.column(), 1u);
+  s.pos(1);
+  DVC_ASSERT_EQ(s.line(), 0u);
+  DVC_ASSERT_EQ(s.column(), 1u);
+  DVC_ASSERT(s.consume("b\nc"));
+  DVC_ASSERT_EQ(s.line(), 1u);
+}
+
+void test_mapped_file() {
+  std::filesystem::path path =
+      std::filesystem::temp_directory_path() / "scanner_test.txt";
+  std::string input = make_input(1000);
+  dvc::save_file(path, input);
+  {
+    dvc::mapped_file file(path);
+    DVC_ASSERT_EQ(file.data(), input);
+    DVC_ASSERT(scan_bulk(file.data()) == scan_per_char(input));
+  }
+  dvc::save_file(path, "");
+  DVC_ASSERT_EQ(dvc::mapped_file(path).size(), 0u);
+  std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_char_class();
+  test_lines();
+  test_mapped_file();
+  test_equivalence();
+}
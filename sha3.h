@@ -2,6 +2,8 @@
 
 #include <array>
 #include <cstring>
+#include <string>
+#include <string_view>
 #include <vector>
 
 static_assert(sizeof(size_t) == sizeof(unsigned long long int));
@@ -1,57 +1,293 @@
 #pragma once
 
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <memory_resource>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace dvc {
 
+namespace string_detail {
+
+template <typename T>
+constexpr bool is_char_v = std::is_same_v<T, char> ||
+                           std::is_same_v<T, signed char> ||
+                           std::is_same_v<T, unsigned char>;
+
+// One argument of concat, formatted as std::ostream would with default flags:
+// strings and characters are viewed or copied directly, numbers go through
+// std::to_chars, and only other types are streamed.
+class formatted {
+ public:
+  template <typename T>
+  explicit formatted(const T& t) {
+    if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+      view_ = t;
+    } else if constexpr (is_char_v<T>) {
+      buffer_[0] = char(t);
+      view_ = {buffer_, 1};
+    } else if constexpr (std::is_same_v<T, bool>) {
+      view_ = t ? "1" : "0";
+    } else if constexpr (std::is_integral_v<T>) {
+      view_ = {buffer_, size_t(std::to_chars(buffer_, std::end(buffer_), t).ptr -
+                               buffer_)};
+    } else if constexpr (std::is_floating_point_v<T>) {
+      // The stream default is %g with precision 6.
+      view_ = {buffer_,
+               size_t(std::to_chars(buffer_, std::end(buffer_), t,
+                                    std::chars_format::general, 6)
+                          .ptr -
+                      buffer_)};
+    } else {
+      std::ostringstream o;
+      o << t;
+      streamed_ = o.str();
+      view_ = streamed_;
+    }
+  }
+
+  formatted(const formatted&) = delete;
+  formatted& operator=(const formatted&) = delete;
+
+  std::string_view view() const { return view_; }
+
+ private:
+  std::string_view view_;
+  char buffer_[32];
+  std::string streamed_;
+};
+
+}  // namespace string_detail
+
+// Appends args to out as if streamed to it, with one reallocation at most.
+template <typename... Args>
+void append_concat(std::string& out, const Args&... args) {
+  if constexpr (sizeof...(Args) > 0) {
+    const string_detail::formatted pieces[] = {
+        string_detail::formatted(args)...};
+    size_t size = out.size();
+    for (const auto& piece : pieces) size += piece.view().size();
+    out.reserve(size);
+    for (const auto& piece : pieces) out += piece.view();
+  }
+}
+
 inline std::string concat() { return ""; }
 
 template <typename... Args>
 inline std::string concat(Args&&... args) {
-  std::ostringstream o;
-  (o << ... << std::forward<Args>(args));
-  return o.str();
+  std::string result;
+  append_concat(result, args...);
+  return result;
 }
 
+// Parses all of s into t as if streamed from it: leading whitespace and a '+'
+// sign are accepted.  Arithmetic types use std::from_chars and other types
+// their operator>>.
 template <typename T>
-[[nodiscard]] bool destring(const std::string& s, T& t) {
-  std::istringstream i(s);
-  i >> t;
-  return (!i.fail() && i.eof());
+[[nodiscard]] bool destring(std::string_view s, T& t) {
+  if constexpr (std::is_arithmetic_v<T> && !std::is_same_v<T, bool> &&
+                !string_detail::is_char_v<T>) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s[0])))
+      s.remove_prefix(1);
+    if (s.size() > 1 && s[0] == '+' && s[1] != '-') s.remove_prefix(1);
+    const char* end = s.data() + s.size();
+    auto [ptr, ec] = std::from_chars(s.data(), end, t);
+    return ec == std::errc() && ptr == end && !s.empty();
+  } else {
+    std::istringstream i{std::string(s)};
+    i >> t;
+    return (!i.fail() && i.eof());
+  }
 }
 
-[[nodiscard]] inline bool destring(const std::string& s, std::string& t) {
+[[nodiscard]] inline bool destring(std::string_view s, std::string& t) {
   t = s;
   return true;
 }
 
+// The position of the first needle in haystack at or after pos, or npos, as
+// std::string_view::find.  Candidates are found 16 at a time by matching the
+// first and last bytes of needle.
+inline size_t find_string(std::string_view haystack, std::string_view needle,
+                          size_t pos = 0) {
+  size_t n = needle.size();
+  if (n == 0) return pos <= haystack.size() ? pos : std::string_view::npos;
+  if (pos >= haystack.size() || haystack.size() - pos < n)
+    return std::string_view::npos;
+  const char* data = haystack.data();
+  if (n == 1) {
+    const void* p = std::memchr(data + pos, needle[0], haystack.size() - pos);
+    return p ? static_cast<const char*>(p) - data : std::string_view::npos;
+  }
+  size_t last = haystack.size() - n;  // the last possible match
+#if defined(__SSE2__)
+  const __m128i first_byte = _mm_set1_epi8(needle[0]);
+  const __m128i last_byte = _mm_set1_epi8(needle[n - 1]);
+  for (; pos + 16 <= last + 1; pos += 16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+    __m128i b = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(data + pos + n - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+        _mm_cmpeq_epi8(a, first_byte), _mm_cmpeq_epi8(b, last_byte)));
+    while (mask) {
+      size_t i = pos + __builtin_ctz(mask);
+      if (std::memcmp(data + i + 1, needle.data() + 1, n - 2) == 0) return i;
+      mask &= mask - 1;
+    }
+  }
+#endif
+  return haystack.find(needle, pos);
+}
+
+// A lazy forward range of the pieces of joined between occurrences of sep,
+// as std::string_views into joined.  Like split, an empty joined is one empty
+// piece and adjacent separators give empty pieces.  sep must not be empty.
+class split_view {
+ public:
+  split_view(std::string_view sep, std::string_view joined)
+      : sep_(sep), joined_(joined) {}
+
+  class iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = const std::string_view&;
+
+    iterator() = default;
+
+    reference operator*() const { return piece_; }
+    pointer operator->() const { return &piece_; }
+
+    iterator& operator++() {
+      if (next_ == std::string_view::npos) {
+        view_ = nullptr;
+      } else {
+        advance(next_);
+      }
+      return *this;
+    }
+
+    iterator operator++(int) {
+      iterator old = *this;
+      ++*this;
+      return old;
+    }
+
+    bool operator==(const iterator& o) const {
+      return view_ == o.view_ && (!view_ || piece_.data() == o.piece_.data());
+    }
+    bool operator!=(const iterator& o) const { return !(*this == o); }
+
+   private:
+    friend class split_view;
+
+    explicit iterator(const split_view* view) : view_(view) { advance(0); }
+
+    void advance(size_t pos) {
+      std::string_view joined = view_->joined_;
+      std::string_view sep = view_->sep_;
+      size_t end = sep.size() == 1 ? joined.find(sep[0], pos)
+                                   : find_string(joined, sep, pos);
+      if (end == std::string_view::npos) {
+        piece_ = joined.substr(pos);
+        next_ = std::string_view::npos;
+      } else {
+        piece_ = joined.substr(pos, end - pos);
+        next_ = end + sep.size();
+      }
+    }
+
+    const split_view* view_ = nullptr;
+    std::string_view piece_;
+    size_t next_ = 0;  // where the next piece starts, or npos after the last
+  };
+
+  iterator begin() const { return iterator(this); }
+  iterator end() const { return iterator(); }
+
+ private:
+  std::string_view sep_;
+  std::string_view joined_;
+};
+
+// Appends the pieces of joined to out.  The pieces view joined.
+inline void append_split(std::vector<std::string_view>& out,
+                         std::string_view sep, std::string_view joined) {
+  for (std::string_view piece : split_view(sep, joined)) out.push_back(piece);
+}
+
 inline std::vector<std::string> split(const std::string& sep,
                                       const std::string& joined) {
   std::vector<std::string> result;
-  size_t pos = 0;
-  while (true) {
-    size_t next_pos = joined.find(sep, pos);
-    if (next_pos == std::string::npos) {
-      result.push_back(joined.substr(pos));
-      return result;
+  for (std::string_view piece : split_view(sep, joined))
+    result.emplace_back(piece);
+  return result;
+}
+
+// Strings and vectors that allocate from a memory resource such as a
+// dvc::arena.
+using pmr_string = std::pmr::string;
+template <typename T>
+using pmr_vector = std::pmr::vector<T>;
+
+inline pmr_vector<pmr_string> split(const std::string& sep,
+                                    std::string_view joined,
+                                    std::pmr::memory_resource* resource) {
+  pmr_vector<pmr_string> result(resource);
+  for (std::string_view piece : split_view(sep, joined))
+    result.emplace_back(piece);
+  return result;
+}
+
+// Appends the elements of container to out separated by sep.  Elements
+// convertible to std::string_view are appended after a single reserve;
+// anything else is formatted as by append_concat.
+template <typename Container>
+void append_join(std::string& out, std::string_view sep,
+                 const Container& container) {
+  using element = decltype(*std::begin(container));
+  if constexpr (std::is_convertible_v<element, std::string_view>) {
+    size_t size = 0;
+    size_t n = 0;
+    for (const auto& e : container) {
+      size += std::string_view(e).size();
+      n++;
+    }
+    out.reserve(out.size() + size + (n ? (n - 1) * sep.size() : 0));
+    bool first = true;
+    for (const auto& e : container) {
+      if (!first) out += sep;
+      out += std::string_view(e);
+      first = false;
+    }
+  } else {
+    bool first = true;
+    for (const auto& element : container) {
+      if (!first) out += sep;
+      out += string_detail::formatted(element).view();
+      first = false;
     }
-    result.push_back(joined.substr(pos, next_pos - pos));
-    pos = next_pos + sep.size();
   }
 }
 
 template <typename Container>
 inline std::string join(const std::string& sep, const Container& container) {
-  std::ostringstream oss;
-  bool first = true;
-  for (const auto& element : container) {
-    if (!first) oss << sep;
-    oss << element;
-    first = false;
-  }
-  return oss.str();
+  std::string result;
+  append_join(result, sep, container);
+  return result;
 }
 
 constexpr bool startswith(std::string_view subject, std::string_view prefix) {
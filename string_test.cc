@@ -1,9 +1,227 @@
 #include "dvc/string.h"
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <random>
+
 #include "dvc/log.h"
 
-int main() {
+void test_destring() {
   int x;
   DVC_ASSERT(dvc::destring("42", x));
   DVC_ASSERT_EQ(x, 42);
+  DVC_ASSERT(dvc::destring("  +7", x));
+  DVC_ASSERT_EQ(x, 7);
+  DVC_ASSERT(!dvc::destring("7 ", x));
+  DVC_ASSERT(!dvc::destring("+-7", x));
+  DVC_ASSERT(!dvc::destring("", x));
+  DVC_ASSERT(!dvc::destring("99999999999", x));
+  uint8_t small;
+  DVC_ASSERT(!dvc::destring("256", small));
+  double d;
+  DVC_ASSERT(dvc::destring("-1.5e3", d));
+  DVC_ASSERT_EQ(d, -1500);
+  bool b;
+  DVC_ASSERT(dvc::destring("1", b) && b);
+  std::string str;
+  DVC_ASSERT(dvc::destring(" a b", str));
+  DVC_ASSERT_EQ(str, " a b");
+}
+
+enum class color { red, green };
+std::ostream& operator<<(std::ostream& o, color c) {
+  return o << (c == color::red ? "red" : "green");
+}
+
+template <typename... Args>
+std::string stream_concat(const Args&... args) {
+  std::ostringstream o;
+  (o << ... << args);
+  return o.str();
+}
+
+void test_concat() {
+  std::mt19937_64 ran;
+  for (int i = 0; i < 10000; i++) {
+    uint64_t bits = ran();
+    double d;
+    std::memcpy(&d, &bits, sizeof(d));
+    double scaled = double(int64_t(ran())) / double(ran() >> (ran() % 64));
+    float f = float(scaled);
+    int64_t n = int64_t(ran()) >> (ran() % 64);
+    DVC_ASSERT_EQ(dvc::concat(d, " ", scaled, f, n, uint32_t(n)),
+                  stream_concat(d, " ", scaled, f, n, uint32_t(n)));
+  }
+  std::string s = "str";
+  std::string_view v = "view";
+  DVC_ASSERT_EQ(dvc::concat(s, v, 'c', (unsigned char)'u', true, color::green,
+                            std::filesystem::path("a/b"), 0.1, 1e100, -0.0),
+                "strviewcu1green\"a/b\"0.11e+100-0");
+  DVC_ASSERT_EQ(dvc::concat(), "");
+  std::string out = "x=";
+  dvc::append_concat(out, 1, '+', 2.5);
+  DVC_ASSERT_EQ(out, "x=1+2.5");
+}
+
+void test_find_string() {
+  std::mt19937_64 ran;
+  for (int i = 0; i < 10000; i++) {
+    std::string haystack, needle;
+    for (size_t j = 0, n = ran() % 80; j < n; j++) haystack += 'a' + ran() % 3;
+    for (size_t j = 0, n = ran() % 5; j < n; j++) needle += 'a' + ran() % 3;
+    size_t pos = ran() % 100;
+    DVC_ASSERT_EQ(dvc::find_string(haystack, needle, pos),
+                  std::string_view(haystack).find(needle, pos), haystack, " ",
+                  needle, " ", pos);
+  }
+}
+
+void test_split() {
+  for (std::string joined : {"", ",", "a", "a,,bc,", ",a,b,c"}) {
+    std::vector<std::string_view> pieces;
+    dvc::append_split(pieces, ",", joined);
+    DVC_ASSERT_EQ(dvc::join(",", pieces), joined);
+    DVC_ASSERT_EQ(pieces.size(), size_t(std::count(joined.begin(),
+                                                    joined.end(), ',') + 1));
+  }
+  std::vector<std::string> parts = dvc::split("::", "a::b:::c::");
+  DVC_ASSERT_EQ(parts.size(), 4u);
+  DVC_ASSERT_EQ(parts[2], ":c");
+  DVC_ASSERT_EQ(parts[3], "");
+  DVC_ASSERT_EQ(dvc::join(", ", std::vector<int>{1, 2, 3}), "1, 2, 3");
+  DVC_ASSERT_EQ(dvc::join(",", std::vector<double>{0.5, 1e20}), "0.5,1e+20");
+  DVC_ASSERT_EQ(dvc::join("", std::vector<char>{'a', 'b'}), "ab");
+  DVC_ASSERT_EQ(dvc::join(" ", std::vector<std::filesystem::path>{"a", "b"}),
+                "\"a\" \"b\"");
+  std::string out = "x=";
+  dvc::append_join(out, "+", std::vector<std::string>{"a", "b"});
+  DVC_ASSERT_EQ(out, "x=a+b");
+}
+
+// The ostringstream-based join this replaces, for comparison.
+template <typename Container>
+std::string stream_join(const std::string& sep, const Container& container) {
+  std::ostringstream oss;
+  bool first = true;
+  for (const auto& element : container) {
+    if (!first) oss << sep;
+    oss << element;
+    first = false;
+  }
+  return oss.str();
+}
+
+void benchmark_numbers() {
+  constexpr int n = 200000;
+  std::vector<double> values;
+  std::mt19937_64 ran;
+  for (int i = 0; i < n; i++) values.push_back(double(ran() % 1000000) / 7);
+
+  size_t t0 = dvc::now();
+  size_t streamed = 0;
+  for (int i = 0; i < n; i++)
+    streamed += stream_concat("value ", i, " of ", n, " is ", values[i]).size();
+  size_t t1 = dvc::now();
+  size_t formatted = 0;
+  for (int i = 0; i < n; i++)
+    formatted += dvc::concat("value ", i, " of ", n, " is ", values[i]).size();
+  size_t t2 = dvc::now();
+  DVC_ASSERT_EQ(streamed, formatted);
+
+  std::vector<std::string> numbers;
+  for (int i = 0; i < n; i++) numbers.push_back(std::to_string(ran() % n));
+  size_t t3 = dvc::now();
+  int64_t istream_sum = 0;
+  for (const std::string& number : numbers) {
+    std::istringstream in(number);
+    int64_t x;
+    in >> x;
+    istream_sum += x;
+  }
+  size_t t4 = dvc::now();
+  int64_t destring_sum = 0;
+  for (const std::string& number : numbers) {
+    int64_t x;
+    DVC_ASSERT(dvc::destring(number, x));
+    destring_sum += x;
+  }
+  size_t t5 = dvc::now();
+  DVC_ASSERT_EQ(istream_sum, destring_sum);
+
+  DVC_LOG("ostringstream concat: ", double(t1 - t0) / n, "ns/call");
+  DVC_LOG("to_chars concat: ", double(t2 - t1) / n, "ns/call");
+  DVC_LOG("istringstream parse: ", double(t4 - t3) / n, "ns/call");
+  DVC_LOG("from_chars destring: ", double(t5 - t4) / n, "ns/call");
+}
+
+void benchmark_csv() {
+  std::mt19937_64 ran;
+  std::vector<std::string> lines;
+  size_t bytes = 0;
+  for (int i = 0; i < 100000; i++) {
+    std::string line;
+    for (int field = 0; field < 12; field++) {
+      if (field) line += ',';
+      line += std::to_string(ran() % 100000);
+      if (field % 3 == 0) line += "_name";
+    }
+    bytes += line.size();
+    lines.push_back(std::move(line));
+  }
+
+  size_t t0 = dvc::now();
+  size_t copies = 0;
+  for (const std::string& line : lines)
+    for (const std::string& field : dvc::split(",", line))
+      copies += field.size();
+  size_t t1 = dvc::now();
+  size_t views = 0;
+  for (const std::string& line : lines)
+    for (std::string_view field : dvc::split_view(",", line))
+      views += field.size();
+  size_t t2 = dvc::now();
+  size_t multi = 0;
+  for (const std::string& line : lines)
+    for (std::string_view field : dvc::split_view("_name,", line))
+      multi += field.size();
+  size_t t3 = dvc::now();
+  DVC_ASSERT_EQ(copies, views);
+  DVC_ASSERT_LT(multi, views);
+
+  std::vector<std::string_view> fields;
+  size_t streamed = 0;
+  for (const std::string& line : lines) {
+    fields.clear();
+    dvc::append_split(fields, ",", line);
+    streamed += stream_join(";", fields).size();
+  }
+  size_t t4 = dvc::now();
+  size_t joined = 0;
+  std::string out;
+  for (const std::string& line : lines) {
+    fields.clear();
+    dvc::append_split(fields, ",", line);
+    out.clear();
+    dvc::append_join(out, ";", fields);
+    joined += out.size();
+  }
+  size_t t5 = dvc::now();
+  DVC_ASSERT_EQ(streamed, joined);
+  DVC_ASSERT_EQ(joined, bytes);
+
+  DVC_LOG("split: ", double(t1 - t0) / bytes, "ns/byte");
+  DVC_LOG("split_view: ", double(t2 - t1) / bytes, "ns/byte");
+  DVC_LOG("split_view multi-byte: ", double(t3 - t2) / bytes, "ns/byte");
+  DVC_LOG("split + ostringstream join: ", double(t4 - t3) / bytes, "ns/byte");
+  DVC_LOG("split + append_join: ", double(t5 - t4) / bytes, "ns/byte");
+}
+
+int main() {
+  test_destring();
+  test_concat();
+  test_find_string();
+  test_split();
+  benchmark_numbers();
+  benchmark_csv();
 }
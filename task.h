@@ -0,0 +1,338 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <future>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "dvc/log.h"
+#include "dvc/thread_pool.h"
+
+// C++20 coroutines.  Targets that include this header need -std=c++20.
+namespace dvc {
+
+template <typename T = void>
+class task;
+
+namespace task_detail {
+
+// Resumes whoever awaited the task, without growing the stack.
+struct final_awaiter {
+  bool await_ready() noexcept { return false; }
+
+  template <typename Promise>
+  std::coroutine_handle<> await_suspend(
+      std::coroutine_handle<Promise> h) noexcept {
+    std::coroutine_handle<> continuation = h.promise().continuation;
+    return continuation ? continuation : std::noop_coroutine();
+  }
+
+  void await_resume() noexcept {}
+};
+
+struct promise_base {
+  std::suspend_always initial_suspend() noexcept { return {}; }
+  final_awaiter final_suspend() noexcept { return {}; }
+  void unhandled_exception() { exception = std::current_exception(); }
+
+  void rethrow_if_failed() {
+    if (exception) std::rethrow_exception(exception);
+  }
+
+  std::coroutine_handle<> continuation;
+  std::exception_ptr exception;
+};
+
+template <typename T>
+struct promise : promise_base {
+  task<T> get_return_object();
+
+  template <typename U>
+  void return_value(U&& u) {
+    value.emplace(std::forward<U>(u));
+  }
+
+  T result() {
+    rethrow_if_failed();
+    return std::move(*value);
+  }
+
+  std::optional<T> value;
+};
+
+template <>
+struct promise<void> : promise_base {
+  task<void> get_return_object();
+  void return_void() {}
+  void result() { rethrow_if_failed(); }
+};
+
+}  // namespace task_detail
+
+// A lazily started coroutine producing a T.  It runs when first awaited, on
+// the awaiting thread, and resumes the awaiter when it finishes, so a chain
+// of tasks costs no threads and no stack while suspended.  Exceptions
+// propagate to the awaiter.
+template <typename T>
+class [[nodiscard]] task {
+ public:
+  using promise_type = task_detail::promise<T>;
+  using value_type = T;
+
+  task() = default;
+  explicit task(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+  task(task&& other) : h_(std::exchange(other.h_, nullptr)) {}
+  task& operator=(task&& other) {
+    std::swap(h_, other.h_);
+    return *this;
+  }
+
+  ~task() {
+    if (h_) h_.destroy();
+  }
+
+  bool valid() const { return bool(h_); }
+
+  auto operator co_await() && {
+    struct awaiter {
+      std::coroutine_handle<promise_type> h;
+
+      bool await_ready() { return h.done(); }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) {
+        h.promise().continuation = awaiting;
+        return h;
+      }
+      T await_resume() { return h.promise().result(); }
+    };
+    DVC_ASSERT(h_, "awaiting an empty task");
+    return awaiter{h_};
+  }
+
+ private:
+  std::coroutine_handle<promise_type> h_;
+};
+
+namespace task_detail {
+
+template <typename T>
+task<T> promise<T>::get_return_object() {
+  return task<T>(std::coroutine_handle<promise<T>>::from_promise(*this));
+}
+
+inline task<void> promise<void>::get_return_object() {
+  return task<void>(std::coroutine_handle<promise<void>>::from_promise(*this));
+}
+
+// A coroutine that starts immediately and frees itself when done; the
+// caller learns of completion through the coroutine's own side effects.
+struct detached {
+  struct promise_type {
+    detached get_return_object() { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+};
+
+template <typename T>
+detached run_to_promise(task<T> t, std::promise<T>& p) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(t);
+      p.set_value();
+    } else {
+      p.set_value(co_await std::move(t));
+    }
+  } catch (...) {
+    p.set_exception(std::current_exception());
+  }
+}
+
+// Shared by the children of a when_all.  count starts at one more than the
+// number of children, the extra being released by the parent once it has
+// started them all, and whoever brings it to zero resumes the parent.
+struct when_all_state {
+  explicit when_all_state(size_t children) : count(children + 1) {}
+
+  std::coroutine_handle<> arrive() {
+    if (count.fetch_sub(1, std::memory_order_acq_rel) == 1) return parent;
+    return std::noop_coroutine();
+  }
+
+  void fail(std::exception_ptr e) {
+    if (!failed.exchange(true)) exception = e;
+  }
+
+  std::atomic<size_t> count;
+  std::coroutine_handle<> parent;
+  std::atomic<bool> failed = false;
+  std::exception_ptr exception;
+};
+
+// Runs one child of a when_all, then destroys itself and arrives.
+struct when_all_child {
+  struct promise_type {
+    when_all_child get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept {
+      struct awaiter {
+        bool await_ready() noexcept { return false; }
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<promise_type> h) noexcept {
+          when_all_state* state = h.promise().state;
+          h.destroy();
+          return state->arrive();
+        }
+        void await_resume() noexcept {}
+      };
+      return awaiter{};
+    }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+
+    when_all_state* state = nullptr;
+  };
+
+  std::coroutine_handle<promise_type> h;
+};
+
+template <typename T, typename Slot>
+when_all_child run_child(task<T>& t, Slot& slot, when_all_state& state) {
+  try {
+    if constexpr (std::is_void_v<T>) {
+      co_await std::move(t);
+    } else {
+      slot.emplace(co_await std::move(t));
+    }
+  } catch (...) {
+    state.fail(std::current_exception());
+  }
+}
+
+struct when_all_awaiter {
+  when_all_state& state;
+  std::vector<when_all_child>& children;
+
+  bool await_ready() { return children.empty(); }
+  bool await_suspend(std::coroutine_handle<> parent) {
+    state.parent = parent;
+    for (auto& child : children) {
+      child.h.promise().state = &state;
+      child.h.resume();
+    }
+    return state.count.fetch_sub(1, std::memory_order_acq_rel) != 1;
+  }
+  void await_resume() {
+    if (state.exception) std::rethrow_exception(state.exception);
+  }
+};
+
+}  // namespace task_detail
+
+// Runs t to completion and returns its result, blocking the calling thread.
+// Must not be called from a task that the blocked thread would have to run.
+template <typename T>
+T sync_wait(task<T> t) {
+  std::promise<T> p;
+  std::future<T> f = p.get_future();
+  task_detail::run_to_promise(std::move(t), p);
+  return f.get();
+}
+
+// Awaits all of tasks, returning their results in order.  The tasks are
+// started in order on the awaiting thread and run concurrently from their
+// first suspension on; a task that should run in parallel from the start
+// should begin with co_await executor.schedule().  If any task throws, the
+// first exception is rethrown after all have finished.
+template <typename T>
+task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> when_all(
+    std::vector<task<T>> tasks) {
+  using slot =
+      std::conditional_t<std::is_void_v<T>, std::tuple<>, std::optional<T>>;
+  std::vector<slot> slots(tasks.size());
+  std::vector<task_detail::when_all_child> children;
+  children.reserve(tasks.size());
+  task_detail::when_all_state state(tasks.size());
+  for (size_t i = 0; i < tasks.size(); i++)
+    children.push_back(task_detail::run_child(tasks[i], slots[i], state));
+  co_await task_detail::when_all_awaiter{state, children};
+  if constexpr (!std::is_void_v<T>) {
+    std::vector<T> results;
+    results.reserve(slots.size());
+    for (auto& s : slots) results.push_back(std::move(*s));
+    co_return results;
+  }
+}
+
+// As above, for tasks of different non-void types.
+template <typename... Ts>
+task<std::tuple<Ts...>> when_all(task<Ts>... tasks) {
+  std::tuple<std::optional<Ts>...> slots;
+  task_detail::when_all_state state(sizeof...(Ts));
+  std::vector<task_detail::when_all_child> children;
+  std::apply(
+      [&](auto&... slot) {
+        (children.push_back(task_detail::run_child(tasks, slot, state)), ...);
+      },
+      slots);
+  co_await task_detail::when_all_awaiter{state, children};
+  co_return std::apply(
+      [](auto&... slot) { return std::tuple<Ts...>(std::move(*slot)...); },
+      slots);
+}
+
+// Runs coroutines on a thread_pool.
+class executor {
+ public:
+  explicit executor(thread_pool& pool) : pool_(&pool) {}
+
+  thread_pool& pool() const { return *pool_; }
+
+  // Resumes h on the pool.
+  void resume(std::coroutine_handle<> h) const {
+    pool_->spawn([h] { h.resume(); });
+  }
+
+  // co_await schedule() moves the awaiting coroutine onto the pool.
+  auto schedule() const {
+    struct awaiter {
+      const executor* ex;
+      bool await_ready() { return false; }
+      void await_suspend(std::coroutine_handle<> h) { ex->resume(h); }
+      void await_resume() {}
+    };
+    return awaiter{this};
+  }
+
+  // Runs t on the pool without waiting for it.  t must not throw.
+  void spawn(task<void> t) const { run_detached(*this, std::move(t)); }
+
+ private:
+  static task_detail::detached run_detached(executor ex, task<void> t) {
+    co_await ex.schedule();
+    try {
+      co_await std::move(t);
+    } catch (const std::exception& e) {
+      DVC_FATAL("spawned task threw: ", e.what());
+    }
+  }
+
+  thread_pool* pool_;
+};
+
+// An executor on default_pool().
+inline const executor& default_executor() {
+  static const executor ex(default_pool());
+  return ex;
+}
+
+}  // namespace dvc
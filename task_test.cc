@@ -0,0 +1,128 @@
+#include "dvc/task.h"
+
+#include <stdexcept>
+#include <string>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+dvc::task<int> answer() { co_return 42; }
+
+dvc::task<std::string> twice(int n) {
+  int x = co_await answer();
+  co_return std::to_string(n * x);
+}
+
+dvc::task<void> thrower() {
+  co_await answer();
+  throw std::runtime_error("thrown");
+}
+
+// Deep enough to overflow the stack if awaiting grew it.
+dvc::task<size_t> count_down(size_t n) {
+  size_t total = 0;
+  for (size_t i = 0; i < n; i++) total += co_await [](size_t i) -> dvc::task<size_t> {
+    co_return i;
+  }(i);
+  co_return total;
+}
+
+void test_task() {
+  DVC_ASSERT_EQ(dvc::sync_wait(answer()), 42);
+  DVC_ASSERT_EQ(dvc::sync_wait(twice(2)), "84");
+  bool caught = false;
+  try {
+    dvc::sync_wait(thrower());
+  } catch (const std::runtime_error& e) {
+    caught = std::string(e.what()) == "thrown";
+  }
+  DVC_ASSERT(caught);
+  DVC_ASSERT_EQ(dvc::sync_wait(count_down(1000000)), 499999500000u);
+}
+
+dvc::task<int> square_on(const dvc::executor& ex, int i) {
+  co_await ex.schedule();
+  co_return i * i;
+}
+
+void test_when_all(size_t threads) {
+  dvc::thread_pool pool(threads);
+  dvc::executor ex(pool);
+
+  std::vector<dvc::task<int>> tasks;
+  for (int i = 0; i < 1000; i++) tasks.push_back(square_on(ex, i));
+  std::vector<int> squares = dvc::sync_wait(dvc::when_all(std::move(tasks)));
+  DVC_ASSERT_EQ(squares.size(), 1000u);
+  for (int i = 0; i < 1000; i++) DVC_ASSERT_EQ(squares[i], i * i);
+
+  DVC_ASSERT(dvc::sync_wait(dvc::when_all(std::vector<dvc::task<int>>()))
+                 .empty());
+
+  auto [a, b] =
+      dvc::sync_wait(dvc::when_all(square_on(ex, 3), twice(1)));
+  DVC_ASSERT_EQ(a, 9);
+  DVC_ASSERT_EQ(b, "42");
+
+  std::atomic<int> ran = 0;
+  std::vector<dvc::task<void>> voids;
+  for (int i = 0; i < 100; i++)
+    voids.push_back([](const dvc::executor& ex,
+                       std::atomic<int>& ran) -> dvc::task<void> {
+      co_await ex.schedule();
+      ran++;
+    }(ex, ran));
+  voids.push_back(thrower());
+  bool caught = false;
+  try {
+    dvc::sync_wait(dvc::when_all(std::move(voids)));
+  } catch (const std::runtime_error&) {
+    caught = true;
+  }
+  DVC_ASSERT(caught);
+  DVC_ASSERT_EQ(ran, 100);
+
+  // Nested when_all from within the pool.
+  auto outer = [](const dvc::executor& ex) -> dvc::task<int> {
+    co_await ex.schedule();
+    std::vector<dvc::task<int>> inner;
+    for (int i = 0; i < 10; i++) inner.push_back(square_on(ex, i));
+    int sum = 0;
+    for (int x : co_await dvc::when_all(std::move(inner))) sum += x;
+    co_return sum;
+  };
+  std::vector<dvc::task<int>> outers;
+  for (int i = 0; i < 10; i++) outers.push_back(outer(ex));
+  for (int sum : dvc::sync_wait(dvc::when_all(std::move(outers))))
+    DVC_ASSERT_EQ(sum, 285);
+
+  std::promise<void> done;
+  ex.spawn([](std::promise<void>& done) -> dvc::task<void> {
+    done.set_value();
+    co_return;
+  }(done));
+  done.get_future().get();
+}
+
+void benchmark() {
+  constexpr size_t n = 1000000;
+  size_t start = dvc::now();
+  DVC_ASSERT_EQ(dvc::sync_wait(count_down(n)), n * (n - 1) / 2);
+  size_t middle = dvc::now();
+  const dvc::executor& ex = dvc::default_executor();
+  std::vector<dvc::task<int>> tasks;
+  for (size_t i = 0; i < n / 10; i++) tasks.push_back(square_on(ex, 1));
+  dvc::sync_wait(dvc::when_all(std::move(tasks)));
+  size_t end = dvc::now();
+  DVC_LOG("create and await task: ", double(middle - start) / n, "ns");
+  DVC_LOG("schedule on pool via when_all: ", double(end - middle) / (n / 10),
+          "ns/task");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_task();
+  for (size_t threads : {1, 2, 4}) test_when_all(threads);
+  benchmark();
+}
@@ -0,0 +1,135 @@
+#include "dvc/thread_pool.h"
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "dvc/log.h"
+#include "dvc/opts.h"
+
+namespace dvc {
+
+size_t DVC_OPTION(thread_pool_size, -, 0,
+                  "worker threads in the default pool, 0 for one per CPU");
+bool DVC_OPTION(pin_threads, -, false,
+                "pin default pool workers to CPUs");
+
+namespace {
+
+// The pool and deque index of the calling worker thread, if any.
+struct worker_id {
+  thread_pool* pool = nullptr;
+  work_deque* deque = nullptr;
+  size_t index = 0;
+};
+
+thread_local worker_id current_worker;
+
+size_t cpus() { return std::max(1u, std::thread::hardware_concurrency()); }
+
+}  // namespace
+
+thread_pool::thread_pool(size_t threads, bool pin) {
+  if (threads == 0) threads = cpus();
+  for (size_t i = 0; i < threads; i++)
+    deques_.push_back(std::make_unique<work_deque>());
+  for (size_t i = 0; i < threads; i++) {
+    threads_.emplace_back([this, i] { worker(i); });
+#if defined(__linux__)
+    if (pin) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(i % cpus(), &set);
+      int err = pthread_setaffinity_np(threads_.back().native_handle(),
+                                       sizeof(set), &set);
+      if (err) DVC_ERROR("failed to pin thread ", i, ": error ", err);
+    }
+#else
+    (void)pin;
+#endif
+  }
+}
+
+thread_pool::~thread_pool() {
+  {
+    std::lock_guard lock(mu_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& thread : threads_) thread.join();
+}
+
+void thread_pool::schedule(job* t) {
+  if (current_worker.pool == this) {
+    current_worker.deque->push(t);
+  } else {
+    std::lock_guard lock(mu_);
+    injected_.push_back(t);
+  }
+  // Pairs with the sleepers_ increment and pending_ check in worker().
+  pending_.fetch_add(1, std::memory_order_seq_cst);
+  if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+    { std::lock_guard lock(mu_); }
+    cv_.notify_one();
+  }
+}
+
+job* thread_pool::find_task() {
+  job* t = nullptr;
+  size_t start = 0;
+  if (current_worker.pool == this) {
+    t = current_worker.deque->pop();
+    start = current_worker.index + 1;
+  }
+  if (!t && pending_.load(std::memory_order_relaxed) > 0) {
+    {
+      std::lock_guard lock(mu_);
+      if (!injected_.empty()) {
+        t = injected_.front();
+        injected_.pop_front();
+      }
+    }
+    for (size_t i = 0; !t && i < deques_.size(); i++)
+      t = deques_[(start + i) % deques_.size()]->steal();
+  }
+  if (t) pending_.fetch_sub(1, std::memory_order_relaxed);
+  return t;
+}
+
+bool thread_pool::run_one() {
+  job* t = find_task();
+  if (!t) return false;
+  (*t)();
+  delete t;
+  return true;
+}
+
+void thread_pool::worker(size_t index) {
+  current_worker = {this, deques_[index].get(), index};
+  while (true) {
+    if (run_one()) continue;
+    // A few rounds of stealing before sleeping, as a steal can fail to a
+    // race while work remains.
+    bool found = false;
+    for (int spin = 0; spin < 64 && !found; spin++) {
+      found = run_one();
+      if (!found) std::this_thread::yield();
+    }
+    if (found) continue;
+    std::unique_lock lock(mu_);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    cv_.wait(lock, [&] {
+      return stop_ || pending_.load(std::memory_order_seq_cst) > 0;
+    });
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    if (stop_ && pending_.load(std::memory_order_seq_cst) == 0) return;
+  }
+}
+
+thread_pool& default_pool() {
+  static thread_pool pool(thread_pool_size, pin_threads);
+  return pool;
+}
+
+}  // namespace dvc
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace dvc {
+
+using job = std::function<void()>;
+
+// A Chase-Lev work-stealing deque: the owning thread pushes and pops at the
+// bottom, and other threads steal from the top.  Grows without bound; old
+// arrays are kept until destruction because thieves may still be reading
+// them.
+class work_deque {
+ public:
+  work_deque() : array_(new array(64)) { arrays_.emplace_back(array_.load()); }
+
+  work_deque(const work_deque&) = delete;
+  work_deque& operator=(const work_deque&) = delete;
+
+  // Owner only.
+  void push(job* t) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t top = top_.load(std::memory_order_acquire);
+    array* a = array_.load(std::memory_order_relaxed);
+    if (b - top > int64_t(a->capacity) - 1) a = grow(a, top, b);
+    a->put(b, t);
+    bottom_.store(b + 1, std::memory_order_release);
+  }
+
+  // Owner only.  Returns nullptr if empty.
+  job* pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    array* a = array_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    job* x = a->get(b);
+    if (t == b) {
+      // The last task: race thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed))
+        x = nullptr;
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // Any thread.  Returns nullptr if empty or if another thread won the race.
+  job* steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return nullptr;
+    job* x = array_.load(std::memory_order_acquire)->get(t);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      return nullptr;
+    return x;
+  }
+
+  bool empty() const {
+    return top_.load(std::memory_order_relaxed) >=
+           bottom_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct array {
+    explicit array(size_t capacity)
+        : capacity(capacity), slots(new std::atomic<job*>[capacity]) {}
+
+    job* get(int64_t i) const {
+      return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+    }
+    void put(int64_t i, job* t) {
+      slots[i & (capacity - 1)].store(t, std::memory_order_relaxed);
+    }
+
+    size_t capacity;
+    std::unique_ptr<std::atomic<job*>[]> slots;
+  };
+
+  array* grow(array* a, int64_t top, int64_t bottom) {
+    auto bigger = std::make_unique<array>(2 * a->capacity);
+    for (int64_t i = top; i < bottom; i++) bigger->put(i, a->get(i));
+    array_.store(bigger.get(), std::memory_order_release);
+    arrays_.push_back(std::move(bigger));
+    return arrays_.back().get();
+  }
+
+  alignas(64) std::atomic<int64_t> top_{0};
+  alignas(64) std::atomic<int64_t> bottom_{0};
+  std::atomic<array*> array_;
+  std::vector<std::unique_ptr<array>> arrays_;
+};
+
+// A fixed set of worker threads that run tasks, each with its own
+// work_deque.  Tasks spawned from a worker go on its deque, and idle workers
+// steal from the others, so nested parallelism balances itself.  Threads
+// that wait for parallel work, workers or not, run tasks while they wait,
+// so the parallel_ functions may be nested freely.  Tasks must not throw.
+class thread_pool {
+ public:
+  // threads == 0 means one per CPU.  If pin is set, worker i is pinned to
+  // CPU i modulo the number of CPUs.
+  explicit thread_pool(size_t threads = 0, bool pin = false);
+  ~thread_pool();
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  size_t size() const { return threads_.size(); }
+
+  // Runs f on the pool.
+  void spawn(job f) { schedule(new job(std::move(f))); }
+
+  // Runs f on the pool, returning a future for its result.  Waiting for the
+  // future from within a task blocks a worker; use the parallel_ functions
+  // there instead.
+  template <typename F>
+  auto submit(F f) -> std::future<std::invoke_result_t<F>> {
+    auto p =
+        std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(
+            std::move(f));
+    auto future = p->get_future();
+    spawn([p] { (*p)(); });
+    return future;
+  }
+
+  // Runs tasks until done() is true.
+  template <typename Done>
+  void wait_until(Done&& done) {
+    while (!done())
+      if (!run_one()) std::this_thread::yield();
+  }
+
+  // Calls f(i) for each i in [begin, end), in chunks of at least grain
+  // indices.  grain == 0 picks about 8 chunks per thread.
+  template <typename F>
+  void parallel_for(size_t begin, size_t end, F&& f, size_t grain = 0) {
+    if (end <= begin) return;
+    if (grain == 0) grain = std::max<size_t>(1, (end - begin) / (8 * size()));
+    std::atomic<size_t> remaining(end - begin);
+    // Splits off the upper half for others to steal until a chunk is small.
+    std::function<void(size_t, size_t)> run = [&](size_t b, size_t e) {
+      while (e - b > grain) {
+        size_t m = b + (e - b) / 2;
+        spawn([&run, m, e] { run(m, e); });
+        e = m;
+      }
+      for (size_t i = b; i < e; i++) f(i);
+      remaining.fetch_sub(e - b, std::memory_order_release);
+    };
+    run(begin, end);
+    wait_until([&] { return remaining.load(std::memory_order_acquire) == 0; });
+  }
+
+  // Combines map(i) for each i in [begin, end) with reduce, starting from
+  // identity in each chunk.  reduce must be associative.
+  template <typename T, typename Map, typename Reduce>
+  T parallel_reduce(size_t begin, size_t end, T identity, Map&& map,
+                    Reduce&& reduce, size_t grain = 0) {
+    if (end <= begin) return identity;
+    if (grain == 0) grain = std::max<size_t>(1, (end - begin) / (8 * size()));
+    size_t chunks = (end - begin + grain - 1) / grain;
+    std::vector<T> results(chunks, identity);
+    parallel_for(
+        0, chunks,
+        [&](size_t c) {
+          size_t e = std::min(end, begin + (c + 1) * grain);
+          for (size_t i = begin + c * grain; i < e; i++)
+            results[c] = reduce(std::move(results[c]), map(i));
+        },
+        1);
+    T result = std::move(identity);
+    for (T& r : results) result = reduce(std::move(result), std::move(r));
+    return result;
+  }
+
+  // Calls each of fs, in parallel, and returns when all have returned.
+  template <typename F, typename... Fs>
+  void parallel_invoke(F&& f, Fs&&... fs) {
+    std::atomic<size_t> remaining(sizeof...(Fs));
+    (spawn([&fs, &remaining] {
+       fs();
+       remaining.fetch_sub(1, std::memory_order_release);
+     }),
+     ...);
+    f();
+    wait_until([&] { return remaining.load(std::memory_order_acquire) == 0; });
+  }
+
+ private:
+  void schedule(job* t);
+  job* find_task();
+  bool run_one();
+  void worker(size_t index);
+
+  std::vector<std::unique_ptr<work_deque>> deques_;
+  std::vector<std::thread> threads_;
+
+  // Tasks from threads that are not workers of this pool.
+  std::mutex mu_;
+  std::deque<job*> injected_;
+
+  std::condition_variable cv_;
+  std::atomic<size_t> pending_{0};  // scheduled but not yet taken
+  std::atomic<size_t> sleepers_{0};
+  bool stop_ = false;
+};
+
+// The pool sized by --thread_pool_size and --pin_threads, created on first
+// use.
+thread_pool& default_pool();
+
+}  // namespace dvc
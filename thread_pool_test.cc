@@ -0,0 +1,100 @@
+#include "dvc/thread_pool.h"
+
+#include <numeric>
+
+#include "dvc/log.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+void test_deque() {
+  // The owner pushes and pops while thieves steal; every task must be taken
+  // exactly once.
+  constexpr size_t n = 200000;
+  dvc::work_deque deque;
+  std::vector<dvc::job> tasks(n);
+  std::vector<std::atomic<int>> taken(n);
+  std::atomic<bool> done = false;
+  auto take = [&](dvc::job* t) { taken[t - tasks.data()]++; };
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 3; i++)
+    thieves.emplace_back([&] {
+      while (!done)
+        if (dvc::job* t = deque.steal()) take(t);
+    });
+  for (size_t i = 0; i < n; i++) {
+    deque.push(&tasks[i]);
+    if (i % 3 == 0)
+      if (dvc::job* t = deque.pop()) take(t);
+  }
+  while (dvc::job* t = deque.pop()) take(t);
+  done = true;
+  for (auto& thief : thieves) thief.join();
+  for (size_t i = 0; i < n; i++) DVC_ASSERT_EQ(taken[i], 1, i);
+}
+
+uint64_t fib(dvc::thread_pool& pool, int n) {
+  if (n < 20) {
+    uint64_t a = 0, b = 1;
+    for (int i = 0; i < n; i++) b = std::exchange(a, b) + b;
+    return a;
+  }
+  uint64_t x, y;
+  pool.parallel_invoke([&] { x = fib(pool, n - 1); },
+                       [&] { y = fib(pool, n - 2); });
+  return x + y;
+}
+
+void test_pool(size_t threads) {
+  dvc::thread_pool pool(threads);
+  DVC_ASSERT_EQ(pool.size(), threads);
+
+  std::vector<std::atomic<int>> hits(100000);
+  pool.parallel_for(0, hits.size(), [&](size_t i) { hits[i]++; });
+  for (auto& hit : hits) DVC_ASSERT_EQ(hit, 1);
+
+  // Nested loops run inside tasks.
+  std::atomic<size_t> nested = 0;
+  pool.parallel_for(
+      0, 100,
+      [&](size_t) { pool.parallel_for(0, 100, [&](size_t) { nested++; }, 7); },
+      1);
+  DVC_ASSERT_EQ(nested, 10000u);
+
+  uint64_t sum = pool.parallel_reduce(
+      1, 1000001, uint64_t(0), [](size_t i) { return uint64_t(i); },
+      std::plus<>());
+  DVC_ASSERT_EQ(sum, 500000500000u);
+  DVC_ASSERT_EQ(pool.parallel_reduce(5, 5, 3, [](size_t) { return 1; },
+                                     std::plus<>()),
+                3);
+
+  DVC_ASSERT_EQ(fib(pool, 30), 832040u);
+
+  std::vector<std::future<int>> futures;
+  for (int i = 0; i < 100; i++)
+    futures.push_back(pool.submit([i] { return i * i; }));
+  for (int i = 0; i < 100; i++) DVC_ASSERT_EQ(futures[i].get(), i * i);
+}
+
+void benchmark() {
+  dvc::thread_pool& pool = dvc::default_pool();
+  constexpr size_t n = 1000000;
+  std::vector<double> v(n);
+  size_t start = dvc::now();
+  pool.parallel_for(0, n, [&](size_t i) { v[i] = double(i) * 0.5; }, 1);
+  size_t middle = dvc::now();
+  uint64_t x = fib(pool, 32);
+  size_t end = dvc::now();
+  DVC_ASSERT_EQ(x, 2178309u);
+  DVC_LOG("parallel_for with grain 1: ", double(middle - start) / n,
+          "ns/task on ", pool.size(), " threads");
+  DVC_LOG("fib(32) via parallel_invoke: ", double(end - middle) / 1e6, "ms");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  test_deque();
+  for (size_t threads : {1, 2, 4}) test_pool(threads);
+  benchmark();
+}
@@ -1,25 +1,43 @@
 #pragma once
 
+#include <time.h>
+
 #include <chrono>
+#include <cstdint>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
 #include <string>
 
+#include "dvc/fixed_string.h"
+
 namespace dvc {
 
-inline std::string now_string() {
-  std::ostringstream oss;
-  std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
-  std::time_t now_c = std::chrono::system_clock::to_time_t(now);
-  oss << std::put_time(std::localtime(&now_c), "%F %T");
-  return oss.str();
+// The local wall-clock time as "YYYY-MM-DD HH:MM:SS".
+inline fixed_string<24> now_fixed_string() {
+  std::time_t now_c =
+      std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+  std::tm tm;
+  localtime_r(&now_c, &tm);
+  fixed_string<24> s;
+  s.resize(std::strftime(s.data(), s.capacity() + 1, "%F %T", &tm));
+  return s;
 }
 
+inline std::string now_string() { return now_fixed_string().str(); }
+
+// Nanoseconds since an arbitrary epoch, from a monotonic clock, so that
+// differences are never negative.  Use now_string() for wall-clock time.
 inline uint64_t now() {
   return std::chrono::duration_cast<std::chrono::nanoseconds>(
-             std::chrono::system_clock::now().time_since_epoch())
+             std::chrono::steady_clock::now().time_since_epoch())
       .count();
 }
 
+// Like now(), but from CLOCK_MONOTONIC_RAW, which is not slewed by NTP
+// frequency adjustments either.
+inline uint64_t now_raw() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+  return uint64_t(ts.tv_sec) * 1000000000u + ts.tv_nsec;
+}
+
 }  // namespace dvc
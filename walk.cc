@@ -0,0 +1,422 @@
+#include "dvc/walk.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+
+namespace dvc {
+namespace {
+
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+constexpr size_t getdents_buffer_size = 64 << 10;
+
+constexpr unsigned statx_mask =
+    STATX_TYPE | STATX_MODE | STATX_INO | STATX_SIZE | STATX_MTIME;
+
+entry_type type_of_dirent(unsigned char d_type) {
+  switch (d_type) {
+    case DT_REG:
+      return entry_type::regular;
+    case DT_DIR:
+      return entry_type::directory;
+    case DT_LNK:
+      return entry_type::symlink;
+    default:
+      return entry_type::other;
+  }
+}
+
+entry_type type_of_mode(mode_t mode) {
+  if (S_ISREG(mode)) return entry_type::regular;
+  if (S_ISDIR(mode)) return entry_type::directory;
+  if (S_ISLNK(mode)) return entry_type::symlink;
+  return entry_type::other;
+}
+
+// Whether to deliver an entry, decided on the thread that read it; false
+// skips delivering the entry, though a directory is still descended.
+using select_fn = std::function<bool(const walk_entry&)>;
+// Computes what to deliver with a selected entry, in a pool task of its own
+// so that the files of one wide directory are not handled one at a time.
+using annotate_fn = std::function<void(const walk_entry&, std::string&)>;
+using visit_fn = std::function<void(const walk_entry&, std::string_view)>;
+
+// A copy of a walk_entry, for a task that outlives the read_dir call.
+struct owned_entry {
+  explicit owned_entry(const walk_entry& entry)
+      : path(entry.path),
+        name_offset(entry.path.size() - entry.name.size()),
+        type(entry.type),
+        depth(entry.depth),
+        has_stat(entry.stat != nullptr) {
+    if (has_stat) stat = *entry.stat;
+  }
+
+  walk_entry view() const {
+    return {path, std::string_view(path).substr(name_offset), type, depth,
+            has_stat ? &stat : nullptr};
+  }
+
+  std::string path;
+  size_t name_offset;
+  entry_type type;
+  size_t depth;
+  bool has_stat;
+  file_stat stat;
+};
+
+class walker {
+ public:
+  walker(const std::filesystem::path& root, const walk_options& options,
+         select_fn select, annotate_fn annotate, visit_fn visit,
+         thread_pool& pool)
+      : root_(root.native()),
+        options_(options),
+        select_(std::move(select)),
+        annotate_(std::move(annotate)),
+        visit_(std::move(visit)),
+        pool_(pool) {
+    while (root_.size() > 1 && root_.back() == '/') root_.pop_back();
+  }
+
+  walk_stats run() {
+    int fd = ::open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+      throw std::filesystem::filesystem_error(
+          "open", root_, std::error_code(errno, std::generic_category()));
+    ::close(fd);
+    if (options_.ordered) {
+      node root(root_, 0);
+      emit(&root);
+    } else {
+      read_unordered(root_, 0);
+    }
+    // Once no directory is left to read, no more files are queued.
+    pool_.wait_until([&] {
+      return pending_.load(std::memory_order_acquire) == 0 &&
+             pending_files_.load(std::memory_order_acquire) == 0;
+    });
+    walk_stats stats;
+    stats.dirs = dirs_;
+    stats.entries = entries_;
+    stats.errors = errors_;
+    return stats;
+  }
+
+ private:
+  // A directory in an ordered walk, read by whichever of a pool task and
+  // the emitting thread claims it first.
+  struct node;
+  struct annotation {
+    std::atomic<bool> done{false};
+    bool deliver = false;
+    std::string value;
+  };
+  struct item {
+    std::string name;
+    entry_type type;
+    bool deliver;
+    file_stat stat;
+    std::shared_ptr<annotation> annotated;  // if annotate_
+    std::shared_ptr<node> child;  // tasks that may read it share it
+  };
+  struct node {
+    node(std::string path, size_t depth)
+        : path(std::move(path)), depth(depth) {}
+
+    enum { unread, reading, done };
+
+    std::string path;
+    size_t depth;
+    std::atomic<int> state{unread};
+    std::atomic<bool> queued{false};  // counted in pending_
+    std::vector<item> items;
+  };
+
+  void error(std::string_view path, int error) {
+    errors_.fetch_add(1, std::memory_order_relaxed);
+    std::error_code code(error, std::generic_category());
+    if (options_.on_error) {
+      options_.on_error(path, code);
+    } else {
+      DVC_ERROR("walk: ", path, ": ", code.message());
+    }
+  }
+
+  bool descend(const walk_entry& entry) const {
+    return entry.type == entry_type::directory &&
+           entry.depth < options_.max_depth;
+  }
+
+  // Calls f for each entry of the directory at path that passes the
+  // filter.
+  template <typename F>
+  void read_dir(const std::string& path, size_t depth, F&& f) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return error(path, errno);
+    dirs_.fetch_add(1, std::memory_order_relaxed);
+    std::unique_ptr<char[]> buffer(new char[getdents_buffer_size]);
+    std::string child = path;
+    if (child.back() != '/') child += '/';
+    size_t prefix = child.size();
+    while (true) {
+      long n =
+          ::syscall(SYS_getdents64, fd, buffer.get(), getdents_buffer_size);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) error(path, errno);
+      if (n <= 0) break;
+      for (long offset = 0; offset < n;) {
+        auto d = reinterpret_cast<linux_dirent64*>(buffer.get() + offset);
+        offset += d->d_reclen;
+        std::string_view name = d->d_name;
+        if (name == "." || name == "..") continue;
+        child.resize(prefix);
+        child += name;
+        walk_entry entry{child, name, type_of_dirent(d->d_type), depth,
+                         nullptr};
+        file_stat stat;
+        if (options_.stat || d->d_type == DT_UNKNOWN) {
+          struct statx stx;
+          if (::statx(fd, d->d_name, AT_SYMLINK_NOFOLLOW | AT_NO_AUTOMOUNT,
+                      statx_mask, &stx) != 0) {
+            error(child, errno);
+            continue;
+          }
+          entry.type = type_of_mode(stx.stx_mode);
+          stat.dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+          stat.ino = stx.stx_ino;
+          stat.size = stx.stx_size;
+          stat.mtime_ns =
+              stx.stx_mtime.tv_sec * int64_t(1'000'000'000) +
+              stx.stx_mtime.tv_nsec;
+          if (options_.stat) entry.stat = &stat;
+        }
+        if (options_.filter && !options_.filter(entry)) continue;
+        f(entry);
+      }
+    }
+    ::close(fd);
+  }
+
+  bool select(const walk_entry& entry) const {
+    return !select_ || select_(entry);
+  }
+
+  // Fills in annotation and returns whether to deliver entry.
+  bool annotate(const walk_entry& entry, std::string& annotation) {
+    try {
+      annotate_(entry, annotation);
+      return true;
+    } catch (const std::filesystem::filesystem_error& e) {
+      error(entry.path, e.code().value());
+      return false;
+    }
+  }
+
+  // Runs f in a task of its own, or on this thread if max_pending_files are
+  // already queued.
+  template <typename F>
+  void spawn_file(const walk_entry& entry, F f) {
+    if (pending_files_.load(std::memory_order_relaxed) >=
+        options_.max_pending_files)
+      return f(entry);
+    pending_files_.fetch_add(1, std::memory_order_relaxed);
+    pool_.spawn([this, copy = owned_entry(entry), f = std::move(f)] {
+      f(copy.view());
+      pending_files_.fetch_sub(1, std::memory_order_release);
+    });
+  }
+
+  void deliver_unordered(const walk_entry& entry) {
+    std::string annotation;
+    if (annotate_ && !annotate(entry, annotation)) return;
+    entries_.fetch_add(1, std::memory_order_relaxed);
+    visit_(entry, annotation);
+  }
+
+  void read_unordered(const std::string& path, size_t depth) {
+    read_dir(path, depth, [&](const walk_entry& entry) {
+      if (select(entry)) {
+        if (annotate_) {
+          spawn_file(entry,
+                     [this](const walk_entry& e) { deliver_unordered(e); });
+        } else {
+          deliver_unordered(entry);
+        }
+      }
+      if (!descend(entry)) return;
+      if (pending_.load(std::memory_order_relaxed) <
+          options_.max_pending_dirs) {
+        pending_.fetch_add(1, std::memory_order_relaxed);
+        pool_.spawn([this, child = std::string(entry.path), depth] {
+          read_unordered(child, depth + 1);
+          pending_.fetch_sub(1, std::memory_order_release);
+        });
+      } else {
+        read_unordered(std::string(entry.path), depth + 1);
+      }
+    });
+  }
+
+  void read_node(node* n) {
+    read_dir(n->path, n->depth, [&](const walk_entry& entry) {
+      item& it = n->items.emplace_back();
+      it.name = entry.name;
+      it.type = entry.type;
+      it.deliver = select(entry);
+      if (entry.stat) it.stat = *entry.stat;
+      if (it.deliver && annotate_) {
+        it.annotated = std::make_shared<annotation>();
+        spawn_file(entry, [this, a = it.annotated](const walk_entry& e) {
+          a->deliver = annotate(e, a->value);
+          a->done.store(true, std::memory_order_release);
+        });
+      }
+      if (descend(entry))
+        it.child = std::make_shared<node>(std::string(entry.path),
+                                          n->depth + 1);
+    });
+    std::sort(n->items.begin(), n->items.end(),
+              [](const item& a, const item& b) { return a.name < b.name; });
+    read_ahead(n);
+    n->state.store(node::done, std::memory_order_release);
+  }
+
+  // Queues n's subdirectories to be read, as far as max_pending_dirs
+  // allows.
+  void read_ahead(node* n) {
+    for (item& it : n->items) {
+      if (pending_.load(std::memory_order_relaxed) >=
+          options_.max_pending_dirs)
+        return;
+      std::shared_ptr<node> child = it.child;
+      if (!child || child->queued.exchange(true)) continue;
+      pending_.fetch_add(1, std::memory_order_relaxed);
+      pool_.spawn([this, child = std::move(child)] {
+        int state = node::unread;
+        if (child->state.compare_exchange_strong(state, node::reading))
+          read_node(child.get());
+      });
+    }
+  }
+
+  // Delivers n's subtree in order, then frees it.
+  void emit(node* n) {
+    int state = node::unread;
+    if (n->state.compare_exchange_strong(state, node::reading)) {
+      read_node(n);
+    } else {
+      pool_.wait_until([&] {
+        return n->state.load(std::memory_order_acquire) == node::done;
+      });
+      read_ahead(n);
+    }
+    std::string path = n->path;
+    if (path.back() != '/') path += '/';
+    size_t prefix = path.size();
+    for (item& it : n->items) {
+      std::string_view value;
+      if (it.annotated) {
+        annotation& a = *it.annotated;
+        pool_.wait_until(
+            [&] { return a.done.load(std::memory_order_acquire); });
+        it.deliver = a.deliver;
+        value = a.value;
+      }
+      if (it.deliver) {
+        path.resize(prefix);
+        path += it.name;
+        walk_entry entry{path, std::string_view(path).substr(prefix), it.type,
+                         n->depth, options_.stat ? &it.stat : nullptr};
+        entries_.fetch_add(1, std::memory_order_relaxed);
+        visit_(entry, value);
+      }
+      if (it.child) {
+        emit(it.child.get());
+        it.child.reset();
+      }
+    }
+    n->items.clear();
+    n->items.shrink_to_fit();
+    if (n->queued.load(std::memory_order_relaxed))
+      pending_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  std::string root_;
+  const walk_options& options_;
+  select_fn select_;
+  annotate_fn annotate_;
+  visit_fn visit_;
+  thread_pool& pool_;
+
+  // Directories queued and not yet read, or for ordered walks, read ahead
+  // and not yet emitted.
+  std::atomic<size_t> pending_{0};
+  // Files queued to be annotated and not yet done.
+  std::atomic<size_t> pending_files_{0};
+  std::atomic<size_t> dirs_{0};
+  std::atomic<size_t> entries_{0};
+  std::atomic<size_t> errors_{0};
+};
+
+}  // namespace
+
+walk_stats walk(const std::filesystem::path& root,
+                const walk_options& options,
+                const std::function<void(const walk_entry&)>& visit,
+                thread_pool& pool) {
+  return walker(root, options, nullptr, nullptr,
+                [&](const walk_entry& entry, std::string_view) {
+                  visit(entry);
+                },
+                pool)
+      .run();
+}
+
+walk_stats walk_digests(
+    const std::filesystem::path& root, const walk_options& options,
+    digest_cache* cache, digest_algorithm algorithm,
+    const std::function<void(const walk_entry&, std::string_view digest)>&
+        visit,
+    thread_pool& pool) {
+  walk_options with_stat = options;
+  if (cache) with_stat.stat = true;
+  return walker(
+             root, with_stat,
+             [](const walk_entry& entry) {
+               return entry.type == entry_type::regular;
+             },
+             [&](const walk_entry& entry, std::string& digest) {
+               if (cache) {
+                 digest = cache->digest(std::string(entry.path), algorithm,
+                                        *entry.stat);
+               } else {
+                 digest = compute_digest(algorithm, read_file(entry.path));
+               }
+             },
+             visit, pool)
+      .run();
+}
+
+}  // namespace dvc
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+#include "dvc/digest_cache.h"
+#include "dvc/thread_pool.h"
+
+namespace dvc {
+
+enum class entry_type : uint8_t { regular, directory, symlink, other };
+
+struct walk_entry {
+  std::string_view path;  // root/.../name
+  std::string_view name;
+  entry_type type;
+  size_t depth;           // 0 for entries directly in the root
+  const file_stat* stat;  // if walk_options::stat, else nullptr
+};
+
+struct walk_options {
+  // Deliver entries on the calling thread, in preorder with each
+  // directory's entries sorted by name.  Otherwise entries are delivered
+  // concurrently from pool threads and the calling thread, in no
+  // particular order.
+  bool ordered = false;
+
+  // statx every entry.  Otherwise only entries whose type getdents64
+  // doesn't report are stat'd.
+  bool stat = false;
+
+  // Entries below this depth are not read.
+  size_t max_depth = std::numeric_limits<size_t>::max();
+
+  // Called from pool threads for every entry; false skips the entry, and
+  // the subtree of a directory.
+  std::function<bool(const walk_entry&)> filter;
+
+  // Called from pool threads for unreadable directories and entries that
+  // can't be stat'd, which are skipped.  By default they are logged.
+  std::function<void(std::string_view path, std::error_code error)> on_error;
+
+  // The most directories queued or read ahead at once.  Beyond this,
+  // unordered walks descend depth first on the same thread, and ordered
+  // walks wait for the caller to catch up, so memory stays bounded however
+  // wide the tree.
+  size_t max_pending_dirs = 4096;
+
+  // The most files queued at once for walk_digests to hash.  Beyond this,
+  // files are hashed on the thread that read their directory.
+  size_t max_pending_files = 4096;
+};
+
+struct walk_stats {
+  size_t dirs = 0;     // read, including the root
+  size_t entries = 0;  // delivered
+  size_t errors = 0;
+};
+
+// Walks the tree under root, which is not itself delivered, calling visit
+// for every entry that passes the filter.  Symlinks are not followed.
+// Directories are read with getdents64 in parallel on pool: each one is a
+// task, and idle workers steal them.  Throws if root can't be opened.
+walk_stats walk(const std::filesystem::path& root,
+                const walk_options& options,
+                const std::function<void(const walk_entry&)>& visit,
+                thread_pool& pool = default_pool());
+
+// Like walk(), with the digest of each regular file passed to visit.  Each
+// file is hashed in a pool task of its own, and delivered when its task
+// finishes.  Other entries are not delivered.  If cache is not
+// null, unchanged files are looked up by the stat the walk already did
+// instead of being read.
+walk_stats walk_digests(
+    const std::filesystem::path& root, const walk_options& options,
+    digest_cache* cache, digest_algorithm algorithm,
+    const std::function<void(const walk_entry&, std::string_view digest)>&
+        visit,
+    thread_pool& pool = default_pool());
+
+}  // namespace dvc
@@ -0,0 +1,232 @@
+#include "dvc/walk.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+
+#include "dvc/file.h"
+#include "dvc/log.h"
+#include "dvc/opts.h"
+#include "dvc/program.h"
+#include "dvc/time.h"
+
+size_t DVC_OPTION(walk_files, -, 20000, "number of files in the benchmark");
+size_t DVC_OPTION(wide_files, -, 2000,
+                  "number of files in the wide directory benchmark");
+size_t DVC_OPTION(wide_file_size, -, 64 << 10,
+                  "size of each file in the wide directory benchmark");
+
+// Writes a file with an mtime an hour ago, so digest_cache will cache it.
+void write_old_file(const std::filesystem::path& path, std::string_view data) {
+  dvc::save_file(path, data);
+  std::filesystem::last_write_time(
+      path, std::filesystem::file_time_type::clock::now() -
+                std::chrono::hours(1));
+}
+
+// The paths under dir in sorted preorder.
+void reference_order(const std::filesystem::path& dir,
+                     std::vector<std::string>& out) {
+  std::vector<std::filesystem::directory_entry> entries(
+      std::filesystem::directory_iterator(dir), {});
+  std::sort(entries.begin(), entries.end());
+  for (const auto& entry : entries) {
+    out.push_back(entry.path().native());
+    if (entry.is_directory() && !entry.is_symlink())
+      reference_order(entry.path(), out);
+  }
+}
+
+void make_tree(const std::filesystem::path& root) {
+  for (std::string d : {"a", "a/b", "a/b/c", "a/empty", "d", "d/e"})
+    std::filesystem::create_directories(root / d);
+  for (std::string f : {"a/1", "a/b/2", "a/b/c/3", "a/b/c/4", "d/5", "d/e/6",
+                        "7", "z"})
+    write_old_file(root / f, f);
+  std::filesystem::create_symlink("a", root / "link");
+}
+
+void test_walk(const std::filesystem::path& root) {
+  make_tree(root);
+  std::vector<std::string> expected;
+  reference_order(root, expected);
+  DVC_ASSERT_EQ(expected.size(), 15u);
+
+  for (size_t threads : {1, 4}) {
+    for (size_t max_pending_dirs : {1, 4096}) {
+      dvc::thread_pool pool(threads);
+      dvc::walk_options options;
+      options.max_pending_dirs = max_pending_dirs;
+
+      std::mutex mu;
+      std::vector<std::string> unordered;
+      dvc::walk_stats stats = dvc::walk(
+          root, options,
+          [&](const dvc::walk_entry& entry) {
+            std::lock_guard lock(mu);
+            unordered.emplace_back(entry.path);
+          },
+          pool);
+      DVC_ASSERT_EQ(stats.dirs, 7u);
+      DVC_ASSERT_EQ(stats.entries, expected.size());
+      std::sort(unordered.begin(), unordered.end());
+      std::vector<std::string> sorted = expected;
+      std::sort(sorted.begin(), sorted.end());
+      DVC_ASSERT(unordered == sorted, threads);
+
+      options.ordered = true;
+      std::vector<std::string> ordered;
+      dvc::walk(
+          root, options,
+          [&](const dvc::walk_entry& entry) {
+            ordered.emplace_back(entry.path);
+          },
+          pool);
+      DVC_ASSERT(ordered == expected, threads, " ", max_pending_dirs);
+    }
+  }
+
+  // Types, depths, stats, filters and max_depth.
+  dvc::walk_options options;
+  options.ordered = true;
+  options.stat = true;
+  options.max_depth = 1;
+  options.filter = [](const dvc::walk_entry& entry) {
+    return entry.name != "d";
+  };
+  std::vector<std::string> seen;
+  dvc::walk(root.native() + "/", options, [&](const dvc::walk_entry& entry) {
+    std::string_view relative = entry.path.substr(root.native().size() + 1);
+    seen.emplace_back(relative);
+    DVC_ASSERT(*entry.stat == dvc::file_stat::of(std::string(entry.path)) ||
+               entry.type == dvc::entry_type::symlink);
+    DVC_ASSERT_EQ(entry.depth,
+                  size_t(std::count(relative.begin(), relative.end(), '/')));
+    if (entry.name == "link")
+      DVC_ASSERT(entry.type == dvc::entry_type::symlink);
+    if (entry.name == "b")
+      DVC_ASSERT(entry.type == dvc::entry_type::directory);
+  });
+  DVC_ASSERT(seen == std::vector<std::string>({"7", "a", "a/1", "a/b",
+                                               "a/empty", "link", "z"}));
+
+  bool threw = false;
+  try {
+    dvc::walk(root / "missing", {}, [](const dvc::walk_entry&) {});
+  } catch (const std::filesystem::filesystem_error&) {
+    threw = true;
+  }
+  DVC_ASSERT(threw);
+}
+
+void test_digests(const std::filesystem::path& root,
+                  const std::filesystem::path& cache_file) {
+  auto algorithm = dvc::digest_algorithm::sha3_256;
+  for (bool ordered : {false, true}) {
+    dvc::walk_options options;
+    options.ordered = ordered;
+    std::mutex mu;
+    std::map<std::string, std::string> digests;
+    auto visit = [&](const dvc::walk_entry& entry, std::string_view digest) {
+      DVC_ASSERT(entry.type == dvc::entry_type::regular);
+      std::lock_guard lock(mu);
+      digests[std::string(entry.path)] = digest;
+    };
+    dvc::walk_digests(root, options, nullptr, algorithm, visit);
+    DVC_ASSERT_EQ(digests.size(), 8u);
+    for (const auto& [path, digest] : digests)
+      DVC_ASSERT_EQ(digest,
+                    dvc::compute_digest(algorithm, dvc::load_file(path)));
+
+    dvc::digest_cache cache(cache_file);
+    auto uncached = digests;
+    digests.clear();
+    dvc::walk_digests(root, options, &cache, algorithm, visit);
+    DVC_ASSERT(digests == uncached);
+    DVC_ASSERT_EQ(cache.stats().hits, ordered ? 8u : 0u);
+  }
+}
+
+void benchmark(const std::filesystem::path& root) {
+  for (size_t i = 0; i < walk_files; i++) {
+    std::filesystem::path dir =
+        root / std::to_string(i % 10) / std::to_string(i % 100);
+    if (i < 100) std::filesystem::create_directories(dir);
+    dvc::save_file(dir / std::to_string(i), "");
+  }
+
+  size_t start = dvc::now();
+  size_t count = 0;
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator(root)) {
+    std::error_code error;
+    entry.symlink_status();
+    entry.file_size(error);
+    count++;
+  }
+  double iterator_ms = (dvc::now() - start) / 1e6;
+
+  dvc::walk_options options;
+  options.stat = true;
+  start = dvc::now();
+  size_t walked = dvc::walk(root, options, [](const dvc::walk_entry&) {})
+                      .entries;
+  double unordered_ms = (dvc::now() - start) / 1e6;
+  DVC_ASSERT_EQ(walked, count);
+
+  options.ordered = true;
+  start = dvc::now();
+  dvc::walk(root, options, [](const dvc::walk_entry&) {});
+  double ordered_ms = (dvc::now() - start) / 1e6;
+
+  DVC_LOG(count, " entries with stat: recursive_directory_iterator ",
+          iterator_ms, "ms, walk ", unordered_ms, "ms, ordered walk ",
+          ordered_ms, "ms, with ", dvc::default_pool().size(), " threads");
+}
+
+// All files in one directory, so only hashing them in parallel helps.
+void benchmark_wide(const std::filesystem::path& root) {
+  std::filesystem::create_directories(root);
+  std::string data(wide_file_size, 'x');
+  for (size_t i = 0; i < wide_files; i++)
+    dvc::save_file(root / std::to_string(i), data);
+  auto algorithm = dvc::digest_algorithm::sha3_256;
+
+  size_t start = dvc::now();
+  for (const auto& entry : std::filesystem::directory_iterator(root))
+    dvc::compute_digest(algorithm, dvc::read_file(entry.path()));
+  double serial_ms = (dvc::now() - start) / 1e6;
+
+  dvc::walk_options options;
+  auto visit = [](const dvc::walk_entry&, std::string_view) {};
+  start = dvc::now();
+  size_t walked =
+      dvc::walk_digests(root, options, nullptr, algorithm, visit).entries;
+  double unordered_ms = (dvc::now() - start) / 1e6;
+  DVC_ASSERT_EQ(walked, wide_files);
+
+  options.ordered = true;
+  start = dvc::now();
+  dvc::walk_digests(root, options, nullptr, algorithm, visit);
+  double ordered_ms = (dvc::now() - start) / 1e6;
+
+  DVC_LOG(wide_files, " files of ", wide_file_size,
+          " bytes in one directory: serial ", serial_ms,
+          "ms, walk_digests ", unordered_ms, "ms, ordered walk_digests ",
+          ordered_ms, "ms, with ", dvc::default_pool().size(), " threads");
+}
+
+int main(int argc, char** argv) {
+  dvc::program program(argc, argv);
+
+  std::filesystem::path dir = std::filesystem::temp_directory_path() /
+                              dvc::concat("walk_test.", ::getpid());
+  test_walk(dir / "tree");
+  test_digests(dir / "tree", dir / "cache");
+  benchmark(dir / "benchmark");
+  benchmark_wide(dir / "wide");
+  std::filesystem::remove_all(dir);
+}